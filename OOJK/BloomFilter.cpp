@@ -0,0 +1,194 @@
+/**
+ @file	BloomFilter.cpp.
+
+ @brief	Implements the bloom filter class
+ */
+
+#include "BloomFilter.h"
+#include <algorithm>
+
+// Initialize static members
+const size_t BloomFilter::bits_per_song = 10;
+const unsigned int BloomFilter::probes = 7;
+const size_t BloomFilter::min_capacity = 1024;
+
+/**
+ @fn	BloomFilter::BloomFilter()
+
+ @brief	Default constructor. The filter is sized when attached to a playlist.
+ */
+
+BloomFilter::BloomFilter() :
+	capacity(0),
+	count(0),
+	removed(0)
+{
+	build(0);
+}
+
+/**
+ @fn	uint64_t BloomFilter::hash(PathStore::Id path) noexcept
+
+ @brief	Mixes a path id, as ids of a directory's files are consecutive
+
+ @param	path	Id of the path
+
+ @return	The hash
+ */
+
+uint64_t BloomFilter::hash(PathStore::Id path) noexcept {
+
+	uint64_t value = static_cast<uint64_t>(path) + 0x9e3779b97f4a7c15ull;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	return value ^ (value >> 31);
+}
+
+/**
+ @fn	void BloomFilter::add(PathStore::Id path) noexcept
+
+ @brief	Sets bits of a path. The upper half of the hash picks the block,
+		and 9 bits of a rehash pick each bit within it.
+
+ @param	path	Id of the path
+ */
+
+void BloomFilter::add(PathStore::Id path) noexcept {
+
+	const uint64_t value = hash(path);
+	Block& block = blocks[((value >> 32) * blocks.size()) >> 32];
+
+	uint64_t bits = value * 0x9e3779b97f4a7c15ull;
+	for (unsigned int i = 0; i < probes; i++, bits >>= 9)
+		block.words[(bits >> 6) & 7] |= 1ull << (bits & 63);
+
+	count++;
+}
+
+/**
+ @fn	bool BloomFilter::mayContain(PathStore::Id path) const noexcept
+
+ @brief	Tells if a path may be in the playlist. A FALSE answer is certain,
+		a TRUE one must be confirmed from the songs.
+
+ @param	path	Id of the path
+
+ @return	FALSE if no song of the playlist has the path
+ */
+
+bool BloomFilter::mayContain(PathStore::Id path) const noexcept {
+
+	const uint64_t value = hash(path);
+	const Block& block = blocks[((value >> 32) * blocks.size()) >> 32];
+
+	uint64_t bits = value * 0x9e3779b97f4a7c15ull;
+	for (unsigned int i = 0; i < probes; i++, bits >>= 9) {
+		if ((block.words[(bits >> 6) & 7] & (1ull << (bits & 63))) == 0)
+			return false;
+	}
+	return true;
+}
+
+/**
+ @fn	bool BloomFilter::isStale() const noexcept
+
+ @brief	Tells if the filter should be rebuilt. That's when more songs were added than
+		it was sized for, or a quarter of the added songs were removed again,
+		as both make false positives more likely.
+
+ @return	TRUE if the filter should be rebuilt from the songs
+ */
+
+bool BloomFilter::isStale() const noexcept {
+	return count > capacity || removed * 4 > count;
+}
+
+/**
+ @fn	size_t BloomFilter::getMemoryUsage() const noexcept
+
+ @brief	Returns number of bytes used by the filter
+
+ @return	Bytes allocated for the blocks
+ */
+
+size_t BloomFilter::getMemoryUsage() const noexcept {
+	return blocks.capacity() * sizeof(Block);
+}
+
+/**
+ @fn	void BloomFilter::build(size_t songs)
+
+ @brief	Clears the filter, sizing it for twice the number of songs so it takes additions
+
+ @param	songs	Number of songs in the playlist
+ */
+
+void BloomFilter::build(size_t songs) {
+
+	capacity = std::max(min_capacity, songs * 2);
+	const size_t size = (capacity * bits_per_song + 511) / 512;
+
+	blocks.assign(size, Block{});
+	count = 0;
+	removed = 0;
+}
+
+/**
+ @fn	void BloomFilter::reset(const SongList& songs)
+
+ @brief	Rebuilds the filter from scratch
+
+ @param	songs	Songs of the playlist
+ */
+
+void BloomFilter::reset(const SongList& songs) {
+
+	build(songs.size());
+	for (auto const& song : songs)
+		add(song->getPathId());
+}
+
+/**
+ @fn	void BloomFilter::inserted(size_t position, const Song& song)
+
+ @brief	Adds an inserted song
+
+ @param	position	Position of the song, unused
+		song		The inserted song
+ */
+
+void BloomFilter::inserted(size_t, const Song& song) {
+	add(song.getPathId());
+}
+
+/**
+ @fn	void BloomFilter::erasing(const std::vector<size_t>& positions, const SongList& songs)
+
+ @brief	Counts songs about to be removed, their bits stay set until the filter is rebuilt
+
+ @param	positions	Ascending positions of the songs
+		songs		Songs of the playlist before erasing, unused
+ */
+
+void BloomFilter::erasing(const std::vector<size_t>& positions, const SongList&) {
+	removed += positions.size();
+}
+
+/**
+ @fn	void BloomFilter::replaced(size_t position, const Song& before, const Song& after)
+
+ @brief	Adds a replacing song. Evaluating a song keeps its path, so only relocated songs change the filter.
+
+ @param	position	Position of the song, unused
+		before		The song that was replaced
+		after		The song that replaced it
+ */
+
+void BloomFilter::replaced(size_t, const Song& before, const Song& after) {
+
+	if (before.getPathId() == after.getPathId())
+		return;
+
+	add(after.getPathId());
+	removed++;
+}
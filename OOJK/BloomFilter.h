@@ -0,0 +1,49 @@
+/**
+ @file	BloomFilter.h.
+
+ @brief	Declares the bloom filter class.
+		A blocked bloom filter over the path ids of a playlist's songs. All bits of a path
+		lie in one 64 byte block, so telling a path is missing reads a single cache line.
+		The filter may answer yes for a path not in the playlist, but never no for one that is.
+		Removed songs can't be cleared from the filter, so it's rebuilt once they add up.
+ */
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "PlaylistObserver.h"
+#include "PathStore.h"
+
+class BloomFilter : public PlaylistObserver {
+
+private:
+	/** Bits of the paths hashed to it, a cache line wide */
+	struct alignas(64) Block {
+		uint64_t words[8];				/** 512 bits */
+	};
+
+	const static size_t bits_per_song;	/** Bits reserved per song, gives about 1% false positives */
+	const static unsigned int probes;	/** Bits set per path */
+	const static size_t min_capacity;	/** Songs the smallest filter is sized for */
+
+	std::vector<Block> blocks;			/** The filter */
+	size_t capacity;					/** Songs the filter is sized for */
+	size_t count;						/** Paths added since the filter was built */
+	size_t removed;						/** Songs removed since the filter was built */
+
+	static uint64_t hash(PathStore::Id path) noexcept;	/** Mixes a path id to spread its bits */
+	void add(PathStore::Id path) noexcept;				/** Sets bits of a path */
+	void build(size_t songs);							/** Clears the filter, sizing it for a number of songs */
+
+public:
+	BloomFilter();										/** Default constructor */
+
+	bool mayContain(PathStore::Id path) const noexcept;	/** Tells if a path may be in the playlist */
+	bool isStale() const noexcept;						/** Tells if the filter should be rebuilt */
+	size_t getMemoryUsage() const noexcept;				/** Returns number of bytes used by the filter */
+
+	void reset(const SongList& songs) override;										/** Rebuilds the filter from scratch */
+	void inserted(size_t position, const Song& song) override;						/** Adds an inserted song */
+	void erasing(const std::vector<size_t>& positions, const SongList& songs) override;	/** Counts removed songs */
+	void replaced(size_t position, const Song& before, const Song& after) override;	/** Adds a replacing song if its path changed */
+};
@@ -29,12 +29,28 @@ ConcreteSong::~ConcreteSong() {
  */
 
 ConcreteSong::ConcreteSong(const std::string& p, const std::shared_ptr<MetaContainer>& md) : 
-	path(p),
+	path(PathStore::intern(p)),
 	metadata(md) 
 {
 
 }
 
+/**
+ @fn	ConcreteSong::ConcreteSong(PathStore::Id p, const std::shared_ptr<MetaContainer>& md)
+
+ @brief	Construction using a path already in the path store, e.g. of the song being evaluated
+
+ @param	p	Id of the path to physical file
+		md	Metadata to use as the member variable
+ */
+
+ConcreteSong::ConcreteSong(PathStore::Id p, const std::shared_ptr<MetaContainer>& md) :
+	path(p),
+	metadata(md)
+{
+
+}
+
 /**
  @fn	ConcreteSong::ConcreteSong(const ConcreteSong& cs)
 
@@ -59,10 +75,10 @@ ConcreteSong::ConcreteSong(const ConcreteSong& cs) :
  */
 
 ConcreteSong::ConcreteSong(ConcreteSong&& cs) noexcept : 
-	path(std::move(cs.path)),
+	path(cs.path),
 	metadata(std::move(cs.metadata))
 {
-	cs.path.clear();
+	cs.path = 0;
 	cs.metadata.reset();
 }
 
@@ -77,10 +93,10 @@ ConcreteSong& ConcreteSong::operator=(ConcreteSong&& cs) noexcept {
 	if (this == &cs)
 		return *this;
 
-	path = std::move(cs.path);
+	path = cs.path;
 	metadata = std::move(cs.metadata);
 	
-	cs.path.clear();
+	cs.path = 0;
 	cs.metadata.reset();
 
 	return *this;
@@ -98,6 +114,21 @@ std::unique_ptr<Song> ConcreteSong::clone() const {
 	return std::make_unique<ConcreteSong>(*this);
 }
 
+/**
+ @fn	std::unique_ptr<Song> ConcreteSong::relocated(const std::string& newpath) const
+
+ @brief	Makes a copy of this object for a file moved to another path.
+		The metadata is shared, as the file itself hasn't changed.
+
+ @param	newpath	Path the file is now at
+
+ @return	A copy of this object as a new unique pointer
+ */
+
+std::unique_ptr<Song> ConcreteSong::relocated(const std::string& newpath) const {
+	return std::make_unique<ConcreteSong>(newpath, metadata);
+}
+
 /**
  @fn	MetaContainer ConcreteSong::evaluate() const
 
@@ -119,6 +150,18 @@ std::shared_ptr<MetaContainer> ConcreteSong::evaluate() const noexcept {
  */
 
 std::string ConcreteSong::getPath() const {
+	return PathStore::get(path);
+}
+
+/**
+ @fn	PathStore::Id ConcreteSong::getPathId() const noexcept
+
+ @brief	Returns id of the path in the path store. Equal paths have equal ids.
+
+ @return	Id of the path to physical file
+ */
+
+PathStore::Id ConcreteSong::getPathId() const noexcept {
 	return path;
 }
 
@@ -136,7 +179,7 @@ std::string ConcreteSong::getPath() const {
 
 std::ostream& ConcreteSong::print(std::ostream& os) const {
 
-	os << "ConcreteSong: " << path.c_str() << ":";
+	os << "ConcreteSong: " << PathStore::get(path).c_str() << ":";
 
 	for (const std::string& var : title_strings) {
 		auto it = metadata->find(var);
@@ -177,7 +220,7 @@ bool ConcreteSong::operator==(const Song& s) const {
  */
 
 bool ConcreteSong::operator==(const ConcreteSong& cs) const {
-	return path == cs.getPath() || metadataEquals(*cs.metadata);
+	return path == cs.path || metadataEquals(*cs.metadata);
 }
 
 /**
@@ -192,4 +235,16 @@ bool ConcreteSong::operator==(const ConcreteSong& cs) const {
 
 bool ConcreteSong::metadataEquals(const MetaContainer& other) const {
 	return metadata->size() == other.size() && std::equal(metadata->begin(), metadata->end(), other.begin());
-}
\ No newline at end of file
+}
+
+/**
+ @fn	bool ConcreteSong::isEvaluated() const noexcept
+
+ @brief	Tells if the song's metadata is known without reading the file.
+
+ @return	Always true, concrete songs hold their metadata
+ */
+
+bool ConcreteSong::isEvaluated() const noexcept {
+	return true;
+}
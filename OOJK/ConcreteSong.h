@@ -11,12 +11,13 @@
 class ConcreteSong : public Song {
 private:
 	const static std::string title_strings[];				/** Contains metadata key strings that are used to display songs */
-	std::string path;										/** Path to a physical file on storage media that can be evaluated for metadata */
+	PathStore::Id path;										/** Path to a physical file on storage media that can be evaluated for metadata, interned in the path store */
 	std::shared_ptr<MetaContainer> metadata;				/** Contains key-value based metadata */
 public:
 	~ConcreteSong();										/** Destrcutor */
 	ConcreteSong() = delete;								/** Delete defalt constructor */
 	explicit ConcreteSong(const std::string&, const std::shared_ptr<MetaContainer>&); /** Construction using reference to existing metadata */
+	explicit ConcreteSong(PathStore::Id, const std::shared_ptr<MetaContainer>&); /** Construction using an interned path and existing metadata */
 	ConcreteSong(const ConcreteSong&);						/** Copy construction using lvalue reference to another instance */
 	ConcreteSong(ConcreteSong&&) noexcept;					/** Move constructor using rvalue reference another instance */
 	ConcreteSong& operator=(const ConcreteSong&);			/** Copy assignment using lvalue reference to another instance */
@@ -25,9 +26,12 @@ public:
 	std::ostream& print(std::ostream&) const override;		/** Print operator prints the metadata values using title_strings as keys */
 	std::shared_ptr<MetaContainer> evaluate() const noexcept override;	/** Returns key-value based metadata for the song */
 	std::string getPath() const override;					/** Returns path to physical file */
+	PathStore::Id getPathId() const noexcept override;		/** Returns id of the path in the path store */
 	std::unique_ptr<Song> clone() const override;			/** Clones the song into new unique pointer */
+	std::unique_ptr<Song> relocated(const std::string&) const override;	/** Clones the song to another path, sharing the metadata */
 	bool operator==(const Song&) const override;			/** Can be compared to other songs using the same abstraction/interface */
 	bool operator==(const ConcreteSong&) const;				/** Can be compared to other concrete songs (using contained metadata) */
 	bool metadataEquals(const MetaContainer&) const;		/** Compares metadata with another set of metadata */
+	bool isEvaluated() const noexcept override;				/** Concrete songs always carry their metadata */
 
 };
@@ -0,0 +1,424 @@
+/**
+ @file	EntryOrder.cpp.
+
+ @brief	Implements the entry order class
+ */
+
+#include "EntryOrder.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+// Initialize static members
+const EntryOrder::Id EntryOrder::none = std::numeric_limits<EntryOrder::Id>::max();
+
+/**
+ @fn	EntryOrder::EntryOrder()
+
+ @brief	Default constructor, the order starts empty
+ */
+
+EntryOrder::EntryOrder() noexcept :
+	root(none),
+	seed(0x9e3779b97f4a7c15ull)
+{
+
+}
+
+/**
+ @fn	uint32_t EntryOrder::random() noexcept
+
+ @brief	Returns the next priority from a xorshift generator.
+		Priorities only need to look random to the order of edits, so a fixed seed will do.
+
+ @return	The priority
+ */
+
+uint32_t EntryOrder::random() noexcept {
+
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return static_cast<uint32_t>(seed >> 32);
+}
+
+/**
+ @fn	unsigned int EntryOrder::sizeOf(Id node) const noexcept
+
+ @brief	Returns number of entries in a subtree
+
+ @param	node	Root of the subtree, may be none
+
+ @return	Number of entries, 0 for none
+ */
+
+unsigned int EntryOrder::sizeOf(Id node) const noexcept {
+	return (node == none) ? 0 : nodes[node].size;
+}
+
+/**
+ @fn	void EntryOrder::update(Id node) noexcept
+
+ @brief	Recomputes the size of a node from its children and links the children to it
+
+ @param	node	The node
+ */
+
+void EntryOrder::update(Id node) noexcept {
+
+	Node& n = nodes[node];
+	n.size = 1 + sizeOf(n.left) + sizeOf(n.right);
+	if (n.left != none)
+		nodes[n.left].parent = node;
+	if (n.right != none)
+		nodes[n.right].parent = node;
+}
+
+/**
+ @fn	void EntryOrder::split(Id tree, size_t count, Id& left, Id& right) noexcept
+
+ @brief	Splits a tree in two, the first count entries going left.
+		Parents of the returned roots are left for the caller to set.
+
+ @param			tree	Root of the tree to split
+				count	Number of entries to split off
+ @param [out]	left	Root of the first count entries
+ @param [out]	right	Root of the rest
+ */
+
+void EntryOrder::split(Id tree, size_t count, Id& left, Id& right) noexcept {
+
+	if (tree == none) {
+		left = right = none;
+		return;
+	}
+
+	Node& n = nodes[tree];
+	const size_t before = sizeOf(n.left);
+
+	if (before < count) {
+		split(n.right, count - before - 1, nodes[tree].right, right);
+		left = tree;
+	}
+	else {
+		split(n.left, count, left, nodes[tree].left);
+		right = tree;
+	}
+	update(tree);
+}
+
+/**
+ @fn	EntryOrder::Id EntryOrder::merge(Id left, Id right) noexcept
+
+ @brief	Joins two trees, entries of left coming first. The node of higher priority stays on top.
+
+ @param	left	Root of the earlier entries
+		right	Root of the later entries
+
+ @return	Root of the joined tree, its parent is left for the caller to set
+ */
+
+EntryOrder::Id EntryOrder::merge(Id left, Id right) noexcept {
+
+	if (left == none)
+		return right;
+	if (right == none)
+		return left;
+
+	if (nodes[left].priority > nodes[right].priority) {
+		nodes[left].right = merge(nodes[left].right, right);
+		update(left);
+		return left;
+	}
+
+	nodes[right].left = merge(left, nodes[right].left);
+	update(right);
+	return right;
+}
+
+/**
+ @fn	void EntryOrder::fix(Id node) noexcept
+
+ @brief	Recomputes sizes and parent links of a whole subtree, children first
+
+ @param	node	Root of the subtree, may be none
+ */
+
+void EntryOrder::fix(Id node) noexcept {
+
+	if (node == none)
+		return;
+
+	fix(nodes[node].left);
+	fix(nodes[node].right);
+	update(node);
+}
+
+/**
+ @fn	void EntryOrder::build(const std::vector<Id>& order)
+
+ @brief	Builds a treap of entries in order in O(n). Each entry gets a new priority,
+		and entries are hung off a stack of the tree's right edge, so no entry is inserted by search.
+
+ @param	order	Ids of the entries in order, their nodes must exist
+ */
+
+void EntryOrder::build(const std::vector<Id>& order) {
+
+	std::vector<Id> edge;
+
+	for (const Id id : order) {
+		nodes[id] = Node{ none, none, none, 1, random() };
+
+		Id last = none;
+		while (!edge.empty() && nodes[edge.back()].priority < nodes[id].priority) {
+			last = edge.back();
+			edge.pop_back();
+		}
+
+		nodes[id].left = last;
+		if (!edge.empty())
+			nodes[edge.back()].right = id;
+		edge.push_back(id);
+	}
+
+	root = edge.empty() ? none : edge.front();
+	fix(root);
+	if (root != none)
+		nodes[root].parent = none;
+}
+
+/**
+ @fn	std::vector<EntryOrder::Id> EntryOrder::list() const
+
+ @brief	Returns all ids in order, walking the tree without recursion
+
+ @return	Ids of the entries by position
+ */
+
+std::vector<EntryOrder::Id> EntryOrder::list() const {
+
+	std::vector<Id> result;
+	result.reserve(size());
+
+	std::vector<Id> path;
+	Id node = root;
+	while (node != none || !path.empty()) {
+		while (node != none) {
+			path.push_back(node);
+			node = nodes[node].left;
+		}
+		node = path.back();
+		path.pop_back();
+		result.push_back(node);
+		node = nodes[node].right;
+	}
+	return result;
+}
+
+/**
+ @fn	void EntryOrder::reset(size_t count)
+
+ @brief	Starts over with count entries, whose ids are their positions
+
+ @param	count	Number of entries
+ */
+
+void EntryOrder::reset(size_t count) {
+
+	nodes.assign(count, Node{ none, none, none, 1, 0 });
+	unused.clear();
+
+	std::vector<Id> order(count);
+	for (size_t i = 0; i < count; i++)
+		order[i] = static_cast<Id>(i);
+	build(order);
+}
+
+/**
+ @fn	EntryOrder::Id EntryOrder::insert(size_t position)
+
+ @brief	Adds an entry at position, in O(log n). Ids of erased entries are reused first,
+		so ids stay below the largest number of entries the order has had.
+
+ @param	position	Position of the entry, at most size()
+
+ @return	Id of the new entry
+
+ @throws std::out_of_range if position is past the end
+ */
+
+EntryOrder::Id EntryOrder::insert(size_t position) {
+
+	if (position > size())
+		throw std::out_of_range("Entry position is out of range");
+
+	Id id;
+	if (unused.empty()) {
+		id = static_cast<Id>(nodes.size());
+		nodes.push_back(Node{ none, none, none, 1, random() });
+	}
+	else {
+		id = unused.back();
+		unused.pop_back();
+		nodes[id] = Node{ none, none, none, 1, random() };
+	}
+
+	Id left;
+	Id right;
+	split(root, position, left, right);
+	root = merge(merge(left, id), right);
+	nodes[root].parent = none;
+
+	return id;
+}
+
+/**
+ @fn	void EntryOrder::erase(const std::vector<size_t>& positions)
+
+ @brief	Removes entries at ascending positions. A few are cut out one by one in O(log n) each,
+		a large share of the entries is removed by rebuilding the rest in O(n).
+
+ @param	positions	Ascending positions of the entries, all less than size()
+ */
+
+void EntryOrder::erase(const std::vector<size_t>& positions) {
+
+	if (positions.empty())
+		return;
+
+	if (positions.size() * 8 > size()) {
+		const std::vector<Id> all = list();
+		std::vector<Id> kept;
+		kept.reserve(all.size() - positions.size());
+
+		auto erased = positions.begin();
+		for (size_t i = 0; i < all.size(); i++) {
+			if (erased != positions.end() && *erased == i) {
+				unused.push_back(all[i]);
+				erased++;
+			}
+			else {
+				kept.push_back(all[i]);
+			}
+		}
+
+		build(kept);
+		return;
+	}
+
+	// Later positions first, so earlier ones stay where they are
+	for (auto it = positions.rbegin(); it != positions.rend(); it++) {
+		Id left;
+		Id rest;
+		Id entry;
+		Id right;
+		split(root, *it, left, rest);
+		split(rest, 1, entry, right);
+		unused.push_back(entry);
+
+		root = merge(left, right);
+		if (root != none)
+			nodes[root].parent = none;
+	}
+}
+
+/**
+ @fn	EntryOrder::Id EntryOrder::at(size_t position) const
+
+ @brief	Returns the id of the entry at position, descending by subtree sizes in O(log n)
+
+ @param	position	Position of the entry
+
+ @return	Id of the entry
+
+ @throws std::out_of_range if there is no entry at position
+ */
+
+EntryOrder::Id EntryOrder::at(size_t position) const {
+
+	if (position >= size())
+		throw std::out_of_range("Entry position is out of range");
+
+	Id node = root;
+	for (;;) {
+		const size_t before = sizeOf(nodes[node].left);
+		if (position < before) {
+			node = nodes[node].left;
+		}
+		else if (position == before) {
+			return node;
+		}
+		else {
+			position -= before + 1;
+			node = nodes[node].right;
+		}
+	}
+}
+
+/**
+ @fn	size_t EntryOrder::position(Id id) const
+
+ @brief	Returns the position of an entry, climbing to the root in O(log n)
+
+ @param	id	Id of an entry in the order
+
+ @return	Position of the entry
+ */
+
+size_t EntryOrder::position(Id id) const {
+
+	size_t result = sizeOf(nodes[id].left);
+	for (Id node = id; nodes[node].parent != none; node = nodes[node].parent) {
+		const Id parent = nodes[node].parent;
+		if (nodes[parent].right == node)
+			result += sizeOf(nodes[parent].left) + 1;
+	}
+	return result;
+}
+
+/**
+ @fn	size_t EntryOrder::size() const noexcept
+
+ @brief	Returns number of entries
+
+ @return	Number of entries in the order
+ */
+
+size_t EntryOrder::size() const noexcept {
+	return sizeOf(root);
+}
+
+/**
+ @fn	PostingList EntryOrder::toPositions(const PostingList& ids) const
+
+ @brief	Turns a posting list of entry ids into positions. Few ids are looked up one by one
+		in O(log n) each, many are looked up from a table of all positions made in O(n).
+
+ @param	ids	Ids of entries in the order
+
+ @return	Positions of the entries, in ascending order
+ */
+
+PostingList EntryOrder::toPositions(const PostingList& ids) const {
+
+	PostingList result;
+	result.reserve(ids.size());
+
+	if (ids.size() * 16 > size()) {
+		std::vector<unsigned int> positions(nodes.size(), 0);
+		const std::vector<Id> all = list();
+		for (size_t i = 0; i < all.size(); i++)
+			positions[all[i]] = static_cast<unsigned int>(i);
+
+		for (const Id id : ids)
+			result.push_back(positions[id]);
+	}
+	else {
+		for (const Id id : ids)
+			result.push_back(static_cast<unsigned int>(position(id)));
+	}
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
@@ -0,0 +1,57 @@
+/**
+ @file	EntryOrder.h.
+
+ @brief	Declares the entry order class.
+		Gives the songs seen by an index stable ids and keeps them in playlist order,
+		so posting lists can hold ids that don't change when songs are inserted or erased
+		before them. A treap keyed by position turns ids into positions and back in O(log n),
+		and inserting or erasing a song costs O(log n) instead of renumbering every posting.
+ */
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "PostingList.h"
+
+class EntryOrder {
+
+public:
+	typedef unsigned int Id;			/** Identifies an entry while it is in the order */
+
+private:
+	/** Node of the treap, stored at the index of its id */
+	struct Node {
+		Id left;						/** Entries before this one in its subtree */
+		Id right;						/** Entries after this one in its subtree */
+		Id parent;						/** Node this one hangs from, none for the root */
+		unsigned int size;				/** Number of entries in the subtree */
+		uint32_t priority;				/** Random heap priority, keeps the tree balanced */
+	};
+
+	const static Id none;				/** Marks a missing node */
+
+	std::vector<Node> nodes;			/** Nodes by id, erased ones are on the free list */
+	std::vector<Id> unused;				/** Ids of erased entries, reused first */
+	Id root;							/** Root of the treap */
+	uint64_t seed;						/** State of the priority generator */
+
+	uint32_t random() noexcept;											/** Returns the next priority */
+	unsigned int sizeOf(Id node) const noexcept;						/** Returns size of a subtree, 0 for none */
+	void update(Id node) noexcept;										/** Recomputes size of a node and links its children to it */
+	void split(Id tree, size_t count, Id& left, Id& right) noexcept;	/** Splits off the first count entries of a tree */
+	Id merge(Id left, Id right) noexcept;								/** Joins two trees, left entries first */
+	void fix(Id node) noexcept;											/** Recomputes sizes and parents of a whole subtree */
+	void build(const std::vector<Id>& order);							/** Builds a treap of entries in order in O(n) */
+	std::vector<Id> list() const;										/** Returns all ids in order */
+
+public:
+	EntryOrder() noexcept;						/** Default constructor */
+
+	void reset(size_t count);					/** Starts over with count entries, whose ids are their positions */
+	Id insert(size_t position);					/** Adds an entry at position */
+	void erase(const std::vector<size_t>& positions);	/** Removes entries at ascending positions */
+	Id at(size_t position) const;				/** Returns id of the entry at position */
+	size_t position(Id id) const;				/** Returns position of an entry */
+	size_t size() const noexcept;				/** Returns number of entries */
+	PostingList toPositions(const PostingList& ids) const;	/** Returns positions of entries in ascending order */
+};
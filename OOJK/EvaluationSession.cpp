@@ -0,0 +1,348 @@
+/**
+ @file	EvaluationSession.cpp.
+
+ @brief	Implements the evaluation session class
+ */
+
+#include "EvaluationSession.h"
+#include "Playlist.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+/**
+ @fn	EvaluationSession::EvaluationSession(Playlist& pl, size_t batch, ProgressCallback cb)
+
+ @brief	Starts an evaluation session. Nothing is evaluated until step() or run() is called.
+
+ @param [in,out]	pl		Playlist to evaluate. Must outlive the session.
+					batch	Number of songs evaluated per batch. Smaller batches show up sooner,
+							larger ones cost less publishing.
+					cb		Called with the progress after every batch, may be empty
+
+ @throws std::invalid_argument if batch is zero
+ */
+
+EvaluationSession::EvaluationSession(Playlist& pl, size_t batch, ProgressCallback cb) :
+	playlist(pl),
+	batch_size(batch),
+	callback(std::move(cb)),
+	next(0),
+	viewport(0, 0),
+	elapsed(std::chrono::steady_clock::duration::zero()),
+	cancelled(false)
+{
+	if (batch_size == 0)
+		throw std::invalid_argument("Batch size must be positive");
+
+	tracker = std::make_shared<Tracker>(*this);
+	playlist.attach(tracker);
+}
+
+/**
+ @fn	EvaluationSession::~EvaluationSession()
+
+ @brief	Destructor. Detaches from the playlist, songs evaluated so far stay evaluated.
+ */
+
+EvaluationSession::~EvaluationSession() {
+	playlist.detach(tracker);
+}
+
+/**
+ @fn	EvaluationSession::Tracker::Tracker(EvaluationSession& s)
+
+ @brief	Construction using the session whose positions are kept
+
+ @param [in,out]	s	The session
+ */
+
+EvaluationSession::Tracker::Tracker(EvaluationSession& s) noexcept :
+	session(s)
+{
+
+}
+
+/**
+ @fn	void EvaluationSession::Tracker::reset(const SongList& songs)
+
+ @brief	Starts over from the first song when the whole song list was replaced.
+		Songs already evaluated are passed over quickly.
+
+ @param	songs	Songs of the playlist, unused
+ */
+
+void EvaluationSession::Tracker::reset(const SongList&) {
+	session.next = 0;
+	session.ahead.clear();
+	session.behind.clear();
+}
+
+/**
+ @fn	void EvaluationSession::Tracker::inserted(size_t position, const Song& song)
+
+ @brief	Shifts positions after an inserted song. A song inserted before the next
+		background position is remembered, so it isn't skipped.
+
+ @param	position	Position of the inserted song
+		song		The inserted song, unused
+ */
+
+void EvaluationSession::Tracker::inserted(size_t position, const Song&) {
+
+	auto shift = [position](const std::set<size_t>& positions) {
+		std::set<size_t> shifted;
+		for (const size_t p : positions)
+			shifted.insert(shifted.end(), (p >= position) ? p + 1 : p);
+		return shifted;
+	};
+
+	session.ahead = shift(session.ahead);
+	session.behind = shift(session.behind);
+
+	if (position < session.next) {
+		session.next++;
+		session.behind.insert(position);
+	}
+}
+
+/**
+ @fn	void EvaluationSession::Tracker::erasing(const std::vector<size_t>& positions, const SongList& songs)
+
+ @brief	Shifts positions after songs about to be erased, and forgets erased songs
+
+ @param	positions	Ascending positions of the songs
+		songs		Songs of the playlist before erasing, unused
+ */
+
+void EvaluationSession::Tracker::erasing(const std::vector<size_t>& positions, const SongList&) {
+
+	// Number of erased positions before a position
+	auto before = [&positions](size_t position) {
+		return static_cast<size_t>(std::lower_bound(positions.begin(), positions.end(), position) - positions.begin());
+	};
+
+	auto shift = [&](const std::set<size_t>& kept) {
+		std::set<size_t> shifted;
+		for (const size_t p : kept) {
+			if (!std::binary_search(positions.begin(), positions.end(), p))
+				shifted.insert(shifted.end(), p - before(p));
+		}
+		return shifted;
+	};
+
+	session.ahead = shift(session.ahead);
+	session.behind = shift(session.behind);
+	session.next -= before(session.next);
+}
+
+/**
+ @fn	void EvaluationSession::Tracker::replaced(size_t position, const Song& before, const Song& after)
+
+ @brief	Replacing a song, e.g. evaluating it, leaves positions as they are
+ */
+
+void EvaluationSession::Tracker::replaced(size_t, const Song&, const Song&) {
+
+}
+
+/**
+ @fn	bool EvaluationSession::promote(size_t position)
+
+ @brief	Replaces the song at position with an evaluated one, unless it already is
+
+ @param	position	Position of the song
+
+ @return	TRUE if the song was evaluated now
+ */
+
+bool EvaluationSession::promote(size_t position) {
+
+	const SongElement& song = std::as_const(playlist.songs)[position];
+	if (song->isEvaluated())
+		return false;
+
+	playlist.replace(position, playlist.promote(song->getPathId(), song->evaluate()));
+	return true;
+}
+
+/**
+ @fn	size_t EvaluationSession::evaluateViewport()
+
+ @brief	Evaluates up to a batch of songs in the viewport.
+		The viewport is read once, so it may be moved while the batch is evaluated
+		and the next batch follows the new viewport.
+
+ @return	Number of songs evaluated
+ */
+
+size_t EvaluationSession::evaluateViewport() {
+
+	std::pair<size_t, size_t> range;
+	{
+		std::lock_guard<std::mutex> lock(viewport_mutex);
+		range = viewport;
+	}
+
+	const size_t end = std::min(range.first + range.second, playlist.songs.size());
+	size_t evaluated = 0;
+
+	for (size_t position = range.first; position < end && evaluated < batch_size; position++) {
+		if (!promote(position))
+			continue;
+
+		evaluated++;
+		if (position >= next)
+			ahead.insert(position);
+	}
+
+	return evaluated;
+}
+
+/**
+ @fn	void EvaluationSession::evaluateBackground()
+
+ @brief	Evaluates the next batch of songs in playlist order.
+		Songs inserted behind the session come first.
+		Songs already evaluated, e.g. for the viewport, are passed over.
+ */
+
+void EvaluationSession::evaluateBackground() {
+
+	size_t count = 0;
+	while (!behind.empty() && count < batch_size) {
+		promote(*behind.begin());
+		behind.erase(behind.begin());
+		count++;
+	}
+
+	const size_t end = std::min(next + batch_size - count, playlist.songs.size());
+
+	for (; next < end; next++)
+		promote(next);
+
+	ahead.erase(ahead.begin(), ahead.lower_bound(next));
+}
+
+/**
+ @fn	bool EvaluationSession::step()
+
+ @brief	Evaluates the next batch of songs and publishes the playlist, so readers see them at once.
+		A batch is taken from the viewport if it has songs left to evaluate, otherwise
+		from the rest of the playlist in order. Songs already evaluated are skipped.
+		Observers are notified of every evaluated song, and the batch is undone as a single step
+		if the playlist records history.
+		The playlist may be edited between steps, the session follows the songs it has yet to evaluate.
+
+ @return	TRUE if there are songs left to evaluate, FALSE when finished or cancelled
+ */
+
+bool EvaluationSession::step() {
+
+	if (cancelled || isFinished())
+		return false;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	{
+		auto step = playlist.transaction();
+
+		if (evaluateViewport() == 0)
+			evaluateBackground();
+	}
+
+	playlist.publish();
+	elapsed += std::chrono::steady_clock::now() - start;
+
+	if (callback)
+		callback(getProgress());
+
+	return !cancelled && !isFinished();
+}
+
+/**
+ @fn	void EvaluationSession::run()
+
+ @brief	Evaluates batches until all songs are evaluated or the session is cancelled,
+		e.g. from the progress callback or another thread.
+ */
+
+void EvaluationSession::run() {
+	while (step());
+}
+
+/**
+ @fn	void EvaluationSession::cancel() noexcept
+
+ @brief	Stops the session. A batch in progress is still finished and published,
+		so the playlist is left with every song either fully evaluated or untouched.
+ */
+
+void EvaluationSession::cancel() noexcept {
+	cancelled = true;
+}
+
+/**
+ @fn	void EvaluationSession::setViewport(size_t first, size_t count)
+
+ @brief	Sets the range of songs visible to the user, evaluated before the rest of the playlist.
+		Takes effect from the next batch. Songs already evaluated aren't evaluated again,
+		so scrolling back and forth costs nothing extra.
+
+ @param	first	Position of the first visible song
+		count	Number of visible songs, zero to evaluate in playlist order only
+ */
+
+void EvaluationSession::setViewport(size_t first, size_t count) {
+	std::lock_guard<std::mutex> lock(viewport_mutex);
+	viewport = std::make_pair(first, count);
+}
+
+/**
+ @fn	bool EvaluationSession::isCancelled() const noexcept
+
+ @brief	Tells if the session was cancelled
+
+ @return	TRUE if cancel() was called
+ */
+
+bool EvaluationSession::isCancelled() const noexcept {
+	return cancelled;
+}
+
+/**
+ @fn	bool EvaluationSession::isFinished() const
+
+ @brief	Tells if the session has gone through every song of the playlist
+
+ @return	TRUE if there is nothing left to evaluate
+ */
+
+bool EvaluationSession::isFinished() const {
+	return next >= playlist.songs.size() && behind.empty();
+}
+
+/**
+ @fn	EvaluationProgress EvaluationSession::getProgress() const
+
+ @brief	Returns the progress of the session.
+		Remaining time is estimated from the average time per song so far.
+
+ @return	Progress of the session
+ */
+
+EvaluationProgress EvaluationSession::getProgress() const {
+
+	using std::chrono::milliseconds;
+	using std::chrono::duration_cast;
+
+	const size_t total = playlist.songs.size();
+	const size_t done = std::min(next - behind.size() + ahead.size(), total);
+
+	EvaluationProgress progress{ done, total, duration_cast<milliseconds>(elapsed), milliseconds::zero() };
+
+	if (done > 0)
+		progress.remaining = duration_cast<milliseconds>(elapsed * (total - done) / done);
+
+	return progress;
+}
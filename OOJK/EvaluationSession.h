@@ -0,0 +1,82 @@
+/**
+ @file	EvaluationSession.h.
+
+ @brief	Declares the evaluation session class.
+		Evaluates the songs of a playlist gradually, a batch at a time, instead of all at once.
+		Every finished batch is published to snapshot readers right away, so the first songs
+		show their metadata long before the whole playlist is evaluated.
+		Songs in the viewport, i.e. the range visible to the user, are evaluated before the rest.
+		The session observes the playlist, so songs inserted or erased between batches
+		are neither skipped nor evaluated twice.
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include "PlaylistObserver.h"
+
+class Playlist;
+
+/** Progress of an evaluation session */
+struct EvaluationProgress {
+	size_t done;								/** Number of songs handled so far */
+	size_t total;								/** Number of songs in the playlist */
+	std::chrono::milliseconds elapsed;			/** Time spent evaluating so far */
+	std::chrono::milliseconds remaining;		/** Estimated time to evaluate the rest */
+};
+
+typedef std::function<void(const EvaluationProgress&)> ProgressCallback;	/** Called after every batch */
+
+class EvaluationSession {
+
+private:
+	/** Keeps the session's positions in step with edits of the playlist */
+	class Tracker : public PlaylistObserver {
+
+	private:
+		EvaluationSession& session;				/** The session whose positions are kept */
+
+	public:
+		explicit Tracker(EvaluationSession& session) noexcept;	/** Construction using the session to keep */
+
+		void reset(const SongList& songs) override;										/** Starts over from the first song */
+		void inserted(size_t position, const Song& song) override;						/** Shifts positions after an inserted song */
+		void erasing(const std::vector<size_t>& positions, const SongList& songs) override;	/** Shifts positions after erased songs */
+		void replaced(size_t position, const Song& before, const Song& after) override;	/** Nothing to do, positions stay */
+	};
+
+	Playlist& playlist;							/** Playlist being evaluated */
+	size_t batch_size;							/** Number of songs evaluated per batch */
+	ProgressCallback callback;					/** Receives progress after every batch, may be empty */
+	size_t next;								/** Position of the next song to evaluate in the background */
+	std::set<size_t> ahead;						/** Positions past next evaluated for the viewport, so they aren't counted twice */
+	std::set<size_t> behind;					/** Positions before next inserted since, still to be evaluated */
+	std::pair<size_t, size_t> viewport;			/** First position and number of songs visible to the user */
+	mutable std::mutex viewport_mutex;			/** Guards viewport, which may be set from another thread */
+	std::chrono::steady_clock::duration elapsed;	/** Time spent in batches so far */
+	std::atomic<bool> cancelled;				/** Set to stop before the next batch */
+	std::shared_ptr<Tracker> tracker;			/** Observer attached to the playlist for the session's lifetime */
+
+	bool promote(size_t position);				/** Evaluates a song unless already evaluated */
+	size_t evaluateViewport();					/** Evaluates a batch of songs in the viewport */
+	void evaluateBackground();					/** Evaluates the next batch of songs in playlist order */
+
+public:
+	explicit EvaluationSession(Playlist& playlist, size_t batch_size = 256, ProgressCallback callback = nullptr);	/** Starts a session, nothing is evaluated yet */
+	~EvaluationSession();						/** Detaches from the playlist */
+	EvaluationSession(const EvaluationSession&) = delete;
+	EvaluationSession& operator=(const EvaluationSession&) = delete;
+
+	bool step();								/** Evaluates and publishes the next batch */
+	void run();									/** Evaluates batches until done or cancelled */
+	void cancel() noexcept;						/** Stops the session after the batch in progress, safe to call from any thread */
+	void setViewport(size_t first, size_t count);	/** Sets the range evaluated first, safe to call from any thread */
+	bool isCancelled() const noexcept;			/** Tells if the session was cancelled */
+	bool isFinished() const;					/** Tells if all songs are evaluated */
+	EvaluationProgress getProgress() const;		/** Returns current progress */
+};
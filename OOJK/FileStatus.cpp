@@ -0,0 +1,179 @@
+/**
+ @file	FileStatus.cpp.
+
+ @brief	Implements the file status class
+ */
+
+#include "FileStatus.h"
+#include "ReadPlanner.h"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#else
+#include <filesystem>
+#endif
+
+const size_t FileStatus::max_threads = 16;
+
+/**
+ @fn	bool FileStamp::operator==(const FileStamp& other) const noexcept
+
+ @brief	Compares two stamps
+
+ @param	other	The stamp to compare to
+
+ @return	TRUE if both tell the same about the file
+ */
+
+bool FileStamp::operator==(const FileStamp& other) const noexcept {
+	return exists == other.exists && size == other.size && modified == other.modified;
+}
+
+/**
+ @fn	bool FileStamp::operator!=(const FileStamp& other) const noexcept
+
+ @brief	Compares two stamps
+
+ @param	other	The stamp to compare to
+
+ @return	TRUE if the file has changed between them
+ */
+
+bool FileStamp::operator!=(const FileStamp& other) const noexcept {
+	return !(*this == other);
+}
+
+/**
+ @fn	FileStamp FileStatus::stat(const std::string& path)
+
+ @brief	Queries whether a file exists, its size and time of last modification
+
+ @param	path	Full pathname of the file
+
+ @return	Stamp of the file, not existing if it can't be queried
+ */
+
+FileStamp FileStatus::stat(const std::string& path) {
+	return stat(std::vector<std::string>{ path }, 1).front();
+}
+
+/**
+ @fn	std::vector<FileStamp> FileStatus::stat(const std::vector<std::string>& paths, unsigned int threads)
+
+ @brief	Queries several files. Files are grouped by directory, and threads take
+		a directory at a time, opening it once for all its files.
+
+ @param	paths	Full pathnames of the files
+		threads	Number of threads querying, 0 to decide by the number of cores
+
+ @return	Stamps of the files, in the order of paths
+ */
+
+std::vector<FileStamp> FileStatus::stat(const std::vector<std::string>& paths, unsigned int threads) {
+
+	std::vector<FileStamp> stamps(paths.size(), FileStamp{ false, 0, 0 });
+
+	std::map<std::string, std::vector<size_t>> grouped;
+	for (size_t i = 0; i < paths.size(); i++)
+		grouped[ReadPlanner::getDirectory(paths[i])].push_back(i);
+
+	const std::vector<std::pair<std::string, std::vector<size_t>>> directories(grouped.begin(), grouped.end());
+
+	// Queries mostly wait for the file system, so more threads than cores pay off
+	if (threads == 0)
+		threads = static_cast<unsigned int>(std::min(max_threads, static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())) * 2));
+	threads = static_cast<unsigned int>(std::min(static_cast<size_t>(threads), directories.size()));
+
+	if (threads <= 1) {
+		for (const auto& directory : directories)
+			statDirectory(directory.first, paths, directory.second, stamps);
+		return stamps;
+	}
+
+	// Each thread writes only the stamps of the directories it takes
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t i = next++; i < directories.size(); i = next++)
+			statDirectory(directories[i].first, paths, directories[i].second, stamps);
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned int i = 0; i < threads; i++)
+		pool.emplace_back(worker);
+	for (std::thread& thread : pool)
+		thread.join();
+
+	return stamps;
+}
+
+/**
+ @fn	void FileStatus::statDirectory(const std::string& directory, const std::vector<std::string>& paths, const std::vector<size_t>& indexes, std::vector<FileStamp>& stamps)
+
+ @brief	Queries files of one directory. The directory is opened once and files are queried
+		relative to it. If it can't be opened, none of its files exist.
+
+ @param	directory	Directory of the files, empty for the current directory
+		paths		Full pathnames of all files being queried
+		indexes		Indexes of the files in this directory
+ @param [out]	stamps	Stamps of all files, those at indexes are set
+ */
+
+void FileStatus::statDirectory(const std::string& directory, const std::vector<std::string>& paths, const std::vector<size_t>& indexes, std::vector<FileStamp>& stamps) {
+
+	const size_t name_start = directory.empty() ? 0 : directory.size() + 1;
+
+#if defined(__unix__) || defined(__APPLE__)
+#ifdef O_PATH
+	const int flags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+#else
+	const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+#endif
+
+	// Names of absolute paths with an empty directory part, like /a.mp3, ignore the descriptor
+	const int fd = ::open(directory.empty() ? "." : directory.c_str(), flags);
+	if (fd < 0)
+		return;
+
+	for (size_t index : indexes) {
+		const char* name = paths[index].c_str() + name_start;
+		FileStamp& stamp = stamps[index];
+
+#ifdef STATX_BASIC_STATS
+		struct statx info;
+		if (::statx(fd, name, 0, STATX_TYPE | STATX_SIZE | STATX_MTIME, &info) == 0 && S_ISREG(info.stx_mode))
+			stamp = FileStamp{ true, info.stx_size, static_cast<long long>(info.stx_mtime.tv_sec) * 1000000000 + info.stx_mtime.tv_nsec };
+#else
+		struct stat info;
+		if (::fstatat(fd, name, &info, 0) == 0 && S_ISREG(info.st_mode))
+			stamp = FileStamp{ true, static_cast<unsigned long long>(info.st_size), static_cast<long long>(info.st_mtime) };
+#endif
+	}
+
+	::close(fd);
+#else
+	namespace fs = std::filesystem;
+	(void)name_start;
+
+	for (size_t index : indexes) {
+		std::error_code error;
+		const fs::path path(paths[index]);
+
+		if (!fs::is_regular_file(path, error))
+			continue;
+
+		const unsigned long long size = fs::file_size(path, error);
+		if (error)
+			continue;
+
+		const auto modified = fs::last_write_time(path, error);
+		if (!error)
+			stamps[index] = FileStamp{ true, size, static_cast<long long>(modified.time_since_epoch().count()) };
+	}
+#endif
+}
@@ -0,0 +1,35 @@
+/**
+ @file	FileStatus.h.
+
+ @brief	Declares the file status class.
+		Finds out whether files exist and when they were last changed, many files at a time.
+		Files are grouped by directory and directories are handled in parallel.
+		On POSIX systems every directory is opened once and its files are queried relative to it,
+		with statx on Linux, so the directory's path is resolved once instead of for every file in it.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+/** What is known of a file when its metadata is read, used to tell if it has changed since */
+struct FileStamp {
+	bool exists;						/** Whether the file exists and is a regular file */
+	unsigned long long size;			/** Size in bytes */
+	long long modified;					/** Time of last modification, in platform specific units */
+
+	bool operator==(const FileStamp& other) const noexcept;	/** Stamps are equal if all their fields are */
+	bool operator!=(const FileStamp& other) const noexcept;	/** Stamps differ if any of their fields does */
+};
+
+class FileStatus {
+
+private:
+	const static size_t max_threads;	/** Most threads used for querying */
+
+	static void statDirectory(const std::string& directory, const std::vector<std::string>& paths, const std::vector<size_t>& indexes, std::vector<FileStamp>& stamps);	/** Queries files of one directory */
+
+public:
+	static FileStamp stat(const std::string& path);	/** Queries a file */
+	static std::vector<FileStamp> stat(const std::vector<std::string>& paths, unsigned int threads = 0);	/** Queries several files in parallel */
+};
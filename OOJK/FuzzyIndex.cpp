@@ -0,0 +1,348 @@
+/**
+ @file	FuzzyIndex.cpp.
+
+ @brief	Implements the fuzzy index class.
+		Edit distances are computed with the bit-parallel algorithm of Myers (1999) in the
+		formulation of Hyyro (2001): one column of the dynamic programming matrix is kept
+		as bit vectors of vertical deltas and advanced a whole column per text character.
+ */
+
+#include "FuzzyIndex.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+
+/** Metadata keys whose values are matched against a query */
+const std::string FuzzyIndex::match_strings[] = { "title", "artist" };
+
+namespace {
+
+	/**
+	 @fn	std::string toLower(const std::string& s)
+
+	 @brief	Returns an ASCII lowercased copy of a string
+	 */
+
+	std::string toLower(const std::string& s) {
+		std::string result(s);
+		std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) {
+			return static_cast<char>(std::tolower(c));
+		});
+		return result;
+	}
+
+	/**
+	 @class	Pattern
+
+	 @brief	Precomputed match masks of a query of at most 64 characters.
+			Bit i of mask(c) is set if the query has character c at index i.
+	 */
+
+	class Pattern {
+	private:
+		std::array<uint64_t, 256> masks;
+		size_t length;
+
+	public:
+		explicit Pattern(const std::string& pattern) : masks(), length(pattern.length()) {
+			for (size_t i = 0; i < length; i++)
+				masks[static_cast<unsigned char>(pattern[i])] |= uint64_t(1) << i;
+		}
+
+		/**
+		 @brief	Computes edit distance between the pattern and a text, giving up once
+				the distance can no longer stay within limit.
+
+		 @return	The edit distance, or limit + 1 if it exceeds limit
+		 */
+
+		unsigned int distance(const std::string& text, unsigned int limit) const {
+
+			if (length == 0)
+				return static_cast<unsigned int>(std::min<size_t>(text.length(), size_t(limit) + 1));
+
+			const uint64_t last = uint64_t(1) << (length - 1);
+			uint64_t pv = ~uint64_t(0);
+			uint64_t mv = 0;
+			size_t score = length;
+			size_t remaining = text.length();
+
+			for (const char c : text) {
+				const uint64_t eq = masks[static_cast<unsigned char>(c)];
+				const uint64_t xv = eq | mv;
+				const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+				uint64_t ph = mv | ~(xh | pv);
+				uint64_t mh = pv & xh;
+
+				if (ph & last)
+					score++;
+				else if (mh & last)
+					score--;
+
+				// Row zero grows by one per column in global alignment, hence the shifted in one
+				ph = (ph << 1) | 1;
+				mh <<= 1;
+				pv = mh | ~(xv | ph);
+				mv = ph & xv;
+
+				// Each remaining column can lower the score by one at most
+				remaining--;
+				if (score > limit + remaining)
+					return limit + 1;
+			}
+
+			return static_cast<unsigned int>(std::min<size_t>(score, size_t(limit) + 1));
+		}
+	};
+}
+
+/**
+ @fn	FuzzyIndex::FuzzyIndex()
+
+ @brief	Default constructor
+ */
+
+FuzzyIndex::FuzzyIndex() noexcept {
+
+}
+
+/**
+ @fn	unsigned int FuzzyIndex::distance(const std::string& a, const std::string& b, unsigned int limit)
+
+ @brief	Computes Levenshtein distance between two strings.
+		Uses the bit-parallel algorithm when the first string fits a machine word,
+		otherwise falls back to the classic two row dynamic programming.
+
+ @param	a		First string
+		b		Second string
+		limit	Largest distance of interest. Computation stops early once it's exceeded.
+
+ @return	The edit distance, or limit + 1 if it exceeds limit
+ */
+
+unsigned int FuzzyIndex::distance(const std::string& a, const std::string& b, unsigned int limit) {
+
+	const size_t difference = (a.length() > b.length()) ? a.length() - b.length() : b.length() - a.length();
+	if (limit != UINT_MAX && difference > limit)
+		return limit + 1;
+
+	if (a.length() <= 64)
+		return Pattern(a).distance(b, limit == UINT_MAX ? UINT_MAX - 1 : limit);
+
+	std::vector<size_t> previous(a.length() + 1);
+	std::vector<size_t> current(a.length() + 1);
+	for (size_t i = 0; i <= a.length(); i++)
+		previous[i] = i;
+
+	for (size_t j = 1; j <= b.length(); j++) {
+		current[0] = j;
+		for (size_t i = 1; i <= a.length(); i++) {
+			const size_t substitution = previous[i - 1] + ((a[i - 1] == b[j - 1]) ? 0 : 1);
+			current[i] = std::min({ previous[i] + 1, current[i - 1] + 1, substitution });
+		}
+		std::swap(previous, current);
+	}
+
+	return static_cast<unsigned int>(std::min<size_t>(previous[a.length()], limit == UINT_MAX ? UINT_MAX : size_t(limit) + 1));
+}
+
+/**
+ @fn	std::vector<FuzzyMatch> FuzzyIndex::search(const std::string& query, size_t max_results, unsigned int max_distance) const
+
+ @brief	Finds songs whose title or artist is closest to the query, ignoring case.
+		Each distinct string is compared once. Strings whose length alone puts them
+		too far are skipped without comparing.
+
+ @param	query			The (possibly misspelled) search string
+		max_results		Maximum number of songs to return
+		max_distance	Largest accepted edit distance
+
+ @return	Matches ordered by distance, then by position
+ */
+
+std::vector<FuzzyMatch> FuzzyIndex::search(const std::string& query, size_t max_results, unsigned int max_distance) const {
+
+	const std::string needle = toLower(query);
+	const bool bit_parallel = needle.length() <= 64;
+	const Pattern pattern(bit_parallel ? needle : std::string());
+
+	std::unordered_map<EntryOrder::Id, unsigned int> best;
+
+	for (size_t id = 0; id < strings.size(); id++) {
+
+		if (songs[id].empty())
+			continue;
+
+		const std::string& candidate = strings[id];
+		const size_t difference = (candidate.length() > needle.length()) ? candidate.length() - needle.length() : needle.length() - candidate.length();
+		if (difference > max_distance)
+			continue;
+
+		const unsigned int d = bit_parallel ? pattern.distance(candidate, max_distance) : distance(needle, candidate, max_distance);
+		if (d > max_distance)
+			continue;
+
+		for (const EntryOrder::Id entry : songs[id]) {
+			auto it = best.find(entry);
+			if (it == best.end())
+				best.emplace(entry, d);
+			else
+				it->second = std::min(it->second, d);
+		}
+	}
+
+	std::vector<FuzzyMatch> result;
+	result.reserve(best.size());
+	for (auto const& pair : best)
+		result.push_back(FuzzyMatch{ static_cast<unsigned int>(order.position(pair.first)), pair.second });
+
+	auto closer = [](const FuzzyMatch& a, const FuzzyMatch& b) {
+		return (a.distance != b.distance) ? a.distance < b.distance : a.position < b.position;
+	};
+
+	if (result.size() > max_results) {
+		std::partial_sort(result.begin(), result.begin() + max_results, result.end(), closer);
+		result.resize(max_results);
+	}
+	else {
+		std::sort(result.begin(), result.end(), closer);
+	}
+
+	return result;
+}
+
+/**
+ @fn	std::vector<std::string> FuzzyIndex::makeStrings(const Song& song)
+
+ @brief	Collects lowercased title and artist of an evaluated song
+
+ @param	song	The song
+
+ @return	Strings to match against, empty for songs that are not evaluated
+ */
+
+std::vector<std::string> FuzzyIndex::makeStrings(const Song& song) {
+
+	std::vector<std::string> result;
+	std::shared_ptr<MetaContainer> metadata = song.isEvaluated() ? song.evaluate() : nullptr;
+
+	if (metadata) {
+		for (const std::string& key : match_strings) {
+			auto it = metadata->find(key);
+			if (it != metadata->end())
+				result.push_back(toLower(it->second));
+		}
+	}
+
+	return result;
+}
+
+/**
+ @fn	void FuzzyIndex::index(EntryOrder::Id entry, const Song& song)
+
+ @brief	Interns the song's strings and records the song's entry for them
+
+ @param	entry	Entry id of the song
+		song	The song to index
+ */
+
+void FuzzyIndex::index(EntryOrder::Id entry, const Song& song) {
+
+	for (std::string& s : makeStrings(song)) {
+		auto it = ids.find(s);
+		if (it == ids.end()) {
+			it = ids.emplace(s, static_cast<unsigned int>(strings.size())).first;
+			strings.push_back(std::move(s));
+			songs.emplace_back();
+		}
+		Postings::insert(songs[it->second], entry);
+	}
+}
+
+/**
+ @fn	void FuzzyIndex::unindex(EntryOrder::Id entry, const Song& song)
+
+ @brief	Removes the song's entry from its strings.
+		Strings stay interned, a string without songs is skipped by search.
+
+ @param	entry	Entry id of the song
+		song	The song to remove from the index
+ */
+
+void FuzzyIndex::unindex(EntryOrder::Id entry, const Song& song) {
+
+	for (const std::string& s : makeStrings(song)) {
+		auto it = ids.find(s);
+		if (it != ids.end())
+			Postings::erase(songs[it->second], entry);
+	}
+}
+
+/**
+ @fn	void FuzzyIndex::reset(const SongList& list)
+
+ @brief	Rebuilds the index from the playlist's songs, whose entry ids are their positions
+
+ @param	list	All songs of the observed playlist
+ */
+
+void FuzzyIndex::reset(const SongList& list) {
+
+	ids.clear();
+	strings.clear();
+	songs.clear();
+
+	order.reset(list.size());
+	EntryOrder::Id entry = 0;
+	for (auto const& song : list)
+		index(entry++, *song);
+}
+
+/**
+ @fn	void FuzzyIndex::inserted(size_t position, const Song& song)
+
+ @brief	Indexes a song inserted to the playlist, touching only its own strings
+
+ @param	position	Position the song was inserted at
+		song		The inserted song
+ */
+
+void FuzzyIndex::inserted(size_t position, const Song& song) {
+	index(order.insert(position), song);
+}
+
+/**
+ @fn	void FuzzyIndex::erasing(const std::vector<size_t>& positions, const SongList& list)
+
+ @brief	Drops songs about to be erased from their own strings
+
+ @param	positions	Ascending positions of the songs to be erased
+		list		All songs of the observed playlist, before the removal
+ */
+
+void FuzzyIndex::erasing(const std::vector<size_t>& positions, const SongList& list) {
+
+	for (const size_t position : positions)
+		unindex(order.at(position), *list[position]);
+
+	order.erase(positions);
+}
+
+/**
+ @fn	void FuzzyIndex::replaced(size_t position, const Song& before, const Song& after)
+
+ @brief	Re-indexes a song that was replaced, e.g. when evaluation made its title known
+
+ @param	position	Position of the replaced song
+		before		The song that was replaced
+		after		The song now at position
+ */
+
+void FuzzyIndex::replaced(size_t position, const Song& before, const Song& after) {
+
+	const EntryOrder::Id entry = order.at(position);
+	unindex(entry, before);
+	index(entry, after);
+}
@@ -0,0 +1,48 @@
+/**
+ @file	FuzzyIndex.h.
+
+ @brief	Declares the fuzzy index class.
+		Finds songs whose title or artist is within a small edit distance of a query,
+		so misspelled searches still find what the user meant.
+		Distinct strings are stored once, so a popular artist is only compared once per query.
+		Songs are kept by entry id, see EntryOrder, so edits in the middle of the playlist
+		don't renumber the postings of songs after them.
+ */
+
+#pragma once
+#include <string>
+#include <climits>
+#include <unordered_map>
+#include "PlaylistObserver.h"
+#include "PostingList.h"
+#include "EntryOrder.h"
+
+struct FuzzyMatch {
+	unsigned int position;	/** Position of the matching song in the playlist */
+	unsigned int distance;	/** Edit distance between the query and the closest field of the song */
+};
+
+class FuzzyIndex : public PlaylistObserver {
+
+private:
+	const static std::string match_strings[];					/** Metadata keys whose values are matched against */
+	std::unordered_map<std::string, unsigned int> ids;			/** Maps an interned string to its id */
+	std::vector<std::string> strings;							/** Interned lowercased strings, by id */
+	std::vector<PostingList> songs;								/** Entry ids of songs carrying each string, by id */
+	EntryOrder order;											/** Entry ids of the songs of the observed playlist, by position */
+
+	static std::vector<std::string> makeStrings(const Song& song);	/** Returns lowercased strings of a song to match against */
+	void index(EntryOrder::Id entry, const Song& song);				/** Adds song's strings to the index */
+	void unindex(EntryOrder::Id entry, const Song& song);			/** Removes song's strings from the index */
+
+public:
+	FuzzyIndex() noexcept;		/** Default constructor */
+
+	static unsigned int distance(const std::string& a, const std::string& b, unsigned int limit = UINT_MAX);	/** Edit distance between two strings */
+	std::vector<FuzzyMatch> search(const std::string& query, size_t max_results, unsigned int max_distance) const;	/** Returns best matches for a query */
+
+	void reset(const SongList& songs) override;										/** Rebuilds the index from scratch */
+	void inserted(size_t position, const Song& song) override;						/** Indexes an inserted song */
+	void erasing(const std::vector<size_t>& positions, const SongList& songs) override;	/** Drops erased songs from the index */
+	void replaced(size_t position, const Song& before, const Song& after) override;	/** Re-indexes a replaced song */
+};
@@ -0,0 +1,119 @@
+/**
+ @file	Library.cpp.
+
+ @brief	Implements the library class
+ */
+
+#include "Library.h"
+#include "ConcreteSong.h"
+
+/**
+ @fn	SongElement Library::share(const Song& song)
+
+ @brief	Returns the canonical song for a song, making a copy of it canonical if its path
+		has none yet. An evaluated song replaces a canonical one that isn't, or that carries
+		different metadata. Playlists already holding the previous canonical song keep it.
+
+ @param	song	The song to share
+
+ @return	The canonical song with the same path
+ */
+
+SongElement Library::share(const Song& song) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	SongElement& canonical = songs[song.getPathId()];
+
+	if (!canonical) {
+		canonical = song.clone();
+	}
+	else if (song.isEvaluated()) {
+		const std::shared_ptr<MetaContainer> metadata = song.evaluate();
+		const std::shared_ptr<MetaContainer> current = canonical->isEvaluated() ? canonical->evaluate() : nullptr;
+
+		if (!current || (current != metadata && (!metadata || *current != *metadata)))
+			canonical = song.clone();
+	}
+
+	return canonical;
+}
+
+/**
+ @fn	SongElement Library::promote(PathStore::Id path, const std::shared_ptr<MetaContainer>& metadata)
+
+ @brief	Returns a canonical evaluated song for a path and its metadata. The canonical song
+		is kept if it carries the same metadata already, e.g. another playlist promoted it first.
+
+ @param	path		Id of the song's path
+		metadata	Metadata of the song
+
+ @return	The canonical evaluated song
+ */
+
+SongElement Library::promote(PathStore::Id path, const std::shared_ptr<MetaContainer>& metadata) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	SongElement& canonical = songs[path];
+
+	if (!canonical || !canonical->isEvaluated() || canonical->evaluate() != metadata)
+		canonical = std::make_shared<ConcreteSong>(path, metadata);
+
+	return canonical;
+}
+
+/**
+ @fn	SongElement Library::find(PathStore::Id path) const
+
+ @brief	Returns the canonical song of a path
+
+ @param	path	Id of the path
+
+ @return	The canonical song, nullptr if the path has none
+ */
+
+SongElement Library::find(PathStore::Id path) const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = songs.find(path);
+	return (it != songs.end()) ? it->second : nullptr;
+}
+
+/**
+ @fn	size_t Library::getCount() const
+
+ @brief	Returns number of canonical songs
+
+ @return	Number of distinct paths in the catalog
+ */
+
+size_t Library::getCount() const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return songs.size();
+}
+
+/**
+ @fn	size_t Library::purge()
+
+ @brief	Forgets canonical songs held by no playlist, history or snapshot anymore
+
+ @return	Number of songs forgotten
+ */
+
+size_t Library::purge() {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t purged = 0;
+
+	for (auto it = songs.begin(); it != songs.end(); ) {
+		if (it->second.use_count() == 1) {
+			it = songs.erase(it);
+			purged++;
+		}
+		else {
+			++it;
+		}
+	}
+
+	return purged;
+}
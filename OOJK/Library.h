@@ -0,0 +1,29 @@
+/**
+ @file	Library.h.
+
+ @brief	Declares the library class.
+		A catalog holding one canonical song per path, shared by all playlists using it.
+		Playlists in catalog mode don't clone the songs added to them, but point to the
+		canonical song instead, so a track in thousands of playlists exists once in memory.
+		When a playlist evaluates a song, the evaluated song becomes canonical, and other
+		playlists adding or evaluating the same track get it without reading anything.
+ */
+
+#pragma once
+#include <mutex>
+#include <unordered_map>
+#include "Song.h"
+
+class Library {
+
+private:
+	std::unordered_map<PathStore::Id, SongElement> songs;	/** Canonical songs by path */
+	mutable std::mutex mutex;								/** Guards songs, playlists may be edited from several threads */
+
+public:
+	SongElement share(const Song& song);					/** Returns the canonical song for a song */
+	SongElement promote(PathStore::Id path, const std::shared_ptr<MetaContainer>& metadata);	/** Returns a canonical evaluated song */
+	SongElement find(PathStore::Id path) const;				/** Returns the canonical song of a path */
+	size_t getCount() const;								/** Returns number of canonical songs */
+	size_t purge();											/** Forgets songs no playlist holds anymore */
+};
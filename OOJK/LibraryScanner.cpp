@@ -0,0 +1,498 @@
+/**
+ @file	LibraryScanner.cpp.
+
+ @brief	Implements the library scanner class
+ */
+
+#include "LibraryScanner.h"
+#include "Playlist.h"
+#include "ProxySong.h"
+#include "Metadata.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#else
+#include <filesystem>
+#endif
+
+const size_t LibraryScanner::batch_size = 1024;
+const size_t LibraryScanner::queue_size = 65536;
+const unsigned int LibraryScanner::max_attempts = 8;
+
+const std::vector<std::string> LibraryScanner::default_extensions = {
+	"mp3", "flac", "ogg", "opus", "m4a", "aac", "wav", "wma", "aiff", "ape", "mpc", "wv"
+};
+
+/** An open directory. On Linux its descriptor is kept open until all its subdirectories are opened. */
+struct LibraryScanner::Directory {
+	std::string path;							/** Full pathname of the directory */
+#ifdef __linux__
+	int fd = -1;								/** Descriptor subdirectories are opened relative to */
+
+	~Directory() {
+		if (fd >= 0)
+			::close(fd);
+	}
+#endif
+};
+
+/** A directory waiting to be walked */
+struct LibraryScanner::Task {
+	std::shared_ptr<const Directory> parent;	/** Directory containing it, nullptr for a root */
+	std::string name;							/** Name within the parent, or the full pathname of a root */
+	unsigned int attempts = 0;					/** Times it couldn't be opened for lack of descriptors */
+};
+
+/** Queue and results of one thread. The owner takes the newest tasks, thieves the oldest. */
+struct LibraryScanner::Worker {
+	std::mutex mutex;							/** Guards tasks */
+	std::deque<Task> tasks;						/** Directories waiting to be walked */
+	std::vector<std::string> found;				/** Paths found but not handed over yet */
+	std::vector<SkippedDirectory> skipped;		/** Directories it couldn't list */
+};
+
+/** State shared by all threads of a walk */
+struct LibraryScanner::Walk {
+	const std::vector<std::string>& extensions;	/** Extensions of files to find */
+	std::vector<std::unique_ptr<Worker>> workers;	/** One per thread */
+	std::atomic<size_t> pending;				/** Directories queued or being listed */
+	std::atomic<size_t> queued;					/** Directories waiting in the queues */
+	std::atomic<size_t> idle;					/** Threads waiting for directories */
+	std::atomic<bool> stopped;					/** Set to stop the threads early */
+	std::mutex idle_mutex;						/** Guards waiting for directories */
+	std::condition_variable work_ready;			/** Signalled when directories are queued or the walk ends */
+	std::mutex output_mutex;					/** Guards output and running */
+	std::condition_variable output_ready;		/** Signalled when a batch is handed over or a thread finishes */
+	std::deque<std::vector<std::string>> output;	/** Batches waiting for the consumer */
+	size_t running;								/** Number of threads still walking */
+
+	explicit Walk(const std::vector<std::string>& ext) : extensions(ext), pending(0), queued(0), idle(0), stopped(false), running(0) {}
+
+	// Called after queued, pending or stopped changed. Idle threads count themselves before
+	// checking them, so either they see the change or they are counted here.
+	void wake() {
+		if (idle > 0) {
+			{
+				std::lock_guard<std::mutex> lock(idle_mutex);
+			}
+			work_ready.notify_all();
+		}
+	}
+
+	void hand(std::vector<std::string>& batch) {
+		{
+			std::lock_guard<std::mutex> lock(output_mutex);
+			output.push_back(std::move(batch));
+		}
+		batch.clear();
+		output_ready.notify_one();
+	}
+};
+
+/**
+ @fn	std::vector<SkippedDirectory> LibraryScanner::scan(const std::vector<std::string>& roots, const PathConsumer& consumer, const std::vector<std::string>& extensions, unsigned int threads)
+
+ @brief	Finds files with given extensions under root directories. Paths are handed to the
+		consumer in batches on the calling thread while the walk goes on, files of a directory
+		in name order. The order of directories depends on the scheduling of threads.
+		Symbolic links to files are followed, links to directories aren't, so loops can't occur.
+		Directories that can't be opened while the process is out of descriptors are tried
+		again after other directories are done, those that still can't be listed are skipped and returned.
+
+ @param	roots		Full pathnames of the directories to walk
+		consumer	Receives batches of full pathnames of found files
+		extensions	Extensions of files to find, without the dot
+		threads		Number of threads walking, 0 to decide by the number of cores
+
+ @return	Directories that couldn't be listed, in no particular order
+
+ @throws Whatever the consumer throws, after the walk is stopped
+ */
+
+std::vector<SkippedDirectory> LibraryScanner::scan(const std::vector<std::string>& roots, const PathConsumer& consumer, const std::vector<std::string>& extensions, unsigned int threads) {
+
+	std::vector<SkippedDirectory> skipped;
+	if (roots.empty())
+		return skipped;
+
+	// Walking is mostly waiting for the disk, so more threads than cores pay off
+	if (threads == 0)
+		threads = std::min(16u, std::max(1u, std::thread::hardware_concurrency()) * 2);
+
+	Walk walk(extensions);
+	for (unsigned int i = 0; i < threads; i++)
+		walk.workers.push_back(std::make_unique<Worker>());
+
+	for (size_t i = 0; i < roots.size(); i++) {
+
+		// Trailing delimeters would be doubled when joining names
+		std::string root = roots[i];
+		while (root.size() > 1 && (root.back() == '/' || root.back() == '\\'))
+			root.pop_back();
+
+		walk.workers[i % threads]->tasks.push_back(Task{ nullptr, root });
+	}
+	walk.pending = roots.size();
+	walk.queued = roots.size();
+	walk.running = threads;
+
+	std::vector<std::thread> pool;
+	for (unsigned int i = 0; i < threads; i++)
+		pool.emplace_back(&LibraryScanner::work, std::ref(walk), i);
+
+	try {
+		while (true) {
+			std::vector<std::string> batch;
+			{
+				std::unique_lock<std::mutex> lock(walk.output_mutex);
+				walk.output_ready.wait(lock, [&walk]() { return !walk.output.empty() || walk.running == 0; });
+				if (walk.output.empty())
+					break;
+
+				batch = std::move(walk.output.front());
+				walk.output.pop_front();
+			}
+			consumer(std::move(batch));
+		}
+	}
+	catch (...) {
+		walk.stopped = true;
+		walk.wake();
+		for (std::thread& thread : pool)
+			thread.join();
+		throw;
+	}
+
+	for (std::thread& thread : pool)
+		thread.join();
+
+	for (auto const& worker : walk.workers)
+		skipped.insert(skipped.end(), worker->skipped.begin(), worker->skipped.end());
+	return skipped;
+}
+
+/**
+ @fn	unsigned int LibraryScanner::ingest(Playlist& playlist, const std::vector<std::string>& roots, bool read_metadata, const std::vector<std::string>& extensions, unsigned int threads, std::vector<SkippedDirectory>* skipped)
+
+ @brief	Adds files with given extensions under root directories to the end of a playlist
+		as ProxySongs, while the directories are still being walked. The whole ingestion
+		is one undoable edit.
+
+ @param [in,out]	playlist		Playlist to add to
+					roots			Full pathnames of the directories to walk
+					read_metadata	TRUE to start reading metadata of found files in the background
+					extensions		Extensions of files to add, without the dot
+					threads			Number of threads walking, 0 to decide by the number of cores
+ @param [out]		skipped			If not nullptr, set to the directories that couldn't be listed
+
+ @return	Number of songs added
+ */
+
+unsigned int LibraryScanner::ingest(Playlist& playlist, const std::vector<std::string>& roots, bool read_metadata, const std::vector<std::string>& extensions, unsigned int threads, std::vector<SkippedDirectory>* skipped) {
+
+	unsigned int added = 0;
+	std::vector<std::string> unread;
+	auto step = playlist.transaction();
+
+	std::vector<SkippedDirectory> missed = scan(roots, [&](std::vector<std::string>&& paths) {
+
+		for (const std::string& path : paths)
+			playlist.insert(playlist.songs.size(), playlist.share(std::make_shared<ProxySong>(path)));
+		added += static_cast<unsigned int>(paths.size());
+
+		// Reads are queued in large chunks, as each chunk gets reader threads of its own
+		if (read_metadata) {
+			unread.insert(unread.end(), std::make_move_iterator(paths.begin()), std::make_move_iterator(paths.end()));
+			if (unread.size() >= queue_size) {
+				Metadata::queue(unread);
+				unread.clear();
+			}
+		}
+	}, extensions, threads);
+
+	if (!unread.empty())
+		Metadata::queue(unread);
+
+	if (skipped)
+		*skipped = std::move(missed);
+
+	return added;
+}
+
+/**
+ @fn	bool LibraryScanner::hasExtension(const std::string& name, const std::vector<std::string>& extensions)
+
+ @brief	Tells if a file name ends with one of the extensions, ignoring case
+
+ @param	name		File name or full pathname
+		extensions	Extensions without the dot
+
+ @return	TRUE if the extension of the name is one of them
+ */
+
+bool LibraryScanner::hasExtension(const std::string& name, const std::vector<std::string>& extensions) {
+
+	const size_t dot = name.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+
+	const size_t length = name.size() - dot - 1;
+	for (const std::string& extension : extensions) {
+		if (extension.size() != length)
+			continue;
+
+		bool match = true;
+		for (size_t i = 0; i < length && match; i++)
+			match = std::tolower(static_cast<unsigned char>(name[dot + 1 + i])) == std::tolower(static_cast<unsigned char>(extension[i]));
+		if (match)
+			return true;
+	}
+	return false;
+}
+
+/**
+ @fn	void LibraryScanner::work(Walk& walk, size_t id)
+
+ @brief	Walks directories of its own queue newest first, which keeps few directories open,
+		and steals the oldest directories of other threads when its queue is empty.
+		Sleeps while there is nothing to steal, and returns when no directory is queued or being listed anywhere.
+
+ @param [in,out]	walk	State of the walk
+					id		Index of the thread's worker
+ */
+
+void LibraryScanner::work(Walk& walk, size_t id) {
+
+	Worker& self = *walk.workers[id];
+	const size_t count = walk.workers.size();
+
+	while (!walk.stopped) {
+
+		Task task;
+		bool found = false;
+		{
+			std::lock_guard<std::mutex> lock(self.mutex);
+			if (!self.tasks.empty()) {
+				task = std::move(self.tasks.back());
+				self.tasks.pop_back();
+				found = true;
+			}
+		}
+
+		for (size_t k = 1; k < count && !found; k++) {
+			Worker& victim = *walk.workers[(id + k) % count];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				found = true;
+			}
+		}
+
+		if (!found) {
+			std::unique_lock<std::mutex> lock(walk.idle_mutex);
+			walk.idle++;
+			walk.work_ready.wait(lock, [&walk]() { return walk.queued > 0 || walk.pending == 0 || walk.stopped; });
+			walk.idle--;
+
+			if (walk.pending == 0)
+				break;
+			continue;
+		}
+
+		walk.queued--;
+
+		// Subdirectories are counted before their parent is done, so pending can't reach 0 early
+		if (list(walk, self, task) && --walk.pending == 0)
+			walk.wake();
+	}
+
+	if (!self.found.empty())
+		walk.hand(self.found);
+
+	{
+		std::lock_guard<std::mutex> lock(walk.output_mutex);
+		walk.running--;
+	}
+	walk.output_ready.notify_one();
+}
+
+/**
+ @fn	bool LibraryScanner::list(Walk& walk, Worker& worker, Task& task)
+
+ @brief	Lists a directory. Matching files are added to the worker's results,
+		subdirectories to its queue. If the process is out of descriptors, the directory
+		goes back to the oldest end of the queue, to be tried after descriptors of other
+		directories are closed. Directories that can't be listed are added to the worker's skipped ones.
+
+ @param [in,out]	walk	State of the walk
+					worker	Worker of the calling thread
+					task	Directory to list, moved back to the queue if it's tried again later
+
+ @return	TRUE if the directory is done with, FALSE if it was queued again
+ */
+
+bool LibraryScanner::list(Walk& walk, Worker& worker, Task& task) {
+
+	auto directory = std::make_shared<Directory>();
+	std::vector<std::string> files;
+	std::vector<std::string> subdirectories;
+
+#ifdef __linux__
+	if (!task.parent)
+		directory->path = task.name;
+	else if (task.parent->path == "/")
+		directory->path = "/" + task.name;
+	else
+		directory->path = task.parent->path + "/" + task.name;
+
+	// Opening relative to the parent saves resolving the whole path again
+	directory->fd = task.parent
+		? ::openat(task.parent->fd, task.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW)
+		: ::open(task.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (directory->fd < 0) {
+		const int error = errno;
+
+		if ((error == EMFILE || error == ENFILE) && task.attempts < max_attempts) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(task.attempts));
+			task.attempts++;
+			{
+				std::lock_guard<std::mutex> lock(worker.mutex);
+				worker.tasks.push_front(std::move(task));
+			}
+			walk.queued++;
+			walk.wake();
+			return false;
+		}
+
+		worker.skipped.push_back(SkippedDirectory{ directory->path, std::error_code(error, std::generic_category()) });
+		return true;
+	}
+
+	struct Entry {
+		unsigned long long d_ino;
+		long long d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[1];
+	};
+
+	alignas(8) static thread_local char buffer[1 << 16];
+
+	while (true) {
+		const long size = ::syscall(SYS_getdents64, directory->fd, buffer, sizeof(buffer));
+		if (size < 0)
+			worker.skipped.push_back(SkippedDirectory{ directory->path, std::error_code(errno, std::generic_category()) });
+		if (size <= 0)
+			break;
+
+		for (long offset = 0; offset < size; ) {
+			const Entry* entry = reinterpret_cast<const Entry*>(buffer + offset);
+			offset += entry->d_reclen;
+
+			const char* name = entry->d_name;
+			if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+				continue;
+
+			unsigned char type = entry->d_type;
+			struct stat info;
+
+			// Some file systems don't report types
+			if (type == DT_UNKNOWN && ::fstatat(directory->fd, name, &info, AT_SYMLINK_NOFOLLOW) == 0)
+				type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : S_ISLNK(info.st_mode) ? DT_LNK : DT_UNKNOWN;
+
+			if (type == DT_DIR) {
+				subdirectories.emplace_back(name);
+			}
+			else if (type == DT_REG) {
+				if (hasExtension(name, walk.extensions))
+					files.emplace_back(name);
+			}
+			else if (type == DT_LNK && hasExtension(name, walk.extensions)) {
+				if (::fstatat(directory->fd, name, &info, 0) == 0 && S_ISREG(info.st_mode))
+					files.emplace_back(name);
+			}
+		}
+	}
+
+	const std::string prefix = (directory->path == "/") ? directory->path : directory->path + "/";
+#else
+	namespace fs = std::filesystem;
+
+	try {
+		const fs::path path = task.parent ? fs::path(task.parent->path) / task.name : fs::path(task.name);
+		directory->path = path.string();
+
+		std::error_code error;
+		fs::directory_iterator it(path, fs::directory_options::none, error);
+		if (error) {
+			worker.skipped.push_back(SkippedDirectory{ directory->path, error });
+			return true;
+		}
+
+		for (; it != fs::directory_iterator(); it.increment(error)) {
+			if (error) {
+				worker.skipped.push_back(SkippedDirectory{ directory->path, error });
+				break;
+			}
+
+			const std::string name = it->path().filename().string();
+			if (it->is_symlink(error)) {
+				if (hasExtension(name, walk.extensions) && it->is_regular_file(error))
+					files.push_back(name);
+			}
+			else if (it->is_directory(error)) {
+				subdirectories.push_back(name);
+			}
+			else if (it->is_regular_file(error) && hasExtension(name, walk.extensions)) {
+				files.push_back(name);
+			}
+		}
+	}
+	catch (...) {
+		// Names that can't be represented are skipped along with their directory
+		worker.skipped.push_back(SkippedDirectory{ directory->path.empty() ? task.name : directory->path, std::make_error_code(std::errc::illegal_byte_sequence) });
+		return true;
+	}
+
+	const std::string prefix = (fs::path(directory->path) / "").string();
+#endif
+
+	std::sort(files.begin(), files.end());
+	for (const std::string& file : files) {
+		worker.found.push_back(prefix + file);
+		if (worker.found.size() >= batch_size)
+			walk.hand(worker.found);
+	}
+
+	if (subdirectories.empty())
+		return true;
+
+	// Pushed in reverse, so the owner walks them in name order
+	std::sort(subdirectories.begin(), subdirectories.end());
+	walk.pending += subdirectories.size();
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		for (auto it = subdirectories.rbegin(); it != subdirectories.rend(); it++)
+			worker.tasks.push_back(Task{ directory, std::move(*it) });
+	}
+
+	walk.queued += subdirectories.size();
+	walk.wake();
+	return true;
+}
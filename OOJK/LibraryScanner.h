@@ -0,0 +1,54 @@
+/**
+ @file	LibraryScanner.h.
+
+ @brief	Declares the library scanner class.
+		Walks directory trees in parallel to find audio files and builds playlists of them.
+		Every thread walks its own queue of directories depth first and steals the
+		oldest directories of other threads when it runs out, so a single deep or wide
+		directory doesn't leave the other threads idle.
+		On Linux directories are opened relative to their parent's descriptor and listed
+		with getdents64 in large chunks, elsewhere std::filesystem is used.
+		Idle threads sleep on a condition variable until a directory is queued or the walk ends.
+		A directory that can't be opened for lack of descriptors is tried again later,
+		directories that still can't be listed are reported to the caller.
+ */
+
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+class Playlist;
+
+typedef std::function<void(std::vector<std::string>&&)> PathConsumer;	/** Receives batches of found paths */
+
+/** A directory that couldn't be listed, its files and subdirectories are missing from the walk */
+struct SkippedDirectory {
+	std::string path;							/** Full pathname of the directory */
+	std::error_code error;						/** Why it couldn't be listed */
+};
+
+class LibraryScanner {
+
+private:
+	struct Directory;							/** An open directory */
+	struct Task;								/** A directory waiting to be walked */
+	struct Worker;								/** Queue and results of one thread */
+	struct Walk;								/** State shared by all threads of a walk */
+
+	const static size_t batch_size;				/** Number of paths handed over at a time */
+	const static size_t queue_size;				/** Number of paths queued for metadata reads at a time */
+	const static unsigned int max_attempts;		/** Most times a directory is tried while out of descriptors */
+
+	static void work(Walk& walk, size_t id);	/** Walks directories until there are none left */
+	static bool list(Walk& walk, Worker& worker, Task& task);	/** Lists a directory, queueing subdirectories */
+
+public:
+	static const std::vector<std::string> default_extensions;	/** Extensions of common audio files */
+
+	static std::vector<SkippedDirectory> scan(const std::vector<std::string>& roots, const PathConsumer& consumer, const std::vector<std::string>& extensions = default_extensions, unsigned int threads = 0);	/** Finds files under root directories */
+	static unsigned int ingest(Playlist& playlist, const std::vector<std::string>& roots, bool read_metadata = false, const std::vector<std::string>& extensions = default_extensions, unsigned int threads = 0, std::vector<SkippedDirectory>* skipped = nullptr);	/** Adds files under root directories to a playlist */
+	static bool hasExtension(const std::string& name, const std::vector<std::string>& extensions);	/** Tells if a file name ends with one of the extensions */
+};
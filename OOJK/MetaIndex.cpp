@@ -0,0 +1,239 @@
+/**
+ @file	MetaIndex.cpp.
+
+ @brief	Implements the metadata index class
+ */
+
+#include "MetaIndex.h"
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ @fn	MetaIndex::MetaIndex(const std::vector<std::string>& f)
+
+ @brief	Construction using the metadata keys to index
+
+ @param	f	Metadata keys (e.g. "artist") whose values are indexed
+ */
+
+MetaIndex::MetaIndex(const std::vector<std::string>& f) :
+	fields(f),
+	values(f.size())
+{
+
+}
+
+/**
+ @fn	void MetaIndex::index(EntryOrder::Id entry, const Song& song)
+
+ @brief	Adds the song's field values to the posting lists.
+		Only evaluated songs are indexed, indexing must never cause file reads.
+		Proxy songs get indexed once they are evaluated.
+
+ @param	entry	Entry id of the song
+		song	The song to index
+ */
+
+void MetaIndex::index(EntryOrder::Id entry, const Song& song) {
+
+	if (!song.isEvaluated())
+		return;
+
+	std::shared_ptr<MetaContainer> metadata = song.evaluate();
+	if (!metadata)
+		return;
+
+	for (size_t i = 0; i < fields.size(); i++) {
+		auto it = metadata->find(fields[i]);
+		if (it != metadata->end())
+			Postings::insert(values[i][it->second], entry);
+	}
+}
+
+/**
+ @fn	void MetaIndex::unindex(EntryOrder::Id entry, const Song& song)
+
+ @brief	Removes the song's field values from the posting lists.
+		Values left without any songs are dropped.
+
+ @param	entry	Entry id of the song
+		song	The song to remove from the index
+ */
+
+void MetaIndex::unindex(EntryOrder::Id entry, const Song& song) {
+
+	if (!song.isEvaluated())
+		return;
+
+	std::shared_ptr<MetaContainer> metadata = song.evaluate();
+	if (!metadata)
+		return;
+
+	for (size_t i = 0; i < fields.size(); i++) {
+		auto field = metadata->find(fields[i]);
+		if (field == metadata->end())
+			continue;
+
+		auto it = values[i].find(field->second);
+		if (it == values[i].end())
+			continue;
+
+		Postings::erase(it->second, entry);
+		if (it->second.empty())
+			values[i].erase(it);
+	}
+}
+
+/**
+ @fn	PostingList MetaIndex::find(const MetaContainer& filter) const
+
+ @brief	Finds songs matching every key-value pair of the filter.
+		Posting lists are intersected starting from the shortest one,
+		so the cost is bound by the rarest value in the filter.
+		The matching entries are then turned into positions.
+
+ @param	filter	Key-value pairs that must all match. Keys must be indexed fields.
+
+ @return	Ascending positions of the matching songs
+ */
+
+PostingList MetaIndex::find(const MetaContainer& filter) const {
+
+	std::vector<const PostingList*> lists;
+	lists.reserve(filter.size());
+
+	for (auto const& pair : filter) {
+		auto field = std::find(fields.begin(), fields.end(), pair.first);
+		if (field == fields.end())
+			throw std::invalid_argument("Metadata field is not indexed");
+
+		const ValueIndex& index = values[field - fields.begin()];
+		auto it = index.find(pair.second);
+
+		// A value nobody has can't match anything
+		if (it == index.end())
+			return PostingList();
+
+		lists.push_back(&it->second);
+	}
+
+	if (lists.empty())
+		return PostingList();
+
+	std::sort(lists.begin(), lists.end(), [](const PostingList* a, const PostingList* b) {
+		return a->size() < b->size();
+	});
+
+	PostingList result = *lists.front();
+	for (auto it = lists.begin() + 1; it != lists.end() && !result.empty(); it++)
+		result = Postings::intersect(result, **it);
+
+	return order.toPositions(result);
+}
+
+/**
+ @fn	PostingList MetaIndex::find(const std::string& field, const std::string& value) const
+
+ @brief	Finds songs having the given value in a field
+
+ @param	field	Indexed metadata key
+		value	Value to look for
+
+ @return	Ascending positions of the matching songs
+ */
+
+PostingList MetaIndex::find(const std::string& field, const std::string& value) const {
+	return find(MetaContainer{ { field, value } });
+}
+
+/**
+ @fn	std::vector<std::string> MetaIndex::getValues(const std::string& field) const
+
+ @brief	Lists the distinct values of an indexed field, e.g. all artists in the playlist
+
+ @param	field	Indexed metadata key
+
+ @return	Distinct values in ascending order
+ */
+
+std::vector<std::string> MetaIndex::getValues(const std::string& field) const {
+
+	auto it = std::find(fields.begin(), fields.end(), field);
+	if (it == fields.end())
+		throw std::invalid_argument("Metadata field is not indexed");
+
+	std::vector<std::string> result;
+	for (auto const& pair : values[it - fields.begin()])
+		result.push_back(pair.first);
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+/**
+ @fn	void MetaIndex::reset(const SongList& songs)
+
+ @brief	Rebuilds the index from the playlist's songs, whose entry ids are their positions
+
+ @param	songs	All songs of the observed playlist
+ */
+
+void MetaIndex::reset(const SongList& songs) {
+
+	for (ValueIndex& index : values)
+		index.clear();
+
+	order.reset(songs.size());
+	EntryOrder::Id entry = 0;
+	for (auto const& song : songs)
+		index(entry++, *song);
+}
+
+/**
+ @fn	void MetaIndex::inserted(size_t position, const Song& song)
+
+ @brief	Indexes a song inserted to the playlist. Only the song's own posting lists
+		are touched, wherever it was inserted, in O(log n) plus their lengths.
+
+ @param	position	Position the song was inserted at
+		song		The inserted song
+ */
+
+void MetaIndex::inserted(size_t position, const Song& song) {
+	index(order.insert(position), song);
+}
+
+/**
+ @fn	void MetaIndex::erasing(const std::vector<size_t>& positions, const SongList& songs)
+
+ @brief	Drops songs about to be erased from their own posting lists.
+		Postings of the other songs keep their entry ids, so nothing is renumbered.
+
+ @param	positions	Ascending positions of the songs to be erased
+		songs		All songs of the observed playlist, before the removal
+ */
+
+void MetaIndex::erasing(const std::vector<size_t>& positions, const SongList& songs) {
+
+	for (const size_t position : positions)
+		unindex(order.at(position), *songs[position]);
+
+	order.erase(positions);
+}
+
+/**
+ @fn	void MetaIndex::replaced(size_t position, const Song& before, const Song& after)
+
+ @brief	Re-indexes a song that was replaced, e.g. a ProxySong promoted to a ConcreteSong
+
+ @param	position	Position of the replaced song
+		before		The song that was replaced
+		after		The song now at position
+ */
+
+void MetaIndex::replaced(size_t position, const Song& before, const Song& after) {
+
+	const EntryOrder::Id entry = order.at(position);
+	unindex(entry, before);
+	index(entry, after);
+}
@@ -0,0 +1,42 @@
+/**
+ @file	MetaIndex.h.
+
+ @brief	Declares the metadata index class.
+		An inverted index from metadata values (artist, album, genre, year) to the songs
+		carrying them. Attach it to a Playlist to answer field filters
+		without walking the songs and their metadata maps.
+		Posting lists hold entry ids, which stay put when songs are inserted or erased before
+		them, and are turned into positions when a query is answered.
+ */
+
+#pragma once
+#include <string>
+#include <unordered_map>
+#include "PlaylistObserver.h"
+#include "PostingList.h"
+#include "EntryOrder.h"
+
+class MetaIndex : public PlaylistObserver {
+
+private:
+	typedef std::unordered_map<std::string, PostingList> ValueIndex;	/** Maps a field value to entry ids of songs having it */
+
+	std::vector<std::string> fields;	/** Metadata keys that are indexed */
+	std::vector<ValueIndex> values;		/** One value index per indexed field, in the order of fields */
+	EntryOrder order;					/** Entry ids of the songs of the observed playlist, by position */
+
+	void index(EntryOrder::Id entry, const Song& song);		/** Adds song's values to the posting lists */
+	void unindex(EntryOrder::Id entry, const Song& song);	/** Removes song's values from the posting lists */
+
+public:
+	explicit MetaIndex(const std::vector<std::string>& fields = { "artist", "album", "genre", "year" });	/** Construction using the metadata keys to index */
+
+	PostingList find(const MetaContainer& filter) const;						/** Returns positions of songs matching all key-value pairs */
+	PostingList find(const std::string& field, const std::string& value) const;	/** Returns positions of songs with given field value */
+	std::vector<std::string> getValues(const std::string& field) const;		/** Returns all distinct indexed values of a field */
+
+	void reset(const SongList& songs) override;										/** Rebuilds the index from scratch */
+	void inserted(size_t position, const Song& song) override;						/** Indexes an inserted song */
+	void erasing(const std::vector<size_t>& positions, const SongList& songs) override;	/** Drops erased songs from the index */
+	void replaced(size_t position, const Song& before, const Song& after) override;	/** Re-indexes a replaced song */
+};
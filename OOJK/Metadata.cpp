@@ -5,9 +5,20 @@
  */
 
 #include "Metadata.h"
+#include "ReadPlanner.h"
+#include "TagReader.h"
+#include <algorithm>
+#include <thread>
 
 // Initialize static members
 std::map<std::string, std::shared_ptr<MetaContainer>> Metadata::cache = {};
+std::mutex Metadata::cache_mutex;
+std::map<std::string, std::shared_future<void>> Metadata::pending = {};
+std::map<std::string, MountLatency> Metadata::latencies = {};
+std::map<std::string, FileStamp> Metadata::stamps = {};
+const unsigned int Metadata::stall_reads = 20;
+const std::chrono::milliseconds Metadata::min_stall(1000);
+Metadata::Readers Metadata::readers;
 
 /**
  @fn	std::shared_ptr<MetaContainer> Metadata::getFileMetadata(const std::string &path)
@@ -15,6 +26,7 @@ std::map<std::string, std::shared_ptr<MetaContainer>> Metadata::cache = {};
  @brief	Gets file metadata corresponding given path.
 		Tries to find and return the metadata from cache. If no entry for the path exists,
 		calls readFileMetadata() to acquire metadata, save it in the cache and return it.
+		Safe to call from several threads.
 
  @param	path	Full pathname of the file to read metadata from.
 
@@ -24,15 +36,462 @@ std::map<std::string, std::shared_ptr<MetaContainer>> Metadata::cache = {};
 std::shared_ptr<MetaContainer> Metadata::getFileMetadata(const std::string &path) {
 
 	// Try to find metadata from cache
-	auto it = cache.find(path);
+	std::shared_future<void> reading;
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		auto it = cache.find(path);
 
-	if (it != cache.end())
-		return it->second;
+		if (it != cache.end())
+			return it->second;
 
-	// Load and cache metadata for later use
-	cache[path] = std::make_shared<MetaContainer>(readFileMetadata(path));
+		// Wait for a background read of the same file instead of reading it again
+		auto read = pending.find(path);
+		if (read != pending.end())
+			reading = read->second;
+	}
 
-	return cache[path];
+	if (reading.valid()) {
+		reading.wait();
+
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		auto it = cache.find(path);
+		if (it != cache.end())
+			return it->second;
+	}
+
+	// Read without holding the lock, so other threads aren't blocked by the file access.
+	// The file is stamped before reading, so a change during the read shows up later.
+	const auto start = std::chrono::steady_clock::now();
+	const FileStamp stamp = FileStatus::stat(path);
+	auto metadata = std::make_shared<MetaContainer>(readFileMetadata(path));
+
+	// Load and cache metadata for later use. If another thread read the same file meanwhile, its result is kept.
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	recordRead(getMount(path), std::chrono::steady_clock::now() - start);
+	return store(path, stamp, std::move(metadata));
+}
+
+/**
+ @fn	std::shared_ptr<MetaContainer> Metadata::getFileMetadata(const std::string &path, std::chrono::steady_clock::time_point deadline)
+
+ @brief	Gets file metadata corresponding given path, giving up at deadline.
+		See the overload for several paths.
+
+ @param	path		Full pathname of the file to read metadata from.
+		deadline	Point of time to give up waiting at
+
+ @return	Shared pointer to file metadata, nullptr if it wasn't available before deadline.
+ */
+
+std::shared_ptr<MetaContainer> Metadata::getFileMetadata(const std::string &path, std::chrono::steady_clock::time_point deadline) {
+	return getFileMetadata(std::vector<std::string>{ path }, deadline).front();
+}
+
+/**
+ @fn	std::vector<std::shared_ptr<MetaContainer>> Metadata::getFileMetadata(const std::vector<std::string> &paths, std::chrono::steady_clock::time_point deadline)
+
+ @brief	Gets file metadata of several files, giving up at deadline.
+		Uncached files are read in the background, one thread per mount, so a stalled mount
+		doesn't hold up the others. Reads that miss the deadline keep running and cache
+		their results when done, so a later call finds them.
+		Reads already in progress for the same files are waited for instead of starting others.
+
+ @param	paths		Full pathnames of the files to read metadata from.
+		deadline	Point of time to give up waiting at
+
+ @return	Shared pointers to file metadata in the order of paths, nullptr for those not available before deadline.
+ */
+
+std::vector<std::shared_ptr<MetaContainer>> Metadata::getFileMetadata(const std::vector<std::string> &paths, std::chrono::steady_clock::time_point deadline) {
+
+	std::vector<std::shared_ptr<MetaContainer>> result(paths.size());
+	std::vector<std::shared_future<void>> readings;
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		std::map<std::string, std::vector<std::string>> unread;
+
+		for (size_t i = 0; i < paths.size(); i++) {
+			auto it = cache.find(paths[i]);
+			if (it != cache.end()) {
+				result[i] = it->second;
+				continue;
+			}
+
+			auto read = pending.find(paths[i]);
+			if (read != pending.end())
+				readings.push_back(read->second);
+			else
+				unread[getMount(paths[i])].push_back(paths[i]);
+		}
+
+		for (auto& mount : unread)
+			readings.push_back(startRead(mount.first, std::move(mount.second)));
+	}
+
+	if (readings.empty())
+		return result;
+
+	for (auto const& reading : readings)
+		reading.wait_until(deadline);
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (result[i])
+			continue;
+
+		auto it = cache.find(paths[i]);
+		if (it != cache.end())
+			result[i] = it->second;
+		else
+			latencies[getMount(paths[i])].timeouts++;
+	}
+
+	return result;
+}
+
+/**
+ @fn	Metadata::Readers::~Readers()
+
+ @brief	Joins all reader threads at exit, so none writes the cache after it's gone.
+		A reader stuck on a hung file system holds up the exit until its reads fail.
+ */
+
+Metadata::Readers::~Readers() {
+
+	for (std::thread& reader : running) {
+		if (reader.joinable())
+			reader.join();
+	}
+}
+
+/**
+ @fn	std::shared_future<void> Metadata::startRead(const std::string &mount, std::vector<std::string> &&paths)
+
+ @brief	Starts reading metadata of files on one mount on a reader thread, which caches
+		results a batch at a time. Files are read in the order planned by ReadPlanner. The caller
+		doesn't wait for the thread, so a hung file system can't hold it up. The thread is joined
+		once it's done, when the next reader starts, or at exit. cache_mutex must be held.
+
+ @param	mount	The mount the files are on
+		paths	Full pathnames of the files to read metadata from.
+
+ @return	Future becoming ready when all files are read
+
+ @throws std::system_error if the thread can't be started, the files are left unread then
+ */
+
+std::shared_future<void> Metadata::startRead(const std::string &mount, std::vector<std::string> &&paths) {
+
+	// Readers done meanwhile are joined, they hold the lock no more
+	for (const std::thread::id id : readers.finished) {
+		for (auto it = readers.running.begin(); it != readers.running.end(); it++) {
+			if (it->get_id() == id) {
+				it->join();
+				readers.running.erase(it);
+				break;
+			}
+		}
+	}
+	readers.finished.clear();
+
+	auto promise = std::make_shared<std::promise<void>>();
+	std::shared_future<void> reading = promise->get_future().share();
+	size_t started = 0;
+
+	// A mount that was idle starts counting its progress now
+	MountLatency& latency = latencies[mount];
+	if (latency.pending == 0)
+		latency.progress = std::chrono::steady_clock::now();
+
+	try {
+		for (; started < paths.size(); started++) {
+			pending[paths[started]] = reading;
+			latency.pending++;
+		}
+
+		// Room for the thread to report itself finished without allocating
+		readers.finished.reserve(readers.running.size() + 1);
+		readers.running.emplace_back([mount, paths, promise]() {
+			readInBackground(mount, paths);
+			{
+				std::lock_guard<std::mutex> lock(cache_mutex);
+				readers.finished.push_back(std::this_thread::get_id());
+			}
+			promise->set_value();
+		});
+	}
+	catch (...) {
+		for (size_t i = 0; i < started; i++)
+			release(mount, paths[i]);
+		throw;
+	}
+
+	return reading;
+}
+
+/**
+ @fn	void Metadata::readInBackground(const std::string &mount, const std::vector<std::string> &paths)
+
+ @brief	Reads metadata of files on one mount and caches it, a window of files at a time.
+		A window that fails to read is read again file by file, so one unreadable file
+		doesn't cost the others. Files that can't be read are left uncached, so they stay ProxySongs.
+		Every file's background read is ended, read or not, so later calls can try again.
+
+ @param	mount	The mount the files are on
+		paths	Full pathnames of the files to read metadata from.
+ */
+
+void Metadata::readInBackground(const std::string &mount, const std::vector<std::string> &paths) {
+
+	// Files are read a window at a time, so results arrive in the cache as they go
+	const size_t window = 256;
+	std::vector<size_t> order(paths.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	size_t done = 0;
+
+	try {
+		// Files that can't be planned are read in the order given
+		try {
+			order = ReadPlanner::plan(paths);
+		}
+		catch (...) {
+		}
+
+		while (done < order.size()) {
+
+			std::vector<std::string> batch;
+			for (size_t i = done; i < std::min(done + window, order.size()); i++)
+				batch.push_back(paths[order[i]]);
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<FileStamp> read_stamps;
+			std::vector<MetaContainer> metadata;
+
+			try {
+				read_stamps = FileStatus::stat(batch, 1);
+				metadata = readFileMetadata(batch);
+			}
+			catch (...) {
+				metadata.clear();
+			}
+
+			if (!metadata.empty()) {
+				const auto each = (std::chrono::steady_clock::now() - start) / batch.size();
+
+				std::lock_guard<std::mutex> lock(cache_mutex);
+				for (size_t i = 0; i < batch.size(); i++) {
+					recordRead(mount, each);
+					store(batch[i], read_stamps[i], std::make_shared<MetaContainer>(std::move(metadata[i])));
+					release(mount, batch[i]);
+				}
+				done += batch.size();
+				continue;
+			}
+
+			for (const std::string& path : batch) {
+
+				start = std::chrono::steady_clock::now();
+				FileStamp stamp{};
+				std::shared_ptr<MetaContainer> read;
+
+				try {
+					stamp = FileStatus::stat(path);
+					read = std::make_shared<MetaContainer>(readFileMetadata(path));
+				}
+				catch (...) {
+					read.reset();
+				}
+
+				std::lock_guard<std::mutex> lock(cache_mutex);
+				if (read) {
+					recordRead(mount, std::chrono::steady_clock::now() - start);
+					store(path, stamp, std::move(read));
+				}
+				release(mount, path);
+				done++;
+			}
+		}
+	}
+	catch (...) {
+	}
+
+	// Files left after a failure are ended unread
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	for (; done < order.size(); done++)
+		release(mount, paths[order[done]]);
+}
+
+/**
+ @fn	void Metadata::release(const std::string &mount, const std::string &path)
+
+ @brief	Ends the background read of a file, whether it was read or not, which counts as
+		progress of its mount. cache_mutex must be held.
+
+ @param	mount	The mount the file is on
+		path	Full pathname of the file
+ */
+
+void Metadata::release(const std::string &mount, const std::string &path) {
+
+	pending.erase(path);
+
+	MountLatency& latency = latencies[mount];
+	latency.pending--;
+	latency.progress = std::chrono::steady_clock::now();
+}
+
+/**
+ @fn	std::shared_ptr<MetaContainer> Metadata::store(const std::string& path, const FileStamp& stamp, std::shared_ptr<MetaContainer>&& metadata)
+
+ @brief	Caches metadata of a file along with the stamp of the file when it was read.
+		If the file is cached already, e.g. read by another thread meanwhile, the cached metadata is kept.
+		cache_mutex must be held.
+
+ @param	path		Full pathname of the file
+		stamp		Stamp of the file taken before reading
+		metadata	The metadata read
+
+ @return	The cached metadata
+ */
+
+std::shared_ptr<MetaContainer> Metadata::store(const std::string& path, const FileStamp& stamp, std::shared_ptr<MetaContainer>&& metadata) {
+
+	auto cached = cache.emplace(path, std::move(metadata));
+	if (cached.second)
+		stamps[path] = stamp;
+	return cached.first->second;
+}
+
+/**
+ @fn	void Metadata::recordRead(const std::string& mount, std::chrono::steady_clock::duration time)
+
+ @brief	Adds a finished read to the statistics of a mount. cache_mutex must be held.
+
+ @param	mount	The mount read from
+		time	Time the read took
+ */
+
+void Metadata::recordRead(const std::string& mount, std::chrono::steady_clock::duration time) {
+
+	const double ms = std::chrono::duration<double, std::milli>(time).count();
+	MountLatency& latency = latencies[mount];
+
+	// Recent reads weigh more, so a mount recovering from a stall is soon tried again
+	latency.average = (latency.reads == 0) ? ms : 0.8 * latency.average + 0.2 * ms;
+	latency.reads++;
+}
+
+/**
+ @fn	bool Metadata::isCached(const std::string &path)
+
+ @brief	Tells if metadata of a file is cached, so getting it costs no read
+
+ @param	path	Full pathname of the file
+
+ @return	TRUE if the metadata is cached
+ */
+
+bool Metadata::isCached(const std::string &path) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return cache.count(path) > 0;
+}
+
+/**
+ @fn	bool Metadata::canReadWithin(const std::string &path, std::chrono::steady_clock::duration budget)
+
+ @brief	Tells if metadata of a file is likely to be available within budget.
+		Cached files always are. Otherwise the mount must not be stalled, and its average
+		read time must fit the budget. A mount is stalled when it has background reads and
+		none of them has finished for stall_reads times its average read time, or min_stall
+		if that's longer. Progress is what counts, not the number of files queued, so a long
+		batch of reads on a healthy mount doesn't keep it from being tried.
+		Mounts not read from yet are given a try.
+
+ @param	path	Full pathname of the file
+		budget	Time available for reading
+
+ @return	TRUE if reading is worth trying
+ */
+
+bool Metadata::canReadWithin(const std::string &path, std::chrono::steady_clock::duration budget) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	if (cache.count(path) > 0)
+		return true;
+
+	auto it = latencies.find(getMount(path));
+	if (it == latencies.end())
+		return true;
+
+	const MountLatency& latency = it->second;
+	if (latency.pending > 0) {
+		const auto idle = std::chrono::steady_clock::now() - latency.progress;
+		const auto patience = std::max<std::chrono::steady_clock::duration>(min_stall,
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(stall_reads * latency.average)));
+		if (idle > patience)
+			return false;
+	}
+
+	return latency.reads == 0 || latency.average <= std::chrono::duration<double, std::milli>(budget).count();
+}
+
+/**
+ @fn	void Metadata::reportRead(const std::string &path, std::chrono::steady_clock::duration time)
+
+ @brief	Adds a read of a file timed elsewhere, e.g. by a player reading the file itself,
+		to the statistics of its mount
+
+ @param	path	Full pathname of the file read
+		time	Time the read took
+ */
+
+void Metadata::reportRead(const std::string &path, std::chrono::steady_clock::duration time) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	recordRead(getMount(path), time);
+}
+
+/**
+ @fn	MountLatency Metadata::getMountLatency(const std::string &path)
+
+ @brief	Returns read statistics of the mount holding a path
+
+ @param	path	Full pathname of a file on the mount
+
+ @return	Statistics of the mount, all zero if nothing was read from it yet
+ */
+
+MountLatency Metadata::getMountLatency(const std::string &path) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	auto it = latencies.find(getMount(path));
+	return (it != latencies.end()) ? it->second : MountLatency{ 0.0, 0, 0, 0, std::chrono::steady_clock::time_point() };
+}
+
+/**
+ @fn	std::string Metadata::getMount(const std::string &path)
+
+ @brief	Returns the mount a path is considered to be on.
+		Approximated by the first two directories of the path, e.g. /mnt/nas or C:\Music,
+		which tells network shares and local disks apart in typical layouts.
+
+ @param	path	Full pathname of a file
+
+ @return	Path of the mount, empty for a path without directories
+ */
+
+std::string Metadata::getMount(const std::string &path) {
+
+	size_t end = path.find_first_of("/\\", 1);
+	if (end != std::string::npos)
+		end = path.find_first_of("/\\", end + 1);
+	if (end == std::string::npos)
+		end = path.find_last_of("/\\");
+
+	return (end == std::string::npos) ? std::string() : path.substr(0, end);
 }
 
 /**
@@ -47,22 +506,198 @@ std::shared_ptr<MetaContainer> Metadata::getFileMetadata(const std::string &path
  */
 
 MetaContainer Metadata::readFileMetadata(const std::string &path) {
+	return readFileMetadata(std::vector<std::string>{ path }).front();
+}
 
-	// Figure out filename from path. 
-	// If no folder delimeters (/ or \) are found, use the whole string.
-	size_t last_delimeter = path.find_last_of("/\\");
-	last_delimeter = (last_delimeter == std::string::npos) ? 0 : (last_delimeter + 1);
-	std::string filename = path.substr(last_delimeter);
+/**
+ @fn	std::vector<MetaContainer> Metadata::readFileMetadata(const std::vector<std::string> &paths)
+
+ @brief	Reads metadata of several files at once, see TagReader for how the files are read.
+		Fields found in a file's ID3v2 tag override the defaults derived from its path.
+
+ @param	paths	Full pathnames of the files.
+
+ @return	The file metadata containers, in the order of paths.
+ */
+
+std::vector<MetaContainer> Metadata::readFileMetadata(const std::vector<std::string> &paths) {
+
+	const std::vector<std::string> tags = TagReader::read(paths);
+
+	std::vector<MetaContainer> result;
+	result.reserve(paths.size());
+
+	for (size_t i = 0; i < paths.size(); i++) {
+
+		const std::string& path = paths[i];
+
+		// Figure out filename from path. 
+		// If no folder delimeters (/ or \) are found, use the whole string.
+		size_t last_delimeter = path.find_last_of("/\\");
+		last_delimeter = (last_delimeter == std::string::npos) ? 0 : (last_delimeter + 1);
+		std::string filename = path.substr(last_delimeter);
 	
-	// Use some dummmy data as metadata to represent mp3 IDV3 tags
-	MetaContainer metadata;
+		// Use some dummmy data as metadata for files without tags
+		MetaContainer metadata;
+
+		metadata["copyright"] = "Some One";
+		metadata["artist"] = "Some One";
+		metadata["album"] = "The Album";
+		metadata["title"] = filename;
+
+		for (auto& field : TagReader::parse(tags[i])) {
+			if (!field.second.empty())
+				metadata[field.first] = std::move(field.second);
+		}
+
+		result.push_back(std::move(metadata));
+	}
+
+	return result;
+}
+
+/**
+ @fn	void Metadata::prefetch(const std::vector<std::string> &paths)
+
+ @brief	Reads metadata of files not cached yet in one batch and caches it,
+		so evaluating their songs one by one afterwards costs no reads.
+
+ @param	paths	Full pathnames of the files, in the order they are best read in.
+ */
+
+void Metadata::prefetch(const std::vector<std::string> &paths) {
+
+	std::vector<std::string> unread;
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		for (const std::string& path : paths) {
+			if (cache.count(path) == 0 && pending.count(path) == 0)
+				unread.push_back(path);
+		}
+	}
+
+	if (unread.empty())
+		return;
+
+	const auto start = std::chrono::steady_clock::now();
+	const std::vector<FileStamp> read_stamps = FileStatus::stat(unread);
+	std::vector<MetaContainer> metadata = readFileMetadata(unread);
+	const auto each = (std::chrono::steady_clock::now() - start) / unread.size();
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	for (size_t i = 0; i < unread.size(); i++) {
+		recordRead(getMount(unread[i]), each);
+		store(unread[i], read_stamps[i], std::make_shared<MetaContainer>(std::move(metadata[i])));
+	}
+}
+
+/**
+ @fn	void Metadata::queue(const std::vector<std::string> &paths)
+
+ @brief	Starts reading metadata of files not cached or being read yet in the background,
+		one reader per mount, and returns at once. Songs evaluated later find their
+		metadata cached, or wait only for the read in progress.
+
+ @param	paths	Full pathnames of the files
+ */
+
+void Metadata::queue(const std::vector<std::string> &paths) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	std::map<std::string, std::vector<std::string>> unread;
+
+	for (const std::string& path : paths) {
+		if (cache.count(path) == 0 && pending.count(path) == 0)
+			unread[getMount(path)].push_back(path);
+	}
+
+	for (auto& mount : unread)
+		startRead(mount.first, std::move(mount.second));
+}
+
+/**
+ @fn	bool Metadata::getFileStamp(const std::string &path, FileStamp &stamp)
+
+ @brief	Returns the stamp of a file taken when its metadata was read, to tell if the file has changed since
+
+ @param	path			Full pathname of the file
+ @param [out]	stamp	Set to the stamp if there is one
+
+ @return	TRUE if metadata of the file is cached along with a stamp
+ */
+
+bool Metadata::getFileStamp(const std::string &path, FileStamp &stamp) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	auto it = stamps.find(path);
+	if (it == stamps.end())
+		return false;
+
+	stamp = it->second;
+	return true;
+}
+
+/**
+ @fn	void Metadata::invalidate(const std::vector<std::string> &paths)
+
+ @brief	Forgets cached metadata of files, e.g. after they have changed, so it's read again when needed
+
+ @param	paths	Full pathnames of the files
+ */
+
+void Metadata::invalidate(const std::vector<std::string> &paths) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	for (const std::string& path : paths) {
+		cache.erase(path);
+		stamps.erase(path);
+	}
+}
+
+/**
+ @fn	unsigned int Metadata::relocate(const PathRelocator &relocator)
+
+ @brief	Moves cached metadata and stamps of files under relocated prefixes to their new paths,
+		without reading the files again. Each cached file is matched once. Entries already
+		cached at a new path are replaced, as they describe what was there before the move.
+
+ @param	relocator	Old and new prefixes
+
+ @return	Number of relocated files
+ */
+
+unsigned int Metadata::relocate(const PathRelocator &relocator) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	std::vector<std::pair<std::string, std::shared_ptr<MetaContainer>>> moved;
+	std::vector<std::pair<std::string, FileStamp>> moved_stamps;
+	std::string path;
+
+	// Moved entries are put back only after all are taken out, so prefixes may swap places
+	for (auto it = cache.begin(); it != cache.end(); ) {
+		if (!relocator.relocate(it->first, path)) {
+			++it;
+			continue;
+		}
+
+		auto stamp = stamps.find(it->first);
+		if (stamp != stamps.end()) {
+			moved_stamps.emplace_back(path, stamp->second);
+			stamps.erase(stamp);
+		}
+
+		moved.emplace_back(path, std::move(it->second));
+		it = cache.erase(it);
+	}
 
-	metadata["copyright"] = "Some One";
-	metadata["artist"] = "Some One";
-	metadata["album"] = "The Album";
-	metadata["title"] = filename;
+	for (auto& entry : moved) {
+		stamps.erase(entry.first);
+		cache[entry.first] = std::move(entry.second);
+	}
+	for (auto& entry : moved_stamps)
+		stamps[entry.first] = entry.second;
 
-	return metadata;
+	return static_cast<unsigned int>(moved.size());
 }
 
 /**
@@ -73,6 +708,7 @@ MetaContainer Metadata::readFileMetadata(const std::string &path) {
  */
 
 unsigned int Metadata::getCount() noexcept {
+	std::lock_guard<std::mutex> lock(cache_mutex);
 	return cache.size();
 }
 
@@ -84,5 +720,7 @@ unsigned int Metadata::getCount() noexcept {
  */
 
 void Metadata::clear() noexcept {
+	std::lock_guard<std::mutex> lock(cache_mutex);
 	cache.clear();
+	stamps.clear();
 }
\ No newline at end of file
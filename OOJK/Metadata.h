@@ -9,16 +9,67 @@
 #pragma once
 #include <vector>
 #include <map>
+#include <string>
 #include <memory>
+#include <mutex>
+#include <chrono>
+#include <future>
+#include <list>
+#include <thread>
+#include "FileStatus.h"
+#include "PathRelocator.h"
 
 typedef std::map<std::string, std::string> MetaContainer;	/** Defines structure for the metadata as a map of key-value pairs */
 
+/** Read statistics of a mount, used to decide whether reading from it fits a time budget */
+struct MountLatency {
+	double average;				/** Moving average of read time in milliseconds */
+	unsigned int reads;			/** Number of finished reads */
+	unsigned int timeouts;		/** Number of reads that missed their deadline */
+	unsigned int pending;		/** Number of reads in progress in the background */
+	std::chrono::steady_clock::time_point progress;	/** When a background read last finished, or reads were started on an idle mount */
+};
+
 class Metadata {
 private:
+	/** Background reader threads. Finished ones are joined when the next one starts, the rest at exit. */
+	struct Readers {
+		std::list<std::thread> running;				/** Threads started and not joined yet */
+		std::vector<std::thread::id> finished;		/** Threads done with their files, to be joined */
+
+		~Readers();									/** Joins all threads, so none outlives the cache */
+	};
+
 	static std::map<std::string, std::shared_ptr<MetaContainer>> cache;	/** Cached metadata is saved in a key-value map using the path as the key */
+	static std::mutex cache_mutex;											/** Guards the cache, songs may be evaluated from several threads */
+	static std::map<std::string, std::shared_future<void>> pending;			/** Background reads in progress by path */
+	static std::map<std::string, MountLatency> latencies;					/** Read statistics by mount */
+	static std::map<std::string, FileStamp> stamps;						/** Stamps of files when their metadata was read, by path */
+	const static unsigned int stall_reads;									/** Average read times without progress after which a mount with background reads is considered stalled */
+	const static std::chrono::milliseconds min_stall;						/** Shortest time without progress considered a stall */
+	static Readers readers;													/** Background reader threads, guarded by cache_mutex */
+
+	static void recordRead(const std::string& mount, std::chrono::steady_clock::duration time);	/** Updates statistics of a mount, cache_mutex must be held */
+	static std::shared_ptr<MetaContainer> store(const std::string& path, const FileStamp& stamp, std::shared_ptr<MetaContainer>&& metadata);	/** Caches metadata and the stamp it was read at, cache_mutex must be held */
+	static std::shared_future<void> startRead(const std::string &mount, std::vector<std::string> &&paths);	/** Reads metadata in the background, cache_mutex must be held */
+	static void readInBackground(const std::string &mount, const std::vector<std::string> &paths);	/** Reads and caches metadata on a reader thread */
+	static void release(const std::string &mount, const std::string &path);	/** Ends the background read of a file, cache_mutex must be held */
 public:
 	static std::shared_ptr<MetaContainer> getFileMetadata(const std::string &path);		/** Retrieves metadata corresponding a path */
+	static std::shared_ptr<MetaContainer> getFileMetadata(const std::string &path, std::chrono::steady_clock::time_point deadline);	/** Retrieves metadata if available before deadline */
+	static std::vector<std::shared_ptr<MetaContainer>> getFileMetadata(const std::vector<std::string> &paths, std::chrono::steady_clock::time_point deadline);	/** Retrieves metadata of files available before deadline */
+	static bool isCached(const std::string &path);						/** Tells if metadata of a file is cached */
+	static bool canReadWithin(const std::string &path, std::chrono::steady_clock::duration budget);	/** Tells if metadata is likely to be available in time */
+	static void reportRead(const std::string &path, std::chrono::steady_clock::duration time);	/** Adds a read timed elsewhere to the statistics of its mount */
+	static MountLatency getMountLatency(const std::string &path);		/** Returns read statistics of the mount holding a path */
+	static std::string getMount(const std::string &path);				/** Returns the mount a path is considered to be on */
 	static MetaContainer readFileMetadata(const std::string &path);		/** Reads metadata from a specified file */
+	static std::vector<MetaContainer> readFileMetadata(const std::vector<std::string> &paths);	/** Reads metadata from several files at once */
+	static void prefetch(const std::vector<std::string> &paths);		/** Reads and caches metadata of several files at once */
+	static void queue(const std::vector<std::string> &paths);			/** Starts reading metadata of files in the background */
+	static bool getFileStamp(const std::string &path, FileStamp &stamp);	/** Returns the stamp of a file when its metadata was read */
+	static void invalidate(const std::vector<std::string> &paths);		/** Forgets metadata of files, so it's read again */
+	static unsigned int relocate(const PathRelocator &relocator);		/** Moves cached metadata of relocated files to their new paths */
 	static unsigned int getCount() noexcept;							/** Returns number of songs have metadata resolved */
 	static void clear() noexcept;										/** Clears metadata */
 };
\ No newline at end of file
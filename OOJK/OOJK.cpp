@@ -19,6 +19,33 @@
 #include "Playlist.h"
 #include "ProxySong.h"
 #include "ConcreteSong.h"
+#include "MetaIndex.h"
+#include "TrigramIndex.h"
+#include "FuzzyIndex.h"
+#include "PrefixIndex.h"
+#include "PlaylistPatch.h"
+#include "EvaluationSession.h"
+#include "ReadPlanner.h"
+#include "ReadAhead.h"
+#include "LibraryScanner.h"
+#include "PathRelocator.h"
+#include "PathStore.h"
+#include "Library.h"
+#include "PlaylistRegistry.h"
+#include "BloomFilter.h"
+#include "PlaylistFingerprint.h"
+#include "EntryOrder.h"
+#include <filesystem>
+#include "TagReader.h"
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <atomic>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
 
 TEST_CASE("Print playlist", "[print_playlist]") {
 
@@ -294,6 +321,1658 @@ TEST_CASE("Print playlist", "[print_playlist]") {
 	Metadata::clear();	
 }
 
+TEST_CASE("Metadata index", "[meta_index]") {
+
+	auto makeSong = [](const std::string& path, const std::string& artist, const std::string& album) {
+		return ConcreteSong(path, std::make_shared<MetaContainer>(MetaContainer{ { "artist", artist }, { "album", album } }));
+	};
+
+	Playlist pl;
+	pl.add(makeSong("/music/a1.mp3", "Alpha", "First"));
+	pl.add(ProxySong("/music/unknown.mp3"));
+	pl.add(makeSong("/music/b1.mp3", "Beta", "First"));
+
+	auto index = std::make_shared<MetaIndex>();
+	pl.attach(index);
+
+	REQUIRE(index->find("artist", "Alpha") == PostingList{ 0 });
+	REQUIRE(index->find("album", "First") == PostingList{ 0, 2 });
+
+	// Additions are indexed as they happen
+	pl.add(makeSong("/music/a2.mp3", "Alpha", "Second"));
+	REQUIRE(index->find("artist", "Alpha") == PostingList{ 0, 3 });
+	REQUIRE(index->find(MetaContainer{ { "artist", "Alpha" }, { "album", "Second" } }) == PostingList{ 3 });
+	REQUIRE(index->find("artist", "Nobody").empty());
+
+	// Removals renumber the remaining positions
+	pl.remove(makeSong("/music/a1.mp3", "Alpha", "First"));
+	REQUIRE(index->find("artist", "Alpha") == PostingList{ 2 });
+	REQUIRE(index->find("album", "First") == PostingList{ 1 });
+	REQUIRE(pl.at(2).getPath() == "/music/a2.mp3");
+
+	// Proxy songs get indexed once evaluated
+	REQUIRE(index->find("artist", "Some One").empty());
+	pl.evaluate(ProxySong("/music/unknown.mp3"));
+	REQUIRE(index->find("artist", "Some One") == PostingList{ 0 });
+	REQUIRE(index->getValues("artist") == std::vector<std::string>{ "Alpha", "Beta", "Some One" });
+
+	REQUIRE_THROWS_AS(index->find("copyright", "Some One"), std::invalid_argument);
+
+	pl.detach(index);
+	pl.clear();
+	REQUIRE(index->find("artist", "Alpha") == PostingList{ 2 });
+
+	// Positional edits in a large playlist touch only the moved songs' postings
+	for (int i = 0; i < 20000; i++)
+		pl.add(makeSong("/music/many" + std::to_string(i) + ".mp3", "Artist " + std::to_string(i % 50), "Album " + std::to_string(i % 7)));
+	pl.attach(index);
+	for (int i = 0; i < 5000; i++) {
+		pl.move((i * 7919) % 20000, (i * 104729) % 20000);
+		if (i % 10 == 0) {
+			pl.eraseAt((i * 31) % pl.getCount());
+			pl.insertAt((i * 17) % pl.getCount(), makeSong("/music/new" + std::to_string(i) + ".mp3", "Artist 3", "Album 1"));
+		}
+	}
+
+	auto fresh = std::make_shared<MetaIndex>();
+	pl.attach(fresh);
+	REQUIRE(index->find("artist", "Artist 3") == fresh->find("artist", "Artist 3"));
+	REQUIRE(index->find(MetaContainer{ { "artist", "Artist 3" }, { "album", "Album 1" } }) == fresh->find(MetaContainer{ { "artist", "Artist 3" }, { "album", "Album 1" } }));
+	REQUIRE(index->find("album", "Album 6") == fresh->find("album", "Album 6"));
+
+	Metadata::clear();
+}
+
+TEST_CASE("Entry order of index postings", "[entry_order]") {
+
+	EntryOrder order;
+	std::vector<EntryOrder::Id> expected;
+
+	order.reset(100);
+	for (EntryOrder::Id i = 0; i < 100; i++)
+		expected.push_back(i);
+
+	// Mixed inserts and erases, some large enough to rebuild the tree
+	for (int i = 0; i < 2000; i++) {
+		const size_t position = (i * 7919) % (expected.size() + 1);
+		expected.insert(expected.begin() + position, order.insert(position));
+		if (i % 3 == 0) {
+			const std::vector<size_t> positions = { position / 2, position };
+			if (positions[0] != positions[1]) {
+				order.erase(positions);
+				expected.erase(expected.begin() + positions[1]);
+				expected.erase(expected.begin() + positions[0]);
+			}
+		}
+	}
+
+	std::vector<size_t> many;
+	for (size_t i = 0; i < expected.size(); i += 3)
+		many.push_back(i);
+	order.erase(many);
+	for (auto it = many.rbegin(); it != many.rend(); it++)
+		expected.erase(expected.begin() + *it);
+
+	REQUIRE(order.size() == expected.size());
+	bool consistent = true;
+	for (size_t i = 0; i < expected.size(); i++)
+		consistent = consistent && order.at(i) == expected[i] && order.position(expected[i]) == i;
+	REQUIRE(consistent);
+
+	// Erased ids are reused
+	const EntryOrder::Id reused = order.insert(0);
+	REQUIRE(reused < 2100);
+	expected.insert(expected.begin(), reused);
+
+	// Few and many ids turn into ascending positions
+	REQUIRE(order.toPositions(PostingList{ expected[5], expected[2] }) == PostingList{ 2, 5 });
+	PostingList all(expected.begin(), expected.end());
+	std::sort(all.begin(), all.end());
+	PostingList positions = order.toPositions(all);
+	REQUIRE(positions.size() == expected.size());
+	REQUIRE(positions.back() == expected.size() - 1);
+
+	REQUIRE_THROWS_AS(order.at(expected.size()), std::out_of_range);
+	REQUIRE_THROWS_AS(order.insert(expected.size() + 1), std::out_of_range);
+}
+
+TEST_CASE("Trigram substring search", "[trigram_index]") {
+
+	Playlist pl;
+	pl.add(ProxySong("/music/Queen/Bohemian Rhapsody.mp3"));
+	pl.add(ProxySong("/music/Abba/Waterloo.mp3"));
+	pl.add(ConcreteSong("/music/x.mp3", std::make_shared<MetaContainer>(MetaContainer{ { "artist", "Queensryche" }, { "title", "Silent Lucidity" } })));
+
+	auto index = std::make_shared<TrigramIndex>();
+	pl.attach(index);
+
+	// Case-insensitive matches in paths and metadata
+	REQUIRE(index->search("queen") == PostingList{ 0, 2 });
+	REQUIRE(index->search("WATERLOO") == PostingList{ 1 });
+	REQUIRE(index->search("lucid") == PostingList{ 2 });
+	REQUIRE(index->search("mp") == PostingList{ 0, 1, 2 });
+
+	// Short queries come from their own posting lists, an empty one matches all
+	REQUIRE(index->search("Q") == PostingList{ 0, 2 });
+	REQUIRE(index->search("n/") == PostingList{ 0 });
+	REQUIRE(index->search("zz").empty());
+	REQUIRE(index->search("") == PostingList{ 0, 1, 2 });
+
+	REQUIRE(index->search("nothing here").empty());
+
+	pl.remove(ProxySong("/music/Queen/Bohemian Rhapsody.mp3"));
+	REQUIRE(index->search("queen") == PostingList{ 1 });
+
+	// Evaluated metadata becomes searchable
+	REQUIRE(index->search("some one").empty());
+	pl.evaluate(ProxySong("/music/Abba/Waterloo.mp3"));
+	REQUIRE(index->search("some one") == PostingList{ 0 });
+
+	// All trigrams present, but not as a substring
+	pl.add(ProxySong("/abc/bca/cab"));
+	REQUIRE(index->search("bca") == PostingList{ 2 });
+	REQUIRE(index->search("abcab").empty());
+
+	Metadata::clear();
+}
+
+TEST_CASE("Trigram search after erasing", "[trigram_index]") {
+
+	Playlist pl;
+	pl.add(ProxySong("/music/Queen/Bohemian Rhapsody.mp3"));
+	pl.add(ProxySong("/music/Abba/Waterloo.mp3"));
+	pl.add(ProxySong("/music/Europe/The Final Countdown.mp3"));
+	pl.add(ProxySong("/music/Toto/Africa.mp3"));
+
+	auto index = std::make_shared<TrigramIndex>();
+	pl.attach(index);
+
+	// Songs before, between and after erased ones are still verified against their texts
+	pl.eraseAt(2);
+	REQUIRE(index->search("bohemian rhapsody") == PostingList{ 0 });
+	REQUIRE(index->search("abba/waterloo") == PostingList{ 1 });
+	REQUIRE(index->search("toto/africa") == PostingList{ 2 });
+	REQUIRE(index->search("final countdown").empty());
+
+	pl.remove(ProxySong("/music/Queen/Bohemian Rhapsody.mp3"));
+	REQUIRE(index->search("abba/waterloo") == PostingList{ 0 });
+	REQUIRE(index->search("toto/africa") == PostingList{ 1 });
+	REQUIRE(index->search("/music/") == PostingList{ 0, 1 });
+
+	// Moves and inserts in the middle keep results in step with positions
+	for (int i = 0; i < 3000; i++)
+		pl.add(ProxySong("/music/Band " + std::to_string(i % 30) + "/Song " + std::to_string(i) + ".mp3"));
+	for (int i = 0; i < 1000; i++) {
+		pl.move((i * 7919) % pl.getCount(), (i * 104729) % pl.getCount());
+		if (i % 10 == 0)
+			pl.insertAt((i * 17) % pl.getCount(), ProxySong("/music/Band 7/Extra " + std::to_string(i) + ".mp3"));
+	}
+
+	auto fresh = std::make_shared<TrigramIndex>();
+	pl.attach(fresh);
+	REQUIRE(index->search("band 7/") == fresh->search("band 7/"));
+	REQUIRE(index->search("waterloo") == fresh->search("waterloo"));
+	REQUIRE(index->search("extra") == fresh->search("extra"));
+	REQUIRE(index->search("7") == fresh->search("7"));
+	REQUIRE(index->search("extra").size() == 100);
+}
+
+TEST_CASE("Fuzzy song lookup", "[fuzzy_index]") {
+
+	REQUIRE(FuzzyIndex::distance("kitten", "sitting") == 3);
+	REQUIRE(FuzzyIndex::distance("", "abc") == 3);
+	REQUIRE(FuzzyIndex::distance("same", "same") == 0);
+	REQUIRE(FuzzyIndex::distance("kitten", "sitting", 1) == 2);
+
+	// Patterns longer than a machine word use the fallback
+	const std::string long_a(70, 'a');
+	const std::string long_b = long_a + "bb";
+	REQUIRE(FuzzyIndex::distance(long_a, long_b) == 2);
+	REQUIRE(FuzzyIndex::distance(long_b, long_a) == 2);
+
+	auto makeSong = [](const std::string& path, const std::string& artist, const std::string& title) {
+		return ConcreteSong(path, std::make_shared<MetaContainer>(MetaContainer{ { "artist", artist }, { "title", title } }));
+	};
+
+	Playlist pl;
+	pl.add(makeSong("/music/1.mp3", "Queen", "Bohemian Rhapsody"));
+	pl.add(makeSong("/music/2.mp3", "Abba", "Waterloo"));
+	pl.add(makeSong("/music/3.mp3", "Queen", "Radio Ga Ga"));
+	pl.add(ProxySong("/music/4.mp3"));
+
+	auto index = std::make_shared<FuzzyIndex>();
+	pl.attach(index);
+
+	auto matches = index->search("bohemain rapsody", 5, 3);
+	REQUIRE(matches.size() == 1);
+	REQUIRE(matches[0].position == 0);
+	REQUIRE(matches[0].distance == 3);
+
+	// Artist typo matches both songs, closest and earliest first
+	matches = index->search("QEEN", 5, 2);
+	REQUIRE(matches.size() == 2);
+	REQUIRE(matches[0].position == 0);
+	REQUIRE(matches[1].position == 2);
+	REQUIRE(matches[0].distance == 1);
+
+	REQUIRE(index->search("QEEN", 1, 2).size() == 1);
+	REQUIRE(index->search("waterlooo", 5, 0).empty());
+
+	pl.remove(makeSong("/music/1.mp3", "Queen", "Bohemian Rhapsody"));
+	matches = index->search("queen", 5, 0);
+	REQUIRE(matches.size() == 1);
+	REQUIRE(matches[0].position == 1);
+
+	// Moves and inserts in the middle keep matches in step with positions
+	for (int i = 0; i < 3000; i++)
+		pl.add(makeSong("/music/x" + std::to_string(i) + ".mp3", "Band " + std::to_string(i % 30), "Song " + std::to_string(i)));
+	for (int i = 0; i < 1000; i++) {
+		pl.move((i * 7919) % pl.getCount(), (i * 104729) % pl.getCount());
+		if (i % 10 == 0)
+			pl.insertAt((i * 17) % pl.getCount(), makeSong("/music/y" + std::to_string(i) + ".mp3", "Queen", "Extra"));
+	}
+
+	auto fresh = std::make_shared<FuzzyIndex>();
+	pl.attach(fresh);
+	for (const std::string query : { "queen", "band 7", "waterloo" }) {
+		const auto expected = fresh->search(query, 200, 1);
+		matches = index->search(query, 200, 1);
+		REQUIRE(matches.size() == expected.size());
+		for (size_t i = 0; i < matches.size(); i++) {
+			REQUIRE(matches[i].position == expected[i].position);
+			REQUIRE(matches[i].distance == expected[i].distance);
+		}
+	}
+	REQUIRE(index->search("queen", 200, 0).size() == 101);
+}
+
+TEST_CASE("Prefix autocomplete", "[prefix_index]") {
+
+	auto makeSong = [](const std::string& path, const std::string& artist, const std::string& title) {
+		return ConcreteSong(path, std::make_shared<MetaContainer>(MetaContainer{ { "artist", artist }, { "title", title } }));
+	};
+
+	Playlist pl;
+	pl.add(makeSong("/music/1.mp3", "Queen", "Bohemian Rhapsody"));
+	pl.add(makeSong("/music/2.mp3", "Queensryche", "Silent Lucidity"));
+	pl.add(makeSong("/music/3.mp3", "Queen", "Radio Ga Ga"));
+
+	auto index = std::make_shared<PrefixIndex>();
+	pl.attach(index);
+
+	auto completions = index->complete("QUE", 10);
+	REQUIRE(completions.size() == 2);
+	REQUIRE(completions[0].value == "Queen");
+	REQUIRE(completions[0].frequency == 2);
+	REQUIRE(completions[1].value == "Queensryche");
+
+	REQUIRE(index->complete("que", 1).size() == 1);
+	REQUIRE(index->complete("x", 10).empty());
+
+	// Follows additions, evaluations and removals
+	pl.add(makeSong("/music/4.mp3", "Queensryche", "Eyes of a Stranger"));
+	pl.add(makeSong("/music/5.mp3", "Queensryche", "Jet City Woman"));
+	REQUIRE(index->complete("que", 10)[0].value == "Queensryche");
+
+	pl.add(ProxySong("/music/Radiohead.mp3"));
+	REQUIRE(index->complete("radioh", 10).empty());
+	pl.evaluate(ProxySong("/music/Radiohead.mp3"));
+	REQUIRE(index->complete("radioh", 10)[0].value == "Radiohead.mp3");
+
+	pl.remove(makeSong("/music/2.mp3", "Queensryche", "Silent Lucidity"));
+	REQUIRE(index->complete("silent", 10).empty());
+
+	Metadata::clear();
+}
+
+TEST_CASE("Sort playlist by metadata", "[sort_playlist]") {
+
+	auto makeSong = [](const std::string& path, const std::string& artist, const std::string& track) {
+		return ConcreteSong(path, std::make_shared<MetaContainer>(MetaContainer{ { "artist", artist }, { "track", track } }));
+	};
+
+	Playlist pl;
+	pl.add(ProxySong("/music/unevaluated.mp3"));
+	pl.add(makeSong("/music/1.mp3", "The Beatles", "10"));
+	pl.add(makeSong("/music/2.mp3", "abba", "2/12"));
+	pl.add(makeSong("/music/3.mp3", "Beatles", "9"));
+	pl.add(makeSong("/music/4.mp3", "ABBA", "2"));
+	pl.add(makeSong("/music/5.mp3", "Cream", ""));
+
+	pl.sortBy({ "artist", "track" });
+
+	// Articles and case are ignored, numbers compare as numbers,
+	// equal keys keep their order and unevaluated songs go last
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < pl.getCount(); i++)
+		paths.push_back(pl.at(i).getPath());
+
+	REQUIRE(paths == std::vector<std::string>{
+		"/music/2.mp3", "/music/4.mp3", "/music/3.mp3", "/music/1.mp3", "/music/5.mp3", "/music/unevaluated.mp3"
+	});
+}
+
+TEST_CASE("Deduplicate playlist", "[dedupe_playlist]") {
+
+	auto metadata = std::make_shared<MetaContainer>(MetaContainer{ { "artist", "Some One" }, { "title", "Song" } });
+
+	Playlist pl;
+	pl.add(ProxySong("/music/a.mp3"));
+	pl.add(ConcreteSong("/music/b.mp3", metadata));
+	pl.add(ProxySong("/music/a.mp3"));
+	pl.add(ConcreteSong("/copy/of/b.mp3", std::make_shared<MetaContainer>(*metadata)));
+	pl.add(ConcreteSong("/music/a.mp3", metadata));
+	pl.add(ProxySong("/music/c.mp3"));
+
+	auto index = std::make_shared<TrigramIndex>();
+	pl.attach(index);
+
+	auto paths = [&pl]() {
+		std::vector<std::string> result;
+		for (size_t i = 0; i < pl.getCount(); i++)
+			result.push_back(pl.at(i).getPath());
+		return result;
+	};
+
+	SECTION("Path identity keeps first occurrences") {
+		REQUIRE(pl.dedupe() == 2);
+		REQUIRE(paths() == std::vector<std::string>{ "/music/a.mp3", "/music/b.mp3", "/copy/of/b.mp3", "/music/c.mp3" });
+		REQUIRE(index->search("c.mp3") == PostingList{ 3 });
+	}
+
+	SECTION("Metadata identity also drops copies with equal metadata") {
+		REQUIRE(pl.dedupe(SongIdentity::Metadata) == 3);
+		REQUIRE(paths() == std::vector<std::string>{ "/music/a.mp3", "/music/b.mp3", "/music/c.mp3" });
+	}
+
+	SECTION("Keeping last occurrences") {
+		REQUIRE(pl.dedupe(SongIdentity::Path, Occurrence::Last) == 2);
+		REQUIRE(paths() == std::vector<std::string>{ "/music/b.mp3", "/copy/of/b.mp3", "/music/a.mp3", "/music/c.mp3" });
+		REQUIRE(pl.at(2).isEvaluated());
+	}
+
+	// Nothing left to remove after a second pass
+	pl.dedupe(SongIdentity::Metadata);
+	REQUIRE(pl.dedupe(SongIdentity::Metadata) == 0);
+}
+
+TEST_CASE("Playlist set operations", "[set_operations]") {
+
+	auto metadata = std::make_shared<MetaContainer>(MetaContainer{ { "artist", "Some One" }, { "title", "Song" } });
+
+	Playlist a;
+	a.add(ProxySong("/music/1.mp3"));
+	a.add(ProxySong("/music/2.mp3"));
+	a.add(ConcreteSong("/music/3.mp3", metadata));
+	a.add(ProxySong("/music/1.mp3"));
+
+	Playlist b;
+	b.add(ProxySong("/music/2.mp3"));
+	b.add(ConcreteSong("/elsewhere/3.mp3", metadata));
+	b.add(ProxySong("/music/4.mp3"));
+
+	auto paths = [](Playlist& pl) {
+		std::vector<std::string> result;
+		for (size_t i = 0; i < pl.getCount(); i++)
+			result.push_back(pl.at(i).getPath());
+		return result;
+	};
+
+	Playlist result = a.setUnion(b);
+	REQUIRE(paths(result) == std::vector<std::string>{ "/music/1.mp3", "/music/2.mp3", "/music/3.mp3", "/elsewhere/3.mp3", "/music/4.mp3" });
+
+	// Songs are shared, not cloned
+	REQUIRE(&result.at(0) == &a.at(0));
+	REQUIRE(&result.at(4) == &b.at(2));
+
+	result = a.setUnion(b, SongIdentity::Metadata);
+	REQUIRE(paths(result) == std::vector<std::string>{ "/music/1.mp3", "/music/2.mp3", "/music/3.mp3", "/music/4.mp3" });
+
+	result = a.setIntersection(b);
+	REQUIRE(paths(result) == std::vector<std::string>{ "/music/2.mp3" });
+
+	result = a.setIntersection(b, SongIdentity::Metadata);
+	REQUIRE(paths(result) == std::vector<std::string>{ "/music/2.mp3", "/music/3.mp3" });
+
+	result = a.setDifference(b);
+	REQUIRE(paths(result) == std::vector<std::string>{ "/music/1.mp3", "/music/3.mp3" });
+
+	result = a.setDifference(b, SongIdentity::Metadata);
+	REQUIRE(paths(result) == std::vector<std::string>{ "/music/1.mp3" });
+
+	result = a.setSymmetricDifference(b, SongIdentity::Metadata);
+	REQUIRE(paths(result) == std::vector<std::string>{ "/music/1.mp3", "/music/4.mp3" });
+}
+
+TEST_CASE("Playlist diff and patch", "[playlist_patch]") {
+
+	Playlist from;
+	for (int i = 0; i < 1000; i++)
+		from.add(ProxySong("/music/" + std::to_string(i) + ".mp3"));
+
+	Playlist to(from);
+
+	std::stringstream from_print;
+	std::stringstream to_print;
+	std::stringstream patch_text;
+
+	auto check = [&]() {
+		PlaylistPatch patch = PlaylistPatch::diff(from, to);
+
+		// Patch survives a round trip through its text format
+		patch_text.str("");
+		patch_text << patch;
+		PlaylistPatch parsed;
+		patch_text >> parsed;
+
+		Playlist patched(from);
+		parsed.apply(patched);
+
+		from_print.str("");
+		to_print.str("");
+		patched.print(from_print);
+		to.print(to_print);
+		REQUIRE(from_print.str() == to_print.str());
+
+		return patch.getCount();
+	};
+
+	SECTION("Equal playlists") {
+		REQUIRE(check() == 0);
+	}
+
+	SECTION("One song changed") {
+		to.remove(ProxySong("/music/500.mp3"));
+		to.add(ProxySong("/music/new.mp3"));
+		REQUIRE(check() == 2);
+		REQUIRE(patch_text.str() == "-500 1\n+999 ProxySong: /music/new.mp3\n");
+	}
+
+	SECTION("Song moved") {
+		to.remove(ProxySong("/music/10.mp3"));
+		to.add(ProxySong("/music/10.mp3"));
+		REQUIRE(check() == 1);
+		REQUIRE(patch_text.str() == ">10 999\n");
+	}
+
+	SECTION("Many songs moved") {
+		for (int i = 0; i < 1000; i += 4)
+			to.remove(ProxySong("/music/" + std::to_string(i) + ".mp3"));
+		for (int i = 996; i >= 0; i -= 4)
+			to.insertAt((i * 7) % to.getCount(), ProxySong("/music/" + std::to_string(i) + ".mp3"));
+		REQUIRE(check() <= 250);
+		REQUIRE(patch_text.str().find('+') == std::string::npos);
+	}
+
+	SECTION("Mixed edits") {
+		to.remove(ProxySong("/music/0.mp3"));
+		to.remove(ProxySong("/music/1.mp3"));
+		to.remove(ProxySong("/music/999.mp3"));
+		to.add(ProxySong("/music/1.mp3"));
+		to.evaluate(ProxySong("/music/300.mp3"));
+		REQUIRE(check() == 5);
+	}
+
+	SECTION("Completely different playlists") {
+		to.clear();
+		to.add(ProxySong("/other.mp3"));
+		REQUIRE(check() == 2);
+	}
+
+	SECTION("Invalid patches") {
+		patch_text.str("?1 2\n");
+		PlaylistPatch patch;
+		REQUIRE_THROWS_WITH(patch_text >> patch, "Invalid playlist patch");
+
+		patch_text.clear();
+		patch_text.str("-1000 1\n");
+		patch_text >> patch;
+		REQUIRE_THROWS_WITH(patch.apply(from), "Playlist patch doesn't fit the playlist");
+
+		// A bad operation late in the patch leaves the playlist as it was
+		patch_text.clear();
+		patch_text.str("-0 1\n+0 ProxySong: /music/new.mp3\n>999 2000\n");
+		PlaylistPatch partial;
+		patch_text >> partial;
+		from.enableHistory();
+		REQUIRE_THROWS_WITH(partial.apply(from), "Playlist patch doesn't fit the playlist");
+		REQUIRE(from.getCount() == 1000);
+		REQUIRE(from.at(0).getPath() == "/music/0.mp3");
+		REQUIRE_FALSE(from.canUndo());
+	}
+
+	SECTION("Patched songs come from the library") {
+		auto library = std::make_shared<Library>();
+		Playlist other;
+		other.useLibrary(library);
+		other.add(ProxySong("/music/new.mp3"));
+
+		to.add(ProxySong("/music/new.mp3"));
+		Playlist patched(from);
+		patched.useLibrary(library);
+		PlaylistPatch::diff(from, to).apply(patched);
+		REQUIRE(&patched.at(1000) == &other.at(0));
+	}
+
+	Metadata::clear();
+}
+
+TEST_CASE("Positional playlist editing", "[positional_editing]") {
+
+	Playlist pl;
+	std::vector<std::string> expected;
+
+	// Enough songs to span several blocks
+	for (int i = 0; i < 3000; i++) {
+		const std::string path = "/music/" + std::to_string(i) + ".mp3";
+		if (i % 2) {
+			pl.insertAt(0, ProxySong(path));
+			expected.insert(expected.begin(), path);
+		}
+		else {
+			pl.insertAt(pl.getCount() / 2, ProxySong(path));
+			expected.insert(expected.begin() + expected.size() / 2, path);
+		}
+	}
+
+	pl.move(0, 2999);
+	std::rotate(expected.begin(), expected.begin() + 1, expected.end());
+	pl.move(2500, 10);
+	std::rotate(expected.begin() + 10, expected.begin() + 2500, expected.begin() + 2501);
+
+	for (int i = 0; i < 1000; i++) {
+		pl.eraseAt(i);
+		expected.erase(expected.begin() + i);
+	}
+
+	REQUIRE(pl.getCount() == expected.size());
+
+	bool equal = true;
+	for (size_t i = 0; i < expected.size(); i++)
+		equal = equal && pl.at(i).getPath() == expected[i];
+	REQUIRE(equal);
+
+	// Iteration order matches positions
+	std::stringstream printed;
+	std::stringstream expected_print;
+	pl.print(printed);
+	for (const std::string& path : expected)
+		expected_print << "ProxySong: " << path << std::endl;
+	REQUIRE(printed.str() == expected_print.str());
+
+	REQUIRE_THROWS_AS(pl.at(2000), std::out_of_range);
+	REQUIRE_THROWS_AS(pl.insertAt(2001, ProxySong("/x.mp3")), std::out_of_range);
+	REQUIRE_THROWS_AS(pl.eraseAt(2000), std::out_of_range);
+	REQUIRE_THROWS_AS(pl.move(0, 2000), std::out_of_range);
+}
+
+TEST_CASE("Playlist undo and redo", "[playlist_history]") {
+
+	auto song = [](const std::string& path, const std::string& artist) {
+		return ConcreteSong(path, std::make_shared<MetaContainer>(MetaContainer{ { "artist", artist } }));
+	};
+
+	auto printed = [](const Playlist& pl) {
+		std::stringstream ss;
+		pl.print(ss);
+		return ss.str();
+	};
+
+	Playlist pl;
+	pl.add(song("/music/c.mp3", "Gamma"));
+	REQUIRE_FALSE(pl.undo());
+
+	pl.enableHistory();
+	REQUIRE_FALSE(pl.canUndo());
+
+	std::vector<std::string> states = { printed(pl) };
+
+	std::stringstream file;
+	file << "ProxySong: /music/a.mp3" << std::endl << "ProxySong: /music/b.mp3" << std::endl << "ProxySong: /music/a.mp3" << std::endl;
+	pl.load(file);
+	states.push_back(printed(pl));
+
+	pl.insertAt(1, song("/music/d.mp3", "Alpha"));
+	states.push_back(printed(pl));
+	pl.move(0, 4);
+	states.push_back(printed(pl));
+	pl.dedupe();
+	states.push_back(printed(pl));
+	pl.sortBy({ "artist" });
+	states.push_back(printed(pl));
+	pl.eraseAt(2);
+	states.push_back(printed(pl));
+	pl.clear();
+	states.push_back(printed(pl));
+
+	// Index must follow the playlist through undo and redo
+	auto index = std::make_shared<TrigramIndex>();
+	pl.attach(index);
+
+	for (size_t i = states.size() - 1; i-- > 0;) {
+		REQUIRE(pl.undo());
+		REQUIRE(printed(pl) == states[i]);
+	}
+	REQUIRE_FALSE(pl.undo());
+	REQUIRE(index->search("music/d") == PostingList{});
+	REQUIRE(index->search("music/c") == PostingList{ 0 });
+
+	for (size_t i = 1; i < states.size(); i++) {
+		REQUIRE(pl.redo());
+		REQUIRE(printed(pl) == states[i]);
+	}
+	REQUIRE_FALSE(pl.redo());
+
+	// A new edit forgets what could have been redone
+	pl.undo();
+	pl.undo();
+	pl.add(song("/music/e.mp3", "Epsilon"));
+	REQUIRE_FALSE(pl.canRedo());
+	pl.undo();
+	REQUIRE(printed(pl) == states[states.size() - 3]);
+	REQUIRE(index->search("music/a") == PostingList{ 2 });
+
+	// Patches are undone as a whole
+	Playlist target(pl);
+	target.eraseAt(0);
+	target.add(ProxySong("/music/f.mp3"));
+	PlaylistPatch::diff(pl, target).apply(pl);
+	REQUIRE(printed(pl) == printed(target));
+	pl.undo();
+	REQUIRE(printed(pl) == states[states.size() - 3]);
+
+	// History moves with the playlist
+	Playlist moved(std::move(pl));
+	REQUIRE(moved.canUndo());
+	moved.enableHistory(false);
+	REQUIRE_FALSE(moved.canUndo());
+}
+
+TEST_CASE("Playlist snapshots", "[playlist_snapshot]") {
+
+	Playlist pl;
+	REQUIRE(pl.snapshot().getCount() == 0);
+
+	pl.add(ProxySong("/music/0.mp3"));
+	pl.publish();
+	PlaylistSnapshot first = pl.snapshot();
+
+	// Unpublished edits aren't visible, published ones don't change older snapshots
+	pl.add(ProxySong("/music/1.mp3"));
+	REQUIRE(pl.snapshot().getCount() == 1);
+	pl.publish();
+	pl.clear();
+	REQUIRE(first.getCount() == 1);
+	REQUIRE(first.has(ProxySong("/music/0.mp3")));
+	REQUIRE(pl.snapshot().getCount() == 2);
+	REQUIRE(pl.snapshot().at(1).getPath() == "/music/1.mp3");
+	REQUIRE_THROWS_AS(first.at(1), std::out_of_range);
+
+	// Readers always see a complete version while the writer edits and publishes
+	pl.publish();
+	std::atomic<bool> done(false);
+	std::atomic<bool> consistent(true);
+	std::vector<std::thread> readers;
+
+	for (int r = 0; r < 3; r++) {
+		readers.emplace_back([&pl, &done, &consistent]() {
+			while (!done) {
+				PlaylistSnapshot snapshot = pl.snapshot();
+				size_t position = 0;
+				for (auto const& song : snapshot) {
+					if (song->getPath() != "/music/" + std::to_string(position++) + ".mp3")
+						consistent = false;
+				}
+				if (position != snapshot.getCount() || position % 10 != 0)
+					consistent = false;
+			}
+		});
+	}
+
+	for (int i = 0; i < 2000; i++) {
+		pl.add(ProxySong("/music/" + std::to_string(i) + ".mp3"));
+		if (i % 10 == 9)
+			pl.publish();
+	}
+
+	done = true;
+	for (std::thread& reader : readers)
+		reader.join();
+
+	REQUIRE(consistent);
+	REQUIRE(pl.snapshot().getCount() == 2000);
+
+	// A large evaluate() doesn't hold readers up, taking a snapshot only waits for a pointer swap
+	Playlist large;
+	for (int i = 0; i < 50000; i++)
+		large.add(ProxySong("/music/large/" + std::to_string(i) + ".mp3"));
+	large.publish();
+
+	done = false;
+	std::atomic<long long> worst(0);
+	std::atomic<unsigned int> taken(0);
+	readers.clear();
+	for (int r = 0; r < 3; r++) {
+		readers.emplace_back([&large, &done, &worst, &taken]() {
+			while (!done) {
+				const auto start = std::chrono::steady_clock::now();
+				PlaylistSnapshot snapshot = large.snapshot();
+				const long long took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+				if (took > worst)
+					worst = took;
+				taken++;
+			}
+		});
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	large.evaluate();
+	large.publish();
+	const long long evaluating = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	const unsigned int during = taken;
+
+	done = true;
+	for (std::thread& reader : readers)
+		reader.join();
+
+	INFO("evaluate " << evaluating << " us, " << during << " snapshots, worst " << worst << " us");
+	REQUIRE(during > 100);
+	REQUIRE(worst < evaluating / 4);
+	REQUIRE(large.snapshot().at(49999).isEvaluated());
+	Metadata::clear();
+}
+
+TEST_CASE("Gradual playlist evaluation", "[evaluation_session]") {
+
+	Playlist pl;
+	for (int i = 0; i < 1000; i++)
+		pl.add(ProxySong("/music/" + std::to_string(i) + ".mp3"));
+
+	// Evaluated songs become visible batch by batch, the session stops on request
+	std::vector<EvaluationProgress> reports;
+	std::vector<unsigned int> evaluated;
+	EvaluationSession session(pl, 100);
+	EvaluationSession cancelling(pl, 100, [&](const EvaluationProgress& progress) {
+		reports.push_back(progress);
+
+		unsigned int count = 0;
+		for (auto const& song : pl.snapshot())
+			count += song->isEvaluated() ? 1 : 0;
+		evaluated.push_back(count);
+
+		if (progress.done >= 300)
+			cancelling.cancel();
+	});
+
+	cancelling.run();
+	REQUIRE(cancelling.isCancelled());
+	REQUIRE_FALSE(cancelling.isFinished());
+	REQUIRE_FALSE(cancelling.step());
+	REQUIRE(evaluated == std::vector<unsigned int>{ 100, 200, 300 });
+	REQUIRE(reports.back().done == 300);
+	REQUIRE(reports.back().total == 1000);
+	REQUIRE(pl.at(299).isEvaluated());
+	REQUIRE_FALSE(pl.at(300).isEvaluated());
+
+	// Another session skips what is already evaluated
+	REQUIRE(session.step());
+	REQUIRE(session.getProgress().done == 100);
+	session.run();
+	REQUIRE(session.isFinished());
+	REQUIRE(session.getProgress().remaining.count() == 0);
+
+	PlaylistSnapshot snapshot = pl.snapshot();
+	bool all = true;
+	for (auto const& song : snapshot)
+		all = all && song->isEvaluated();
+	REQUIRE(all);
+	REQUIRE(snapshot.at(999).evaluate()->at("title") == "999.mp3");
+
+	REQUIRE_THROWS_AS(EvaluationSession(pl, 0), std::invalid_argument);
+}
+
+TEST_CASE("Viewport priority evaluation", "[evaluation_session]") {
+
+	Playlist pl;
+	for (int i = 0; i < 10000; i++)
+		pl.add(ProxySong("/music/" + std::to_string(i) + ".mp3"));
+
+	auto evaluated = [&pl](size_t first, size_t last) {
+		size_t count = 0;
+		for (size_t i = first; i < last; i++)
+			count += pl.at(i).isEvaluated() ? 1 : 0;
+		return count;
+	};
+
+	EvaluationSession session(pl, 100);
+
+	// Visible songs come first
+	session.setViewport(5000, 50);
+	session.step();
+	REQUIRE(evaluated(0, 10000) == 50);
+	REQUIRE(evaluated(5000, 5050) == 50);
+	REQUIRE(session.getProgress().done == 50);
+
+	// Scrolling moves the priority, a large viewport still goes a batch at a time
+	session.setViewport(9000, 300);
+	session.step();
+	REQUIRE(evaluated(9000, 9100) == 100);
+	REQUIRE(evaluated(0, 10000) == 150);
+
+	// Evaluated viewport isn't evaluated again, background continues in order
+	session.setViewport(5000, 50);
+	session.step();
+	session.step();
+	session.step();
+	REQUIRE(evaluated(0, 300) == 300);
+	REQUIRE(evaluated(0, 10000) == 450);
+	REQUIRE(session.getProgress().done == 450);
+
+	session.setViewport(0, 0);
+	session.run();
+	REQUIRE(evaluated(0, 10000) == 10000);
+	REQUIRE(session.getProgress().done == 10000);
+	REQUIRE(session.isFinished());
+}
+
+TEST_CASE("Editing during gradual evaluation", "[evaluation_session]") {
+
+	Playlist pl;
+	for (int i = 0; i < 100; i++)
+		pl.add(ProxySong("/edited/" + std::to_string(i) + ".mp3"));
+
+	auto unevaluated = [&pl]() {
+		size_t count = 0;
+		for (size_t i = 0; i < pl.getCount(); i++)
+			count += pl.at(i).isEvaluated() ? 0 : 1;
+		return count;
+	};
+
+	EvaluationSession session(pl, 10);
+	session.setViewport(80, 10);
+	session.step();
+	session.setViewport(0, 0);
+	session.step();
+	session.step();
+	REQUIRE(session.getProgress().done == 30);
+
+	// Songs inserted behind the session aren't skipped, erased ones aren't counted
+	pl.insertAt(5, ProxySong("/edited/new.mp3"));
+	pl.eraseAt(0);
+	pl.eraseAt(84);
+	REQUIRE_FALSE(pl.at(4).isEvaluated());
+	REQUIRE(session.getProgress().done == 28);
+
+	session.run();
+	REQUIRE(session.isFinished());
+	REQUIRE(unevaluated() == 0);
+	REQUIRE(session.getProgress().done == pl.getCount());
+
+	// A session started later follows its playlist the same way
+	pl.clear();
+	for (int i = 0; i < 50; i++)
+		pl.add(ProxySong("/edited/" + std::to_string(i) + ".mp3"));
+	EvaluationSession later(pl, 10);
+	later.step();
+	pl.insertAt(0, ProxySong("/edited/first.mp3"));
+	later.run();
+	REQUIRE(unevaluated() == 0);
+}
+
+TEST_CASE("Deadline bounded evaluation", "[deadline_evaluation]") {
+
+	REQUIRE(Metadata::getMount("/mnt/nas/music/a.mp3") == "/mnt/nas");
+	REQUIRE(Metadata::getMount("/music/a.mp3") == "/music");
+	REQUIRE(Metadata::getMount("C:\\Music\\Rock\\a.mp3") == "C:\\Music");
+	REQUIRE(Metadata::getMount("a.mp3") == "");
+
+	Playlist pl;
+	for (int i = 0; i < 1000; i++)
+		pl.add(ProxySong("/mnt/deadline/" + std::to_string(i) + ".mp3"));
+
+	// Without time nothing is tried
+	REQUIRE(pl.evaluate(std::chrono::milliseconds(0)) == 0);
+	REQUIRE_FALSE(pl.at(0).isEvaluated());
+
+	REQUIRE(pl.evaluate(std::chrono::milliseconds(60000)) == 1000);
+	REQUIRE(pl.at(999).isEvaluated());
+	REQUIRE(pl.at(999).evaluate()->at("title") == "999.mp3");
+	REQUIRE(pl.evaluate(std::chrono::milliseconds(60000)) == 0);
+
+	MountLatency latency = Metadata::getMountLatency("/mnt/deadline/x.mp3");
+	REQUIRE(latency.reads == 1000);
+	REQUIRE(latency.pending == 0);
+	REQUIRE(Metadata::getMountLatency("/mnt/unknown/x.mp3").reads == 0);
+
+	// A long batch of background reads doesn't make a mount look stalled
+	std::vector<std::string> batch;
+	for (int i = 0; i < 2000; i++)
+		batch.push_back("/mnt/batch/" + std::to_string(i) + ".mp3");
+	Metadata::queue(batch);
+	REQUIRE(Metadata::canReadWithin("/mnt/batch/other.mp3", std::chrono::milliseconds(1000)));
+	REQUIRE(Metadata::getFileMetadata(batch.back()));
+
+	// Cached songs don't use up the quota of a slow mount
+	std::vector<std::string> cached;
+	for (int i = 0; i < 30; i++)
+		cached.push_back("/mnt/quota/cached" + std::to_string(i) + ".mp3");
+	Metadata::prefetch(cached);
+	for (int i = 0; i < 100; i++)
+		Metadata::reportRead("/mnt/quota/x.mp3", std::chrono::milliseconds(100));
+
+	Playlist slow;
+	for (const std::string& path : cached)
+		slow.add(ProxySong(path));
+	for (int i = 0; i < 20; i++)
+		slow.add(ProxySong("/mnt/quota/" + std::to_string(i) + ".mp3"));
+	REQUIRE(slow.evaluate(std::chrono::milliseconds(1000)) == 40);
+	REQUIRE(slow.at(39).isEvaluated());
+	REQUIRE_FALSE(slow.at(40).isEvaluated());
+
+	// A read missing its deadline still ends up in the cache
+	const std::string path = "/mnt/deadline/late.mp3";
+	auto early = Metadata::getFileMetadata(path, std::chrono::steady_clock::now());
+	auto later = Metadata::getFileMetadata(path);
+	REQUIRE(later);
+	REQUIRE(Metadata::getFileMetadata(path, std::chrono::steady_clock::now()) == later);
+	REQUIRE((!early || early == later));
+}
+
+TEST_CASE("Read planning", "[read_planner]") {
+
+	REQUIRE(ReadPlanner::getDirectory("/music/rock/a.mp3") == "/music/rock");
+	REQUIRE(ReadPlanner::getDirectory("C:\\Music\\a.mp3") == "C:\\Music");
+	REQUIRE(ReadPlanner::getDirectory("a.mp3") == "");
+
+	// Shuffled songs are read directory by directory
+	std::vector<std::string> paths;
+	for (int i = 0; i < 300; i++)
+		paths.push_back("/music/" + std::to_string((i * 7) % 3) + "/" + std::to_string((i * 31) % 100) + ".mp3");
+
+	std::vector<size_t> order = ReadPlanner::plan(paths);
+	REQUIRE(order.size() == paths.size());
+
+	std::vector<size_t> sorted = order;
+	std::sort(sorted.begin(), sorted.end());
+	bool permutation = true;
+	for (size_t i = 0; i < sorted.size(); i++)
+		permutation = permutation && sorted[i] == i;
+	REQUIRE(permutation);
+
+	size_t runs = 1;
+	for (size_t i = 1; i < order.size(); i++) {
+		if (ReadPlanner::getDirectory(paths[order[i]]) != ReadPlanner::getDirectory(paths[order[i - 1]]))
+			runs++;
+	}
+	REQUIRE(runs == 3);
+
+	// Directories located in parallel are planned the same as one by one
+	const std::filesystem::path root = "tmp_plan";
+	std::filesystem::remove_all(root);
+	std::vector<std::string> files;
+	for (int i = 0; i < 60; i++) {
+		const std::filesystem::path file = root / std::to_string(i % 6) / (std::to_string((i * 13) % 60) + ".mp3");
+		std::filesystem::create_directories(file.parent_path());
+		std::ofstream(file.string()) << std::string(100 + i, 'x');
+		files.push_back(file.string());
+	}
+	files.push_back((root / "missing.mp3").string());
+	REQUIRE(ReadPlanner::plan(files, 1) == ReadPlanner::plan(files, 4));
+	REQUIRE(ReadPlanner::plan(files).size() == files.size());
+	std::filesystem::remove_all(root);
+
+	// Evaluation reads in planned order but keeps playlist order
+	Playlist pl;
+	for (const std::string& path : paths)
+		pl.add(ProxySong(path));
+	pl.evaluate();
+	bool ordered = true;
+	for (size_t i = 0; i < paths.size(); i++)
+		ordered = ordered && pl.at(i).getPath() == paths[i] && pl.at(i).isEvaluated();
+	REQUIRE(ordered);
+}
+
+TEST_CASE("Reading ID3v2 tags", "[tag_reader]") {
+
+	auto syncsafe = [](size_t size) {
+		return std::string{ static_cast<char>((size >> 21) & 0x7f), static_cast<char>((size >> 14) & 0x7f), static_cast<char>((size >> 7) & 0x7f), static_cast<char>(size & 0x7f) };
+	};
+
+	auto frame = [&syncsafe](const std::string& id, const std::string& value, bool v4) {
+		const size_t size = value.size();
+		std::string header = id + (v4 ? syncsafe(size) : std::string{ 0, 0, static_cast<char>(size >> 8), static_cast<char>(size & 0xff) }) + std::string(2, '\0');
+		return header + value;
+	};
+
+	auto tag = [&syncsafe](char version, const std::string& frames) {
+		return std::string("ID3") + version + std::string(2, '\0') + syncsafe(frames.size() + 64) + frames + std::string(64, '\0');
+	};
+
+	// ID3v2.3 with ISO-8859-1 text, ID3v2.4 with UTF-8 and UTF-16 text
+	const std::string v3 = tag(3, frame("TIT2", std::string("\0Caf\xe9", 5), false) + frame("TPE1", std::string("\0Band", 5), false));
+	const std::string v4 = tag(4, frame("TALB", std::string("\x03\xc3\x85lbum", 7), true) + frame("TIT2", std::string("\x01\xff\xfeO\0k\0\0\0", 8), true));
+
+	REQUIRE(TagReader::getTagSize(v3) == v3.size());
+	REQUIRE(TagReader::getTagSize("ID3\x02\0\0\0\0\0\x10") == 0);
+	REQUIRE(TagReader::getTagSize("RIFF....WAVE") == 0);
+
+	MetaContainer parsed = TagReader::parse(v3);
+	REQUIRE(parsed["title"] == "Caf\xc3\xa9");
+	REQUIRE(parsed["artist"] == "Band");
+	REQUIRE(TagReader::parse(v4) == MetaContainer{ { "album", "\xc3\x85lbum" }, { "title", "Ok" } });
+
+	// Tags override defaults, files without tags keep them
+	const std::vector<std::string> paths = { "tmp_tag_v3.mp3", "tmp_tag_v4.mp3", "tmp_tag_missing.mp3", "tmp_tag_v3.mp3" };
+	std::ofstream(paths[0], std::ios::binary) << v3 << std::string(1000, 'x');
+	std::ofstream(paths[1], std::ios::binary) << v4;
+
+	std::vector<MetaContainer> metadata = Metadata::readFileMetadata(paths);
+
+	// Calls from several threads share the reader threads and still read every file
+	std::vector<std::vector<MetaContainer>> concurrent(8);
+	std::vector<std::thread> callers;
+	for (auto& result : concurrent)
+		callers.emplace_back([&result, &paths]() { result = Metadata::readFileMetadata(paths); });
+	for (std::thread& caller : callers)
+		caller.join();
+	for (auto const& result : concurrent)
+		REQUIRE(result == metadata);
+
+	remove(paths[0].c_str());
+	remove(paths[1].c_str());
+
+	REQUIRE(metadata.size() == 4);
+	REQUIRE(metadata[0]["title"] == "Caf\xc3\xa9");
+	REQUIRE(metadata[0]["album"] == "The Album");
+	REQUIRE(metadata[1]["artist"] == "Some One");
+	REQUIRE(metadata[1]["album"] == "\xc3\x85lbum");
+	REQUIRE(metadata[2]["title"] == "tmp_tag_missing.mp3");
+	REQUIRE(metadata[3] == metadata[0]);
+}
+
+TEST_CASE("Read ahead of upcoming songs", "[read_ahead]") {
+
+	REQUIRE_THROWS_AS(ReadAhead(*std::make_unique<Playlist>(), 4, 0), std::invalid_argument);
+
+	const std::vector<std::string> paths = { "tmp_ahead_0.mp3", "tmp_ahead_1.mp3", "tmp_ahead_2.mp3" };
+	Playlist pl;
+	for (const std::string& path : paths) {
+		std::ofstream(path, std::ios::binary) << std::string(10000, 'x');
+		pl.add(ProxySong(path));
+	}
+	pl.add(ProxySong("tmp_ahead_missing.mp3"));
+
+	const unsigned long long full = ReadAhead::isSupported() ? 10000 : 0;
+	const unsigned long long partial = ReadAhead::isSupported() ? 5000 : 0;
+
+	// The current song is warmed whole, the next one up to the budget
+	ReadAhead ahead(pl, 1, 15000);
+	REQUIRE(ahead.advance(0) == full + partial);
+	REQUIRE(ahead.getWarmedBytes() == full + partial);
+	REQUIRE(ahead.advance(0) == 0);
+
+	// Played songs are dropped, songs already warmed aren't hinted again
+	REQUIRE(ahead.advance(1) == full);
+	REQUIRE(ahead.getWarmedBytes() == partial + full);
+
+	// Missing files and positions past the end warm nothing
+	REQUIRE(ahead.advance(3) == 0);
+	REQUIRE(ahead.advance(10) == 0);
+	REQUIRE(ahead.getWarmedBytes() == 0);
+
+	ahead.advance(0);
+	ahead.release();
+	REQUIRE(ahead.getWarmedBytes() == 0);
+
+	// A song cut short at the window's edge is topped up once there is room for it
+	std::ofstream(paths[2], std::ios::binary) << std::string(3000, 'x');
+	const unsigned long long small = ReadAhead::isSupported() ? 3000 : 0;
+	ReadAhead edge(pl, 2, 15000);
+	REQUIRE(edge.advance(0) == full + partial);
+	REQUIRE(edge.advance(1) == partial + small);
+	REQUIRE(edge.getWarmedBytes() == full + small);
+	REQUIRE(edge.advance(1) == 0);
+
+	// and cut down when it no longer fits
+	REQUIRE(edge.advance(0) == full);
+	REQUIRE(edge.getWarmedBytes() == full + partial);
+	edge.release();
+
+	for (const std::string& path : paths)
+		remove(path.c_str());
+}
+
+TEST_CASE("Scanning a library", "[library_scanner]") {
+
+	REQUIRE(LibraryScanner::hasExtension("/music/a.MP3", LibraryScanner::default_extensions));
+	REQUIRE(LibraryScanner::hasExtension("b.flac", { "ogg", "flac" }));
+	REQUIRE_FALSE(LibraryScanner::hasExtension("cover.jpg", LibraryScanner::default_extensions));
+	REQUIRE_FALSE(LibraryScanner::hasExtension("mp3", LibraryScanner::default_extensions));
+
+	const std::filesystem::path root = "tmp_library";
+	std::filesystem::remove_all(root);
+	std::vector<std::string> expected;
+	for (const char* file : { "a/1.mp3", "a/2.FLAC", "b/4.mp3", "b/c/d/3.ogg", "b/c/e/5.opus" }) {
+		std::filesystem::create_directories((root / file).parent_path());
+		std::ofstream((root / file).string()) << "x";
+		expected.push_back((root / file).string());
+	}
+	std::ofstream((root / "a/cover.jpg").string()) << "x";
+	std::filesystem::create_directories(root / "empty");
+	std::sort(expected.begin(), expected.end());
+
+	// Every thread count finds the same files
+	for (unsigned int threads : { 1u, 3u, 8u }) {
+		std::vector<std::string> found;
+		LibraryScanner::scan({ root.string() + "/" }, [&found](std::vector<std::string>&& paths) {
+			found.insert(found.end(), paths.begin(), paths.end());
+		}, LibraryScanner::default_extensions, threads);
+
+		std::sort(found.begin(), found.end());
+		REQUIRE(found == expected);
+	}
+
+	// Directories that can't be listed are reported
+	std::vector<std::string> oggs;
+	std::vector<SkippedDirectory> skipped = LibraryScanner::scan({ root.string(), "tmp_library_missing" }, [&oggs](std::vector<std::string>&& paths) {
+		oggs.insert(oggs.end(), paths.begin(), paths.end());
+	}, { "ogg" });
+	REQUIRE(oggs == std::vector<std::string>{ (root / "b/c/d/3.ogg").string() });
+	REQUIRE(skipped.size() == 1);
+	REQUIRE(skipped[0].path == "tmp_library_missing");
+	REQUIRE(skipped[0].error == std::errc::no_such_file_or_directory);
+
+#ifdef __linux__
+	// Running out of descriptors is retried, then reported instead of dropping the subtree silently
+	size_t open_files = 0;
+	for (auto it = std::filesystem::directory_iterator("/proc/self/fd"); it != std::filesystem::directory_iterator(); it++)
+		open_files++;
+
+	struct rlimit limit;
+	REQUIRE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+	struct rlimit lowered = limit;
+	lowered.rlim_cur = open_files + 1;
+	REQUIRE(setrlimit(RLIMIT_NOFILE, &lowered) == 0);
+
+	std::vector<std::string> shallow;
+	skipped = LibraryScanner::scan({ root.string() }, [&shallow](std::vector<std::string>&& paths) {
+		shallow.insert(shallow.end(), paths.begin(), paths.end());
+	}, LibraryScanner::default_extensions, 1);
+	REQUIRE(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+	REQUIRE_FALSE(skipped.empty());
+	for (const SkippedDirectory& directory : skipped)
+		REQUIRE(directory.error == std::errc::too_many_files_open);
+#endif
+
+	// Ingestion is a single undoable edit
+	Playlist pl;
+	pl.add(ProxySong("first.mp3"));
+	pl.enableHistory();
+	REQUIRE(LibraryScanner::ingest(pl, { root.string() }, true) == 5);
+	REQUIRE(pl.getCount() == 6);
+	REQUIRE(pl.at(0).getPath() == "first.mp3");
+	REQUIRE_FALSE(pl.at(1).isEvaluated());
+
+	pl.evaluate();
+	std::vector<std::string> titles;
+	for (size_t i = 1; i < pl.getCount(); i++)
+		titles.push_back(pl.at(i).evaluate()->at("title"));
+	std::sort(titles.begin(), titles.end());
+	REQUIRE(titles == std::vector<std::string>{ "1.mp3", "2.FLAC", "3.ogg", "4.mp3", "5.opus" });
+
+	REQUIRE(pl.undo());
+	REQUIRE(pl.undo());
+	REQUIRE_FALSE(pl.canUndo());
+	REQUIRE(pl.getCount() == 1);
+
+	std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Validating playlist files", "[validate]") {
+
+	const std::vector<std::string> paths = { "tmp_valid_a.mp3", "tmp_valid_b.mp3", "tmp_valid_c.mp3", "tmp_valid_missing.mp3" };
+	for (size_t i = 0; i < 3; i++)
+		std::ofstream(paths[i]) << "song " << i;
+
+	std::vector<FileStamp> stamps = FileStatus::stat(paths);
+	REQUIRE(stamps[0].exists);
+	REQUIRE(stamps[0].size == 6);
+	REQUIRE_FALSE(stamps[3].exists);
+	REQUIRE(FileStatus::stat(paths[0]) == stamps[0]);
+
+	Metadata::invalidate(paths);
+	Playlist pl;
+	for (const std::string& path : paths)
+		pl.add(ProxySong(path));
+	pl.evaluate();
+	REQUIRE(pl.validate().size() == 1);
+
+	// One file changes, another one disappears
+	std::ofstream(paths[1], std::ios::app) << " remastered";
+	remove(paths[2].c_str());
+
+	Playlist copy = pl;
+	std::vector<StaleSong> stale = copy.validate(Repair::Reevaluate);
+	REQUIRE(stale.size() == 3);
+	REQUIRE(stale[0].position == 1);
+	REQUIRE_FALSE(stale[0].missing);
+	REQUIRE(stale[1].path == paths[2]);
+	REQUIRE(stale[1].missing);
+	REQUIRE(stale[2].position == 3);
+	REQUIRE(copy.getCount() == 2);
+	REQUIRE(copy.at(1).getPath() == paths[1]);
+	REQUIRE(copy.at(1).isEvaluated());
+
+	FileStamp read;
+	REQUIRE(Metadata::getFileStamp(paths[1], read));
+	REQUIRE(read == FileStatus::stat(paths[1]));
+
+	// Reporting doesn't touch the playlist, pruning is undoable
+	pl.enableHistory();
+	REQUIRE(pl.validate().size() == 2);
+	REQUIRE(pl.getCount() == 4);
+	REQUIRE(pl.validate(Repair::Prune).size() == 2);
+	REQUIRE(pl.getCount() == 2);
+	REQUIRE(pl.undo());
+	REQUIRE(pl.getCount() == 4);
+
+	remove(paths[0].c_str());
+	remove(paths[1].c_str());
+}
+
+TEST_CASE("Relocating moved libraries", "[relocate]") {
+
+	PathRelocator relocator({ { "/music/", "/mnt/nas/music" }, { "/music/rock", "/fast/rock" }, { "D:\\Music", "E:\\Audio" } });
+	REQUIRE(relocator.size() == 3);
+	REQUIRE_THROWS_AS(relocator.add("", "/x"), std::invalid_argument);
+
+	std::string path;
+	REQUIRE(relocator.relocate("/music/a.mp3", path));
+	REQUIRE(path == "/mnt/nas/music/a.mp3");
+	REQUIRE(relocator.relocate("/music/rock/b.mp3", path));
+	REQUIRE(path == "/fast/rock/b.mp3");
+	REQUIRE(relocator.relocate("/music/rockabilly/c.mp3", path));
+	REQUIRE(path == "/mnt/nas/music/rockabilly/c.mp3");
+	REQUIRE(relocator.relocate("D:\\Music\\d.mp3", path));
+	REQUIRE(path == "E:\\Audio\\d.mp3");
+	REQUIRE_FALSE(relocator.relocate("/musicals/e.mp3", path));
+	REQUIRE_FALSE(relocator.relocate("e.mp3", path));
+
+	PathRelocator root;
+	root.add("/", "/old");
+	REQUIRE(root.relocate("/a.mp3", path));
+	REQUIRE(path == "/old/a.mp3");
+
+	// Songs keep their metadata and the cache follows without reading files
+	Metadata::clear();
+	auto metadata = std::make_shared<MetaContainer>(MetaContainer{ { "artist", "Some One" }, { "title", "Song" } });
+	Playlist pl;
+	pl.add(ConcreteSong("/music/a.mp3", metadata));
+	pl.add(ProxySong("/music/rock/b.mp3"));
+	pl.add(ProxySong("/musicals/e.mp3"));
+	pl.at(1).evaluate();
+
+	FileStamp stamp;
+	REQUIRE(Metadata::getFileStamp("/music/rock/b.mp3", stamp));
+	REQUIRE(Metadata::relocate(relocator) == 1);
+	REQUIRE(Metadata::getCount() == 1);
+	REQUIRE_FALSE(Metadata::getFileStamp("/music/rock/b.mp3", stamp));
+	REQUIRE(Metadata::getFileStamp("/fast/rock/b.mp3", stamp));
+
+	pl.enableHistory();
+	REQUIRE(pl.relocate(relocator) == 2);
+	REQUIRE(pl.at(0).getPath() == "/mnt/nas/music/a.mp3");
+	REQUIRE(pl.at(0).evaluate() == metadata);
+	REQUIRE(pl.at(1).getPath() == "/fast/rock/b.mp3");
+	REQUIRE_FALSE(pl.at(1).isEvaluated());
+	REQUIRE(pl.at(2).getPath() == "/musicals/e.mp3");
+	REQUIRE(pl.relocate(relocator) == 0);
+
+	REQUIRE(pl.undo());
+	REQUIRE(pl.at(0).getPath() == "/music/a.mp3");
+	Metadata::clear();
+}
+
+TEST_CASE("Compact path storage", "[path_store]") {
+
+	// Paths are rebuilt exactly, whatever their delimeters
+	const std::vector<std::string> paths = {
+		"/music/Artist/Album/01 - Title.mp3", "/music/Artist/Album/02 - Title.mp3", "/music/Artist/Other/01 - Title.mp3",
+		"C:\\Music\\a.mp3", "relative.mp3", "//server/share/b.mp3", "/music/Artist/", "/"
+	};
+
+	std::vector<PathStore::Id> ids;
+	for (const std::string& path : paths)
+		ids.push_back(PathStore::intern(path));
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		REQUIRE(PathStore::get(ids[i]) == paths[i]);
+		REQUIRE(PathStore::intern(paths[i]) == ids[i]);
+	}
+	REQUIRE(PathStore::intern("") == 0);
+	REQUIRE(PathStore::get(0) == "");
+	REQUIRE(ids[0] != ids[2]);
+
+	// Shared directories are stored once
+	const size_t count = PathStore::getCount();
+	PathStore::intern("/music/Artist/Album/03 - Title.mp3");
+	REQUIRE(PathStore::getCount() == count + 1);
+
+	std::string buffer = "left over";
+	PathStore::get(ids[3], buffer);
+	REQUIRE(buffer == paths[3]);
+
+	std::vector<PathStore::Id> many;
+	for (int i = 0; i < 600; i++)
+		many.push_back(ids[i % ids.size()]);
+	size_t decoded = 0;
+	PathStore::decode(many, [&](const std::string& path) {
+		REQUIRE(path == paths[decoded % paths.size()]);
+		decoded++;
+	});
+	REQUIRE(decoded == many.size());
+
+	// Songs hold ids, so equal paths compare equal across song types
+	ProxySong proxy(paths[0]);
+	ConcreteSong concrete(paths[0], std::make_shared<MetaContainer>());
+	REQUIRE(proxy.getPathId() == ids[0]);
+	REQUIRE(concrete.getPathId() == ids[0]);
+	REQUIRE(proxy.getPath() == paths[0]);
+	REQUIRE(static_cast<const Song&>(proxy) == static_cast<const Song&>(concrete));
+	REQUIRE(ProxySong(ids[1]).getPath() == paths[1]);
+
+	concrete.writePath(buffer);
+	REQUIRE(buffer == paths[0]);
+}
+
+TEST_CASE("Library catalog", "[library]") {
+
+	auto library = std::make_shared<Library>();
+	Playlist first, second;
+	first.useLibrary(library);
+	second.useLibrary(library);
+
+	// Playlists hold the same song for a path instead of copies of their own
+	for (int i = 0; i < 10; i++) {
+		first.add(ProxySong("/catalog/" + std::to_string(i) + ".mp3"));
+		second.add(ProxySong("/catalog/" + std::to_string(9 - i) + ".mp3"));
+	}
+	REQUIRE(library->getCount() == 10);
+	REQUIRE(&first.at(0) == &second.at(9));
+	REQUIRE(first.getLibrary() == library);
+
+	Playlist copy(first);
+	REQUIRE(copy.getLibrary() == library);
+	REQUIRE(&copy.at(3) == &first.at(3));
+
+	// Evaluating in one playlist makes the evaluated song canonical for all of them
+	first.evaluate();
+	REQUIRE(first.at(0).isEvaluated());
+	REQUIRE(library->find(first.at(0).getPathId()).get() == &first.at(0));
+	REQUIRE_FALSE(second.at(9).isEvaluated());
+
+	second.add(ProxySong("/catalog/0.mp3"));
+	REQUIRE(&second.at(10) == &first.at(0));
+	second.evaluate();
+	REQUIRE(&second.at(9) == &first.at(0));
+	REQUIRE(second.at(9).evaluate()->at("title") == "0.mp3");
+
+	// Private songs of a playlist are switched to the catalog's songs when it starts using one
+	Playlist third;
+	third.add(ProxySong("/catalog/5.mp3"));
+	third.add(ProxySong("/catalog/extra.mp3"));
+	third.useLibrary(library);
+	REQUIRE(&third.at(0) == &first.at(5));
+	REQUIRE(library->getCount() == 11);
+
+	// Songs no playlist holds are forgotten on purge
+	third.clear();
+	REQUIRE(library->purge() == 1);
+	REQUIRE(library->getCount() == 10);
+	REQUIRE(library->find(PathStore::intern("/catalog/extra.mp3")) == nullptr);
+
+	// Without a catalog songs stay private copies
+	Playlist single;
+	single.add(first.at(0));
+	REQUIRE(&single.at(0) != &first.at(0));
+	REQUIRE(single.getLibrary() == nullptr);
+}
+
+TEST_CASE("Playlists containing a song", "[playlist_registry]") {
+
+	PlaylistRegistry registry;
+	std::vector<PlaylistRegistry::Id> ids;
+
+	// Every third playlist has the track, one of them twice
+	for (int i = 0; i < 30; i++) {
+		Playlist pl;
+		pl.add(ProxySong("/registry/common.mp3"));
+		pl.add(ProxySong("/registry/" + std::to_string(i) + ".mp3"));
+		if (i % 3 == 0)
+			pl.add(ProxySong("/registry/track.mp3"));
+		if (i == 9)
+			pl.add(ProxySong("/registry/track.mp3"));
+		ids.push_back(registry.add(std::move(pl)));
+	}
+	REQUIRE(registry.getCount() == 30);
+
+	const ProxySong track("/registry/track.mp3");
+	REQUIRE(registry.find(track) == PostingList{ 0, 3, 6, 9, 12, 15, 18, 21, 24, 27 });
+	REQUIRE(registry.find(ProxySong("/registry/7.mp3")) == PostingList{ 7 });
+	REQUIRE(registry.find(ProxySong("/registry/none.mp3")).empty());
+	REQUIRE(registry.find(ProxySong("/registry/common.mp3")).size() == 30);
+
+	// Edits made through the registry keep the index up to date
+	registry.get(ids[4]).add(track);
+	registry.get(ids[3]).remove(track);
+	registry.get(ids[9]).eraseAt(2);
+	REQUIRE(registry.find(track) == PostingList{ 0, 4, 6, 9, 12, 15, 18, 21, 24, 27 });
+
+	registry.get(ids[5]).enableHistory();
+	registry.get(ids[5]).insertAt(0, track);
+	registry.get(ids[5]).undo();
+	REQUIRE(registry.find(track).size() == 10);
+
+	// Evaluating keeps paths, relocating moves songs to other paths
+	registry.get(ids[6]).evaluate();
+	REQUIRE(registry.find(track) == PostingList{ 0, 4, 6, 9, 12, 15, 18, 21, 24, 27 });
+	PathRelocator relocator;
+	relocator.add("/registry", "/moved");
+	registry.get(ids[6]).relocate(relocator);
+	REQUIRE(registry.find(ProxySong("/moved/track.mp3")) == PostingList{ 6 });
+	REQUIRE(registry.find(ProxySong("/registry/6.mp3")).empty());
+
+	// Takedowns touch only the playlists listed for the song
+	REQUIRE(registry.removeEverywhere(track) == 9);
+	REQUIRE(registry.find(track).empty());
+	REQUIRE_FALSE(registry.get(ids[9]).has(track));
+	REQUIRE(registry.get(ids[0]).getCount() == 2);
+
+	// Songs are removed by path, concrete songs with equal metadata elsewhere stay
+	auto metadata = std::make_shared<MetaContainer>(MetaContainer{ { "artist", "Someone" }, { "title", "Taken down" } });
+	const ConcreteSong tagged("/registry/tagged.mp3", metadata);
+	registry.get(ids[1]).add(tagged);
+	registry.get(ids[1]).add(ConcreteSong("/registry/copy.mp3", std::make_shared<MetaContainer>(*metadata)));
+	REQUIRE(registry.removeEverywhere(tagged) == 1);
+	REQUIRE(registry.find(tagged).empty());
+	REQUIRE(registry.find(ProxySong("/registry/copy.mp3")) == PostingList{ 1 });
+	REQUIRE(registry.get(ids[1]).getCount() == 3);
+
+	// Released playlists leave the index, their ids aren't reused
+	Playlist released = registry.release(ids[7]);
+	REQUIRE(released.getCount() == 2);
+	REQUIRE(registry.find(ProxySong("/registry/7.mp3")).empty());
+	REQUIRE(registry.find(ProxySong("/registry/common.mp3")).size() == 28);
+	REQUIRE(registry.getCount() == 29);
+	REQUIRE_THROWS_AS(registry.get(ids[7]), std::out_of_range);
+	REQUIRE(registry.add(std::move(released)) == 30);
+	REQUIRE(registry.find(ProxySong("/registry/7.mp3")) == PostingList{ 30 });
+}
+
+TEST_CASE("Bloom filter of song paths", "[bloom_filter]") {
+
+	Playlist pl;
+	for (int i = 0; i < 5000; i++)
+		pl.add(ProxySong("/bloom/" + std::to_string(i) + ".mp3"));
+	REQUIRE(pl.getFilter() == nullptr);
+
+	// Songs added before and after enabling are never ruled out
+	pl.enableFilter();
+	for (int i = 5000; i < 10000; i++)
+		pl.add(ProxySong("/bloom/" + std::to_string(i) + ".mp3"));
+
+	std::shared_ptr<const BloomFilter> filter = pl.getFilter();
+	REQUIRE(filter != nullptr);
+	bool all = true;
+	for (int i = 0; i < 10000; i++)
+		all = all && filter->mayContain(PathStore::intern("/bloom/" + std::to_string(i) + ".mp3"));
+	REQUIRE(all);
+	REQUIRE(pl.has(ProxySong("/bloom/1234.mp3")));
+
+	// Most songs not in the playlist are ruled out by the filter alone
+	unsigned int positives = 0;
+	for (int i = 0; i < 10000; i++)
+		positives += filter->mayContain(PathStore::intern("/elsewhere/" + std::to_string(i) + ".mp3")) ? 1 : 0;
+	REQUIRE(positives < 300);
+	REQUIRE_FALSE(pl.has(ProxySong("/elsewhere/1.mp3")));
+
+	// Concrete songs match by metadata too, which the filter of paths can't rule out
+	auto metadata = std::make_shared<MetaContainer>(MetaContainer{ { "artist", "Someone" }, { "title", "Filtered" } });
+	pl.add(ConcreteSong("/bloom/concrete.mp3", metadata));
+	REQUIRE(pl.has(ConcreteSong("/elsewhere/concrete.mp3", std::make_shared<MetaContainer>(*metadata))));
+	const Song& any = ConcreteSong("/elsewhere/concrete.mp3", metadata);
+	REQUIRE(pl.has(any));
+	pl.eraseAt(pl.getCount() - 1);
+
+	// Removed songs make the filter stale, it's rebuilt on the next lookup
+	for (int i = 0; i < 4000; i++)
+		pl.eraseAt(0);
+	REQUIRE(filter->isStale());
+	REQUIRE(pl.getFilter() == filter);
+	REQUIRE_FALSE(filter->isStale());
+	REQUIRE_FALSE(pl.has(ProxySong("/bloom/0.mp3")));
+	REQUIRE(pl.has(ProxySong("/bloom/4000.mp3")));
+
+	// The filter moves with the songs and can be dropped
+	Playlist moved(std::move(pl));
+	REQUIRE(moved.getFilter() == filter);
+	moved.add(ProxySong("/bloom/new.mp3"));
+	REQUIRE(filter->mayContain(PathStore::intern("/bloom/new.mp3")));
+	moved.enableFilter(false);
+	REQUIRE(moved.getFilter() == nullptr);
+	REQUIRE(moved.has(ProxySong("/bloom/new.mp3")));
+}
+
+TEST_CASE("Playlist fingerprints", "[playlist_fingerprint]") {
+
+	// Returns the fingerprint of a playlist's current songs computed from scratch
+	auto fresh = [](Playlist& pl) {
+		auto fingerprint = std::make_shared<PlaylistFingerprint>();
+		pl.attach(fingerprint);
+		pl.detach(fingerprint);
+		return fingerprint->getHash();
+	};
+
+	auto freshChunks = [](Playlist& pl) {
+		auto fingerprint = std::make_shared<PlaylistFingerprint>();
+		pl.attach(fingerprint);
+		pl.detach(fingerprint);
+		return fingerprint->getChunks();
+	};
+
+	Playlist pl;
+	auto fingerprint = std::make_shared<PlaylistFingerprint>();
+	pl.attach(fingerprint);
+	REQUIRE(fingerprint->getHash() == 0);
+
+	for (int i = 0; i < 3000; i++)
+		pl.add(ProxySong("/fingerprint/" + std::to_string(i) + ".mp3"));
+	REQUIRE(fingerprint->getCount() == 3000);
+	REQUIRE(fingerprint->getHash() == fresh(pl));
+	const uint64_t original = fingerprint->getHash();
+	const std::vector<uint64_t> chunks = fingerprint->getChunks();
+	REQUIRE(chunks.size() > 10);
+
+	// Every kind of edit keeps the hash equal to hashing the songs again
+	std::mt19937 random(7);
+	for (int i = 0; i < 500; i++) {
+		const size_t position = random() % pl.getCount();
+		switch (random() % 4) {
+		case 0: pl.insertAt(position, ProxySong("/fingerprint/new" + std::to_string(i) + ".mp3")); break;
+		case 1: pl.eraseAt(position); break;
+		case 2: pl.move(position, random() % pl.getCount()); break;
+		default: pl.add(ProxySong("/fingerprint/" + std::to_string(i) + ".mp3")); break;
+		}
+	}
+	REQUIRE(fingerprint->getCount() == pl.getCount());
+	REQUIRE(fingerprint->getHash() == fresh(pl));
+	REQUIRE(fingerprint->getChunks() == freshChunks(pl));
+	REQUIRE(fingerprint->getHash() != original);
+
+	pl.remove(ProxySong("/fingerprint/1.mp3"));
+	pl.dedupe();
+	REQUIRE(fingerprint->getHash() == fresh(pl));
+
+	// Equal songs give equal hashes whatever the edit history, also when evaluated
+	Playlist rebuilt;
+	for (int i = 0; i < 3000; i++)
+		rebuilt.add(ProxySong("/fingerprint/" + std::to_string(i) + ".mp3"));
+	auto other = std::make_shared<PlaylistFingerprint>();
+	rebuilt.attach(other);
+	rebuilt.evaluate();
+	REQUIRE(other->getHash() == original);
+	REQUIRE(other->getChunks() == chunks);
+
+	// A changed song changes only the chunks around it
+	rebuilt.eraseAt(1500);
+	rebuilt.insertAt(1500, ProxySong("/fingerprint/changed.mp3"));
+	REQUIRE(other->getHash() != original);
+	const std::vector<size_t> changed = PlaylistFingerprint::diff(other->getChunks(), chunks);
+	REQUIRE(!changed.empty());
+	REQUIRE(changed.size() <= 2);
+	REQUIRE(PlaylistFingerprint::diff(chunks, chunks).empty());
+
+	// Relocated paths are rehashed, a move back restores the hash
+	PathRelocator relocator;
+	relocator.add("/fingerprint", "/moved");
+	rebuilt.eraseAt(1500);
+	rebuilt.insertAt(1500, ProxySong("/fingerprint/1500.mp3"));
+	REQUIRE(other->getHash() == original);
+	rebuilt.relocate(relocator);
+	REQUIRE(other->getHash() == fresh(rebuilt));
+	REQUIRE(other->getHash() != original);
+
+	// A long run without boundaries is one chunk kept in bounded pieces, edits in it keep the hashes right
+	Playlist run;
+	std::string same;
+	for (int i = 0; same.empty(); i++) {
+		run.clear();
+		run.add(ProxySong("/fingerprint/run" + std::to_string(i) + ".mp3"));
+		run.add(ProxySong("/fingerprint/run" + std::to_string(i) + ".mp3"));
+		if (freshChunks(run).size() == 1)
+			same = "/fingerprint/run" + std::to_string(i) + ".mp3";
+	}
+	auto long_run = std::make_shared<PlaylistFingerprint>();
+	run.attach(long_run);
+	for (int i = 0; i < 5000; i++)
+		run.insertAt(random() % (run.getCount() + 1), ProxySong(same));
+	REQUIRE(long_run->getChunks().size() == 1);
+	REQUIRE(long_run->getHash() == fresh(run));
+
+	for (int i = 0; i < 2000; i++) {
+		const size_t position = random() % run.getCount();
+		switch (random() % 3) {
+		case 0: run.insertAt(position, ProxySong("/fingerprint/run_new" + std::to_string(i) + ".mp3")); break;
+		case 1: run.eraseAt(position); break;
+		default: run.insertAt(position, ProxySong(same)); break;
+		}
+	}
+	REQUIRE(long_run->getCount() == run.getCount());
+	REQUIRE(long_run->getHash() == fresh(run));
+	REQUIRE(long_run->getChunks() == freshChunks(run));
+}
+
 /**
  @fn	int main(int argc, char* argv[])
 
@@ -0,0 +1,175 @@
+/**
+ @file	PathRelocator.cpp.
+
+ @brief	Implements the path relocator class
+ */
+
+#include "PathRelocator.h"
+#include <stdexcept>
+
+/**
+ @fn	PathRelocator::PathRelocator()
+
+ @brief	Constructor. Paths aren't relocated until prefixes are added.
+ */
+
+PathRelocator::PathRelocator() :
+	nodes(1, Node{ {}, std::string::npos })
+{
+}
+
+/**
+ @fn	PathRelocator::PathRelocator(const std::vector<std::pair<std::string, std::string>>& moves)
+
+ @brief	Construction using pairs of old and new prefixes
+
+ @param	moves	Old prefixes and the prefixes they moved to
+
+ @throws std::invalid_argument if an old prefix is empty
+ */
+
+PathRelocator::PathRelocator(const std::vector<std::pair<std::string, std::string>>& moves) :
+	PathRelocator()
+{
+	for (const auto& move : moves)
+		add(move.first, move.second);
+}
+
+/**
+ @fn	void PathRelocator::add(const std::string& from, const std::string& to)
+
+ @brief	Relocates paths under a prefix to another. Trailing delimeters of both are ignored,
+		so "/music/" and "/music" are the same prefix. Adding a prefix again replaces its target.
+
+ @param	from	Old prefix, a directory or a whole path
+		to		New prefix
+
+ @throws std::invalid_argument if from is empty
+ */
+
+void PathRelocator::add(const std::string& from, const std::string& to) {
+
+	// A lone delimeter is the root, which keeps its delimeter
+	size_t length = from.size();
+	while (length > 1 && isDelimeter(from[length - 1]))
+		length--;
+
+	std::string target = to;
+	while (target.size() > 1 && isDelimeter(target.back()))
+		target.pop_back();
+
+	if (length == 0)
+		throw std::invalid_argument("Relocated prefix must not be empty");
+
+	size_t node = 0;
+	for (size_t i = 0; i < length; i++) {
+
+		size_t next = std::string::npos;
+		for (const auto& child : nodes[node].children) {
+			if (child.first == from[i]) {
+				next = child.second;
+				break;
+			}
+		}
+
+		if (next == std::string::npos) {
+			next = nodes.size();
+			nodes[node].children.emplace_back(from[i], next);
+			nodes.push_back(Node{ {}, std::string::npos });
+		}
+		node = next;
+	}
+
+	if (nodes[node].target == std::string::npos) {
+		nodes[node].target = targets.size();
+		targets.push_back(std::move(target));
+	}
+	else {
+		targets[nodes[node].target] = std::move(target);
+	}
+}
+
+/**
+ @fn	bool PathRelocator::relocate(const std::string& path, std::string& result) const
+
+ @brief	Rewrites a path if it's under an old prefix, replacing the longest matching prefix.
+		A prefix matches only if the path ends or continues with a delimeter after it,
+		so "/music" doesn't match "/musicals/a.mp3". Takes time in the length of the matched prefix.
+
+ @param	path			Path to rewrite
+ @param [out]	result	Set to the rewritten path if the path is relocated
+
+ @return	TRUE if the path is under an old prefix
+ */
+
+bool PathRelocator::relocate(const std::string& path, std::string& result) const {
+
+	size_t node = 0;
+	size_t matched = 0;
+	size_t target = std::string::npos;
+
+	for (size_t i = 0; ; i++) {
+
+		// Only the root prefix ends with a delimeter, which is then left to the rest of the path
+		if (nodes[node].target != std::string::npos) {
+			if (i == path.size() || isDelimeter(path[i])) {
+				matched = i;
+				target = nodes[node].target;
+			}
+			else if (i > 0 && isDelimeter(path[i - 1])) {
+				matched = i - 1;
+				target = nodes[node].target;
+			}
+		}
+
+		if (i == path.size())
+			break;
+
+		size_t next = std::string::npos;
+		for (const auto& child : nodes[node].children) {
+			if (child.first == path[i]) {
+				next = child.second;
+				break;
+			}
+		}
+
+		if (next == std::string::npos)
+			break;
+		node = next;
+	}
+
+	if (target == std::string::npos)
+		return false;
+
+	// A root target already ends with the delimeter the rest starts with
+	const std::string& prefix = targets[target];
+	const bool doubled = !prefix.empty() && isDelimeter(prefix.back()) && matched < path.size() && isDelimeter(path[matched]);
+	result = prefix + path.substr(doubled ? matched + 1 : matched);
+	return true;
+}
+
+/**
+ @fn	size_t PathRelocator::size() const noexcept
+
+ @brief	Returns number of prefixes
+
+ @return	Number of distinct old prefixes
+ */
+
+size_t PathRelocator::size() const noexcept {
+	return targets.size();
+}
+
+/**
+ @fn	bool PathRelocator::isDelimeter(char c) noexcept
+
+ @brief	Tells if a character separates directories
+
+ @param	c	The character
+
+ @return	TRUE for slashes and backslashes
+ */
+
+bool PathRelocator::isDelimeter(char c) noexcept {
+	return c == '/' || c == '\\';
+}
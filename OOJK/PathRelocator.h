@@ -0,0 +1,37 @@
+/**
+ @file	PathRelocator.h.
+
+ @brief	Declares the path relocator class.
+		Rewrites the leading directories of paths after a library has moved, e.g. to another mount.
+		Old prefixes are kept in a character trie, so a path is matched against all of them
+		in one walk over its leading characters, however many prefixes there are.
+		The longest matching prefix wins, and prefixes only match whole directories.
+ */
+
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+class PathRelocator {
+
+private:
+	/** A character of an old prefix */
+	struct Node {
+		std::vector<std::pair<char, size_t>> children;	/** Next characters and their nodes */
+		size_t target;									/** Index of the new prefix if an old prefix ends here, npos if none */
+	};
+
+	std::vector<Node> nodes;							/** Nodes of the trie, the root first */
+	std::vector<std::string> targets;					/** New prefixes */
+
+	static bool isDelimeter(char c) noexcept;			/** Tells if a character separates directories */
+
+public:
+	PathRelocator();									/** Constructor, nothing is relocated */
+	explicit PathRelocator(const std::vector<std::pair<std::string, std::string>>& moves);	/** Construction using pairs of old and new prefixes */
+
+	void add(const std::string& from, const std::string& to);	/** Relocates paths under a prefix to another */
+	bool relocate(const std::string& path, std::string& result) const;	/** Rewrites a path if it's under an old prefix */
+	size_t size() const noexcept;						/** Returns number of prefixes */
+};
@@ -0,0 +1,309 @@
+/**
+ @file	PathStore.cpp.
+
+ @brief	Implements the path store class
+ */
+
+#include "PathStore.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+// Initialize static members
+std::vector<PathStore::Node> PathStore::nodes = { PathStore::Node{ 0, 0, 0 } };
+std::string PathStore::names;
+std::vector<PathStore::Id> PathStore::slots(1024, 0);
+std::shared_mutex PathStore::mutex;
+const size_t PathStore::decode_batch = 256;
+
+/**
+ @fn	PathStore::Id PathStore::intern(const std::string& path)
+
+ @brief	Returns the id of a path, adding its missing components to the store.
+		Components end with a delimeter, e.g. "/music/a.mp3" is "/", "music/" and "a.mp3".
+		Paths already stored are only looked up, which other threads can do at the same time.
+		Added components stay until the program ends, see PathStore.h for the bound this gives.
+
+ @param	path	The path
+
+ @return	Id of the path, 0 for an empty path
+
+ @throws std::length_error if the store is full
+ */
+
+PathStore::Id PathStore::intern(const std::string& path) {
+
+	// Paths mostly come directory by directory, so the directory of the previous path
+	// on this thread is remembered and only the file name needs to be looked up
+	thread_local std::string last_directory;
+	thread_local Id last_parent = 0;
+
+	const size_t delimeter = path.find_last_of("/\\");
+	const size_t directory_length = (delimeter == std::string::npos) ? 0 : delimeter + 1;
+	const bool known = directory_length > 0 && last_parent != 0 && last_directory.size() == directory_length && path.compare(0, directory_length, last_directory) == 0;
+
+	const Id first = known ? last_parent : 0;
+	const size_t first_start = known ? directory_length : 0;
+
+	// Returns id of the path, or 0 if step gives 0 for a component
+	auto walk = [&](auto&& step) {
+		Id id = first;
+		Id parent = first;
+		for (size_t start = first_start; start < path.size(); ) {
+			size_t end = path.find_first_of("/\\", start);
+			end = (end == std::string::npos) ? path.size() : end + 1;
+			id = step(id, path.data() + start, end - start);
+			if (id == 0)
+				return id;
+			if (end == directory_length)
+				parent = id;
+			start = end;
+		}
+
+		if (!known && directory_length > 0) {
+			last_directory.assign(path, 0, directory_length);
+			last_parent = parent;
+		}
+		return id;
+	};
+
+	if (path.size() == first_start)
+		return first;
+
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		const Id id = walk([](Id parent, const char* name, size_t length) { return find(parent, name, length); });
+		if (id != 0)
+			return id;
+	}
+
+	std::unique_lock<std::shared_mutex> lock(mutex);
+	return walk([](Id parent, const char* name, size_t length) {
+		const Id id = find(parent, name, length);
+		return (id != 0) ? id : add(parent, name, length);
+	});
+}
+
+/**
+ @fn	std::string PathStore::get(Id id)
+
+ @brief	Returns the path of an id
+
+ @param	id	Id returned by intern()
+
+ @return	The path as it was interned
+ */
+
+std::string PathStore::get(Id id) {
+
+	std::string path;
+	get(id, path);
+	return path;
+}
+
+/**
+ @fn	void PathStore::get(Id id, std::string& buffer)
+
+ @brief	Writes the path of an id into a buffer. Reusing the buffer for many paths
+		saves allocating memory for each of them.
+
+ @param	id				Id returned by intern()
+ @param [out]	buffer	Replaced with the path
+ */
+
+void PathStore::get(Id id, std::string& buffer) {
+
+	buffer.clear();
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	append(id, buffer);
+}
+
+/**
+ @fn	void PathStore::decode(const std::vector<Id>& ids, const std::function<void(const std::string&)>& callback)
+
+ @brief	Streams the paths of many ids to a callback, in the order of ids. Paths are decoded
+		a batch at a time into reused buffers, so the lock is taken once per batch and
+		the callback is free to intern paths itself.
+
+ @param	ids			Ids returned by intern()
+		callback	Called with each path, the reference is valid during the call only
+ */
+
+void PathStore::decode(const std::vector<Id>& ids, const std::function<void(const std::string&)>& callback) {
+
+	std::vector<std::string> batch(std::min(decode_batch, ids.size()));
+
+	for (size_t first = 0; first < ids.size(); first += decode_batch) {
+
+		const size_t count = std::min(decode_batch, ids.size() - first);
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			for (size_t i = 0; i < count; i++) {
+				batch[i].clear();
+				append(ids[first + i], batch[i]);
+			}
+		}
+
+		for (size_t i = 0; i < count; i++)
+			callback(batch[i]);
+	}
+}
+
+/**
+ @fn	size_t PathStore::getCount()
+
+ @brief	Returns number of components stored
+
+ @return	Number of distinct directories and file names, by their parents
+ */
+
+size_t PathStore::getCount() {
+
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	return nodes.size() - 1;
+}
+
+/**
+ @fn	size_t PathStore::getMemoryUsage()
+
+ @brief	Returns number of bytes used by the store
+
+ @return	Bytes allocated for components, names and the hash table
+ */
+
+size_t PathStore::getMemoryUsage() {
+
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	return nodes.capacity() * sizeof(Node) + names.capacity() + slots.capacity() * sizeof(Id);
+}
+
+/**
+ @fn	size_t PathStore::hash(Id parent, const char* name, size_t length) noexcept
+
+ @brief	Hashes a component with FNV-1a, seeded by its parent
+
+ @param	parent	Id of the parent path
+		name	Name of the component
+		length	Length of the name
+
+ @return	The hash
+ */
+
+size_t PathStore::hash(Id parent, const char* name, size_t length) noexcept {
+
+	uint64_t value = 14695981039346656037ull ^ (static_cast<uint64_t>(parent) * 0x9e3779b97f4a7c15ull);
+	for (size_t i = 0; i < length; i++) {
+		value ^= static_cast<unsigned char>(name[i]);
+		value *= 1099511628211ull;
+	}
+	return static_cast<size_t>(value ^ (value >> 32));
+}
+
+/**
+ @fn	PathStore::Id PathStore::find(Id parent, const char* name, size_t length) noexcept
+
+ @brief	Finds a component by its parent and name. mutex must be held.
+
+ @param	parent	Id of the parent path
+		name	Name of the component
+		length	Length of the name
+
+ @return	Id of the component, 0 if it isn't stored
+ */
+
+PathStore::Id PathStore::find(Id parent, const char* name, size_t length) noexcept {
+
+	const size_t mask = slots.size() - 1;
+	for (size_t slot = hash(parent, name, length) & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+		const Node& node = nodes[slots[slot]];
+		if (node.parent == parent && node.length == length && std::memcmp(names.data() + node.offset, name, length) == 0)
+			return slots[slot];
+	}
+	return 0;
+}
+
+/**
+ @fn	PathStore::Id PathStore::add(Id parent, const char* name, size_t length)
+
+ @brief	Adds a component. mutex must be held exclusively.
+
+ @param	parent	Id of the parent path
+		name	Name of the component
+		length	Length of the name
+
+ @return	Id of the new component
+
+ @throws std::length_error if ids or name offsets would overflow
+ */
+
+PathStore::Id PathStore::add(Id parent, const char* name, size_t length) {
+
+	if (nodes.size() >= std::numeric_limits<Id>::max() || names.size() + length > std::numeric_limits<uint32_t>::max())
+		throw std::length_error("Path store is full");
+
+	// Kept at most half full, so probe sequences stay short
+	if ((nodes.size() + 1) * 2 > slots.size())
+		grow();
+
+	const Id id = static_cast<Id>(nodes.size());
+	const uint32_t offset = static_cast<uint32_t>(names.size());
+	names.append(name, length);
+	nodes.push_back(Node{ parent, offset, static_cast<uint32_t>(length) });
+
+	const size_t mask = slots.size() - 1;
+	size_t slot = hash(parent, name, length) & mask;
+	while (slots[slot] != 0)
+		slot = (slot + 1) & mask;
+	slots[slot] = id;
+
+	return id;
+}
+
+/**
+ @fn	void PathStore::grow()
+
+ @brief	Doubles the hash table and reinserts all components. mutex must be held exclusively.
+ */
+
+void PathStore::grow() {
+
+	std::vector<Id> grown(slots.size() * 2, 0);
+	const size_t mask = grown.size() - 1;
+
+	for (Id id = 1; id < nodes.size(); id++) {
+		const Node& node = nodes[id];
+		size_t slot = hash(node.parent, names.data() + node.offset, node.length) & mask;
+		while (grown[slot] != 0)
+			slot = (slot + 1) & mask;
+		grown[slot] = id;
+	}
+
+	slots = std::move(grown);
+}
+
+/**
+ @fn	void PathStore::append(Id id, std::string& buffer)
+
+ @brief	Appends a path to a buffer. The length is summed up first, so the buffer
+		grows once and components are copied in place from the last one up. mutex must be held.
+
+ @param	id				Id of the path
+ @param [in,out]	buffer	Buffer to append to
+ */
+
+void PathStore::append(Id id, std::string& buffer) {
+
+	size_t length = 0;
+	for (Id i = id; i != 0; i = nodes[i].parent)
+		length += nodes[i].length;
+
+	size_t end = buffer.size() + length;
+	buffer.resize(end);
+
+	for (Id i = id; i != 0; i = nodes[i].parent) {
+		end -= nodes[i].length;
+		std::memcpy(&buffer[end], names.data() + nodes[i].offset, nodes[i].length);
+	}
+}
@@ -0,0 +1,56 @@
+/**
+ @file	PathStore.h.
+
+ @brief	Declares the path store class.
+		Keeps file paths compactly as a tree of interned components, so songs hold a 32-bit id
+		instead of a whole path. Paths of a library share long directory prefixes, which are
+		stored once. Each component ends with the delimeter that follows it, so paths are rebuilt exactly.
+		Equal paths get equal ids, so paths are compared by comparing ids.
+		A program uses a single store, like the metadata cache.
+		Components are never removed, as ids are copied freely into songs, indexes, filters, history
+		and snapshots without the store knowing. The store thus grows with every distinct path interned
+		during the program's life, also paths of songs since removed, relocated or rescanned, by 20 to 30
+		bytes per new component plus its name. It is bounded by 2^32 components and 4 GiB of names,
+		past which interning throws std::length_error.
+ */
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+class PathStore {
+
+public:
+	typedef uint32_t Id;					/** Identifies a path, 0 is the empty path */
+
+private:
+	/** A component of a path, i.e. a directory or a file name, below its parent */
+	struct Node {
+		Id parent;							/** Path this component continues */
+		uint32_t offset;					/** Start of the name in names */
+		uint32_t length;					/** Length of the name */
+	};
+
+	static std::vector<Node> nodes;			/** Components by id, the empty path first */
+	static std::string names;				/** Names of all components back to back */
+	static std::vector<Id> slots;			/** Open addressing hash table of ids by parent and name, 0 for a free slot */
+	static std::shared_mutex mutex;			/** Guards everything, paths are added and read from several threads */
+	const static size_t decode_batch;		/** Number of paths decoded per lock when streaming */
+
+	static size_t hash(Id parent, const char* name, size_t length) noexcept;	/** Hashes a component */
+	static Id find(Id parent, const char* name, size_t length) noexcept;		/** Finds a component, mutex must be held */
+	static Id add(Id parent, const char* name, size_t length);				/** Adds a component, mutex must be held exclusively */
+	static void grow();														/** Doubles the hash table, mutex must be held exclusively */
+	static void append(Id id, std::string& buffer);							/** Appends a path to a buffer, mutex must be held */
+
+public:
+	static Id intern(const std::string& path);								/** Returns the id of a path, adding it if needed */
+	static std::string get(Id id);											/** Returns the path of an id */
+	static void get(Id id, std::string& buffer);							/** Writes the path of an id into a buffer */
+	static void decode(const std::vector<Id>& ids, const std::function<void(const std::string&)>& callback);	/** Streams the paths of many ids */
+	static size_t getCount();												/** Returns number of components stored */
+	static size_t getMemoryUsage();											/** Returns number of bytes used */
+};
@@ -5,8 +5,22 @@
  */
 
 #include "Playlist.h"
+#include "ReadPlanner.h"
+#include "FileStatus.h"
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <thread>
+#include <utility>
+
+/** Metadata keys whose values are compared as numbers when sorting, e.g. so that track 10 comes after track 9 */
+const std::string Playlist::numeric_strings[] = { "track", "tracknumber", "disc", "discnumber", "year" };
+
+/** Leading articles that are ignored when sorting, so that "The Beatles" sorts under B */
+const std::string Playlist::article_strings[] = { "the ", "a ", "an " };
 
  /**
   @fn	std::istream& operator>>(std::istream& is, Playlist& pl)
@@ -106,7 +120,9 @@ Playlist::Playlist(std::istream &stream) {
  @param	pl	A reference to playlist to copy from
  */
 
-Playlist::Playlist(const Playlist& pl) {
+Playlist::Playlist(const Playlist& pl) :
+	library(pl.library)
+{
 	*this = pl;
 }
 
@@ -118,8 +134,16 @@ Playlist::Playlist(const Playlist& pl) {
  @param [in,out]	pl	Playlist to move from
  */
 
-Playlist::Playlist(Playlist&& pl) noexcept : songs(std::move(pl.songs)) {
+Playlist::Playlist(Playlist&& pl) noexcept : 
+	songs(std::move(pl.songs)),
+	observers(std::move(pl.observers)),
+	history(std::move(pl.history)),
+	published(std::move(pl.published)),
+	library(std::move(pl.library)),
+	filter(std::move(pl.filter))
+{
 	pl.songs.clear();
+	pl.observers.clear();
 }
 
 /**
@@ -136,10 +160,13 @@ Playlist& Playlist::operator=(const Playlist& pl) {
 
 	// Imitate copy constrcutor behaviour and swap results
 	if (this != &pl) {
+
+		auto step = transaction();
+		SongList copied(songs);
 	
 		// We know the number of elements to be added, so better reserve space for them.
 		// This way no realloactions are needed between additions.
-		songs.reserve(pl.songs.size());
+		copied.reserve(copied.size() + pl.songs.size());
 
 		// Deep copy songs. We need const& to traverse the unique_ptr vector.
 		/*
@@ -150,8 +177,10 @@ Playlist& Playlist::operator=(const Playlist& pl) {
 		
 		// This is C++17 equivalent to above transform()
 		for (auto const& s : pl.songs) {
-			songs.emplace_back(s->clone());
+			copied.emplace_back(share(*s));
 		}
+
+		replaceAll(std::move(copied));
 	}
 
 	return *this;
@@ -171,8 +200,15 @@ Playlist& Playlist::operator=(Playlist&& pl) noexcept {
 	if (this == &pl) 
 		return *this;
 
+	// Observers describe the songs, so they move along with them
 	songs = std::move(pl.songs);
+	observers = std::move(pl.observers);
+	history = std::move(pl.history);
+	published = std::move(pl.published);
+	library = std::move(pl.library);
+	filter = std::move(pl.filter);
 	pl.songs.clear();
+	pl.observers.clear();
 
 	return *this;
 }
@@ -180,26 +216,58 @@ Playlist& Playlist::operator=(Playlist&& pl) noexcept {
 /**
  @fn	void Playlist::evaluate()
 
- @brief	Converts all Songs to ConcreteSongs
+ @brief	Converts all Songs to ConcreteSongs.
+		Files are read grouped by directory and disk location, while the songs keep their order.
+		The new songs replace the old ones at once, see EvaluationSession for evaluating gradually.
  */
 
 void Playlist::evaluate() {
-	
+
+	// Files are read in the order ReadPlanner finds fastest, not in playlist order
+	std::vector<SongElement> elements(std::as_const(songs).begin(), std::as_const(songs).end());
+
+	// Songs another playlist of the catalog has evaluated need no reading
+	if (library) {
+		for (auto& element : elements) {
+			if (element->isEvaluated())
+				continue;
+			SongElement canonical = library->find(element->getPathId());
+			if (canonical && canonical->isEvaluated())
+				element = std::move(canonical);
+		}
+	}
+
+	// Evaluated songs are left out, so planning doesn't locate files that won't be read
+	std::vector<std::string> paths;
+	for (auto const& song : elements) {
+		if (!song->isEvaluated())
+			paths.push_back(song->getPath());
+	}
+
+	// Files are read in one batch first, so evaluating the songs finds them cached
+	const std::vector<size_t> order = ReadPlanner::plan(paths);
+	std::vector<std::string> planned;
+	planned.reserve(order.size());
+	for (const size_t i : order)
+		planned.push_back(paths[i]);
+	Metadata::prefetch(planned);
+
+	std::vector<std::shared_ptr<MetaContainer>> metadata(elements.size());
+	for (size_t i = 0; i < elements.size(); i++)
+		metadata[i] = elements[i]->evaluate();
+
 	SongList newlist;
 
 	// Reserve equal amount of space for newlist
-	newlist.reserve(songs.size());
+	newlist.reserve(elements.size());
 
-	for (auto const& song : songs) {
-		newlist.emplace_back(std::make_unique<ConcreteSong>(
-			song->getPath(),
-			song->evaluate()
-		));
+	for (size_t i = 0; i < elements.size(); i++) {
+		newlist.emplace_back(promote(elements[i]->getPathId(), metadata[i]));
 	}
 
 	// replace member songlist with the new one
-	songs = std::move(newlist);
-	// std::swap(newlist, songs);
+	auto step = transaction();
+	replaceAll(std::move(newlist));
 }
 
 /**
@@ -217,12 +285,13 @@ std::list<std::reference_wrapper<const SongElement>> Playlist::evaluate(const So
 
 	std::list<std::reference_wrapper<const SongElement>> evaluated;
 
-	for (auto it = songs.begin(); it != songs.end(); it++) {
+	auto step = transaction();
+	size_t position = 0;
+
+	for (auto it = std::as_const(songs).begin(); it != std::as_const(songs).end(); it++, position++) {
 		if ((**it) == song) {
-			*it = std::make_unique<ConcreteSong>(
-				(**it).getPath(), 
-				(**it).evaluate()
-			);
+			replace(position, promote((*it)->getPathId(), (*it)->evaluate()));
+
 			evaluated.push_back(std::cref(*it));
 		}
 	}
@@ -230,6 +299,152 @@ std::list<std::reference_wrapper<const SongElement>> Playlist::evaluate(const So
 }
 
 
+/**
+ @fn	unsigned int Playlist::evaluate(std::chrono::milliseconds budget)
+
+ @brief	Converts Songs to ConcreteSongs until the time budget runs out.
+		All files are read in the background at once, one thread per mount, so a stalled
+		mount only holds up its own songs. Songs whose metadata isn't available in time
+		stay as they are, while their reads carry on and fill the metadata cache for a later call.
+		Read statistics decide how much is attempted: stalled mounts aren't tried at all,
+		and no more songs are queued on a mount than its average read time fits in the budget.
+
+ @param	budget	Time allowed for evaluation
+
+ @return	Number of songs converted
+ */
+
+unsigned int Playlist::evaluate(std::chrono::milliseconds budget) {
+
+	if (budget.count() <= 0)
+		return 0;
+
+	const auto deadline = std::chrono::steady_clock::now() + budget;
+	const double budget_ms = static_cast<double>(budget.count());
+
+	std::vector<size_t> positions;
+	std::vector<std::string> paths;
+	std::map<std::string, size_t> quotas;	// Songs each mount may still be given
+
+	for (size_t position = 0; position < songs.size(); position++) {
+
+		const SongElement& song = std::as_const(songs)[position];
+		if (song->isEvaluated())
+			continue;
+
+		std::string path = song->getPath();
+		if (!Metadata::canReadWithin(path, budget))
+			continue;
+
+		const std::string mount = Metadata::getMount(path);
+		auto quota = quotas.find(mount);
+		if (quota == quotas.end()) {
+			const MountLatency latency = Metadata::getMountLatency(path);
+			const size_t fits = (latency.reads == 0 || latency.average <= 0.0) ? songs.size() : static_cast<size_t>(budget_ms / latency.average);
+			quota = quotas.emplace(mount, fits).first;
+		}
+
+		// Cached songs cost nothing and don't use up the quota
+		if (!Metadata::isCached(path)) {
+			if (quota->second == 0)
+				continue;
+			quota->second--;
+		}
+
+		positions.push_back(position);
+		paths.push_back(std::move(path));
+	}
+
+	if (paths.empty())
+		return 0;
+
+	std::vector<std::shared_ptr<MetaContainer>> metadata = Metadata::getFileMetadata(paths, deadline);
+
+	auto step = transaction();
+	unsigned int promoted = 0;
+
+	for (size_t i = 0; i < positions.size(); i++) {
+		if (!metadata[i])
+			continue;
+
+		replace(positions[i], promote(std::as_const(songs)[positions[i]]->getPathId(), metadata[i]));
+		promoted++;
+	}
+
+	return promoted;
+}
+
+/**
+ @fn	std::vector<StaleSong> Playlist::validate(Repair repair, unsigned int threads)
+
+ @brief	Finds songs whose files are missing, or have changed since their metadata was read,
+		by querying all files at once, see FileStatus. Songs whose metadata wasn't read
+		through the metadata cache can only be found missing. Metadata cached for stale
+		files is forgotten. Repairs are made in one pass and are one undoable edit.
+
+ @param	repair	What to do with the stale songs
+		threads	Number of threads querying files, 0 to decide by the number of cores
+
+ @return	Stale songs in playlist order
+ */
+
+std::vector<StaleSong> Playlist::validate(Repair repair, unsigned int threads) {
+
+	std::vector<std::string> paths;
+	paths.reserve(songs.size());
+	for (auto const& song : std::as_const(songs))
+		paths.push_back(song->getPath());
+
+	const std::vector<FileStamp> stamps = FileStatus::stat(paths, threads);
+
+	std::vector<StaleSong> stale;
+	for (size_t i = 0; i < paths.size(); i++) {
+		FileStamp read;
+		if (!stamps[i].exists)
+			stale.push_back(StaleSong{ i, paths[i], true });
+		else if (Metadata::getFileStamp(paths[i], read) && read != stamps[i])
+			stale.push_back(StaleSong{ i, paths[i], false });
+	}
+
+	if (stale.empty())
+		return stale;
+
+	std::vector<std::string> forgotten;
+	for (const StaleSong& song : stale)
+		forgotten.push_back(song.path);
+	Metadata::invalidate(forgotten);
+
+	if (repair == Repair::None)
+		return stale;
+
+	auto step = transaction();
+
+	// Changed songs are replaced before missing ones are erased, while positions still hold
+	if (repair == Repair::Reevaluate) {
+		std::vector<size_t> changed;
+		std::vector<std::string> unread;
+		for (const StaleSong& song : stale) {
+			if (!song.missing && std::as_const(songs)[song.position]->isEvaluated()) {
+				changed.push_back(song.position);
+				unread.push_back(song.path);
+			}
+		}
+
+		Metadata::prefetch(unread);
+		for (size_t i = 0; i < changed.size(); i++)
+			replace(changed[i], promote(std::as_const(songs)[changed[i]]->getPathId(), Metadata::getFileMetadata(unread[i])));
+	}
+
+	std::vector<size_t> missing;
+	for (const StaleSong& song : stale) {
+		if (song.missing)
+			missing.push_back(song.position);
+	}
+	erase(missing);
+
+	return stale;
+}
+
 /**
  @fn	void Playlist::print(std::ostream& os) const
 
@@ -266,7 +481,28 @@ std::unique_ptr<Playlist> Playlist::clone() const {
  */
 
 void Playlist::add(const Song& song) {
-	songs.emplace_back(song.clone());
+	auto step = transaction();
+	insert(songs.size(), share(song));
+}
+
+/**
+ @fn	void Playlist::insert(size_t position, const SongElement& song)
+
+ @brief			Inserts a song to the playlist and notifies observers
+
+ @param	position	Position to insert to, at most the number of songs
+ @param	song		The song to insert
+ */
+
+void Playlist::insert(size_t position, const SongElement& song) {
+
+	songs.insert(position, song);
+
+	if (history)
+		history->recordInsert(position, song);
+
+	for (auto const& observer : observers)
+		observer->inserted(position, *song);
 }
 
 /**
@@ -278,13 +514,355 @@ void Playlist::add(const Song& song) {
  */
 
 void Playlist::remove(const Song& song) {
-	
-	for (auto it = songs.begin(); it != songs.end();) {
-		if (**it == song)
-			it = songs.erase(it);
-		else
-			it++;
+
+	std::vector<size_t> positions;
+	size_t position = 0;
+
+	for (auto const& s : std::as_const(songs)) {
+		if (*s == song)
+			positions.push_back(position);
+		position++;
+	}
+
+	auto step = transaction();
+	erase(positions);
+}
+
+/**
+ @fn			unsigned int Playlist::dedupe(SongIdentity identity, Occurrence keep)
+
+ @brief			Removes duplicate songs from the playlist.
+				Songs are checked against a hash set of already seen songs in a single pass,
+				and the duplicates are then removed in a single sweep.
+
+ @param	identity	When two songs are considered duplicates
+ @param	keep		Which of the duplicates stays in the playlist
+
+ @return unsigned int	Number of removed songs
+ */
+
+unsigned int Playlist::dedupe(SongIdentity identity, Occurrence keep) {
+
+	SongSet seen(identity);
+	seen.reserve(songs.size());
+
+	std::vector<size_t> duplicates;
+
+	if (keep == Occurrence::First) {
+		size_t position = 0;
+		for (auto const& song : std::as_const(songs)) {
+			if (!seen.insert(*song))
+				duplicates.push_back(position);
+			position++;
+		}
+	}
+	else {
+		for (size_t i = songs.size(); i-- > 0;) {
+			if (!seen.insert(*std::as_const(songs)[i]))
+				duplicates.push_back(i);
+		}
+		std::reverse(duplicates.begin(), duplicates.end());
+	}
+
+	auto step = transaction();
+	erase(duplicates);
+	return static_cast<unsigned int>(duplicates.size());
+}
+
+/**
+ @fn			Playlist Playlist::setUnion(const Playlist& other, SongIdentity identity) const
+
+ @brief			Makes a playlist of songs found in either playlist.
+				Like all set operations, the result has no duplicates and keeps the order
+				songs first appear in, this playlist first. Songs are shared with the
+				source playlists instead of being cloned. Runs in O(n + m).
+
+ @param	other		Playlist to combine with
+ @param	identity	When two songs are considered the same
+
+ @return Playlist	The union of the playlists
+ */
+
+Playlist Playlist::setUnion(const Playlist& other, SongIdentity identity) const {
+
+	Playlist result;
+	SongSet seen(identity);
+	seen.reserve(songs.size() + other.songs.size());
+
+	for (const SongList* list : { &songs, &other.songs }) {
+		for (auto const& song : *list) {
+			if (seen.insert(*song))
+				result.songs.push_back(song);
+		}
 	}
+
+	return result;
+}
+
+/**
+ @fn			Playlist Playlist::setIntersection(const Playlist& other, SongIdentity identity) const
+
+ @brief			Makes a playlist of songs found in both playlists, in this playlist's order
+
+ @param	other		Playlist to intersect with
+ @param	identity	When two songs are considered the same
+
+ @return Playlist	The intersection of the playlists
+ */
+
+Playlist Playlist::setIntersection(const Playlist& other, SongIdentity identity) const {
+
+	SongSet theirs(identity);
+	theirs.reserve(other.songs.size());
+	for (auto const& song : other.songs)
+		theirs.insert(*song);
+
+	Playlist result;
+	SongSet seen(identity);
+
+	for (auto const& song : songs) {
+		if (theirs.contains(*song) && seen.insert(*song))
+			result.songs.push_back(song);
+	}
+
+	return result;
+}
+
+/**
+ @fn			Playlist Playlist::setDifference(const Playlist& other, SongIdentity identity) const
+
+ @brief			Makes a playlist of songs found in this playlist but not in the other
+
+ @param	other		Playlist whose songs are excluded
+ @param	identity	When two songs are considered the same
+
+ @return Playlist	The difference of the playlists
+ */
+
+Playlist Playlist::setDifference(const Playlist& other, SongIdentity identity) const {
+
+	// Seeding the seen set with the other playlist excludes its songs and duplicates in one go
+	SongSet seen(identity);
+	seen.reserve(songs.size() + other.songs.size());
+	for (auto const& song : other.songs)
+		seen.insert(*song);
+
+	Playlist result;
+	for (auto const& song : songs) {
+		if (seen.insert(*song))
+			result.songs.push_back(song);
+	}
+
+	return result;
+}
+
+/**
+ @fn			Playlist Playlist::setSymmetricDifference(const Playlist& other, SongIdentity identity) const
+
+ @brief			Makes a playlist of songs found in exactly one of the playlists,
+				songs of this playlist first
+
+ @param	other		Playlist to compare with
+ @param	identity	When two songs are considered the same
+
+ @return Playlist	The symmetric difference of the playlists
+ */
+
+Playlist Playlist::setSymmetricDifference(const Playlist& other, SongIdentity identity) const {
+
+	Playlist result = setDifference(other, identity);
+	Playlist theirs = other.setDifference(*this, identity);
+
+	result.songs.reserve(result.songs.size() + theirs.songs.size());
+	for (auto& song : theirs.songs)
+		result.songs.push_back(std::move(song));
+
+	return result;
+}
+
+/**
+ @fn			void Playlist::erase(const std::vector<size_t>& positions)
+
+ @brief			Removes songs at the given positions.
+				Remaining songs are shifted down in one sweep, instead of
+				closing the gap after every single removed song.
+
+ @param	positions	Ascending positions of the songs to remove
+ */
+
+void Playlist::erase(const std::vector<size_t>& positions) {
+
+	if (positions.empty())
+		return;
+
+	// Observers need to know what goes away before it's gone
+	for (auto const& observer : observers)
+		observer->erasing(positions, songs);
+
+	if (history && history->isRecording()) {
+		std::vector<SongElement> erased;
+		erased.reserve(positions.size());
+		for (size_t position : positions)
+			erased.push_back(std::as_const(songs)[position]);
+		history->recordErase(positions, std::move(erased));
+	}
+
+	songs.erase(positions);
+}
+
+/**
+ @fn			void Playlist::replace(size_t position, SongElement&& song)
+
+ @brief			Replaces the song at given position and notifies observers
+
+ @param	position	Position of the song to replace
+ @param	song		The new song
+ */
+
+void Playlist::replace(size_t position, SongElement&& song) {
+
+	SongElement before = std::move(songs[position]);
+	songs[position] = std::move(song);
+
+	if (history)
+		history->recordReplace(position, before);
+
+	for (auto const& observer : observers)
+		observer->replaced(position, *before, *songs[position]);
+}
+
+/**
+ @fn			void Playlist::replaceAll(SongList&& list)
+
+ @brief			Replaces all songs at once and notifies observers
+
+ @param	list	The new songs
+ */
+
+void Playlist::replaceAll(SongList&& list) {
+
+	std::swap(songs, list);
+
+	if (history)
+		history->recordReset(std::move(list));
+
+	notifyReset();
+}
+
+/**
+ @fn			PlaylistHistory::Transaction Playlist::transaction()
+
+ @brief			Begins an undoable step. All edits made until the returned guard
+				goes out of scope are undone and redone together.
+
+ @return PlaylistHistory::Transaction	Guard committing the step when destroyed
+ */
+
+PlaylistHistory::Transaction Playlist::transaction() {
+	return PlaylistHistory::Transaction(history.get());
+}
+
+/**
+ @fn	void Playlist::insertAt(size_t position, const Song& song)
+
+ @brief			Inserts a copy of a song at given position, in O(log n)
+
+ @param	position	Position to insert to. The song currently there and those after it move forward.
+ @param	song		The song to insert
+
+ @throws std::out_of_range if position is past the end of the playlist
+ */
+
+void Playlist::insertAt(size_t position, const Song& song) {
+
+	if (position > songs.size())
+		throw std::out_of_range("Song position out of range");
+
+	auto step = transaction();
+	insert(position, share(song));
+}
+
+/**
+ @fn	void Playlist::eraseAt(size_t position)
+
+ @brief			Removes the song at given position, in O(log n)
+
+ @param	position	Position of the song to remove
+
+ @throws std::out_of_range if position is past the end of the playlist
+ */
+
+void Playlist::eraseAt(size_t position) {
+
+	if (position >= songs.size())
+		throw std::out_of_range("Song position out of range");
+
+	auto step = transaction();
+	erase({ position });
+}
+
+/**
+ @fn	void Playlist::move(size_t from, size_t to)
+
+ @brief			Moves a song to another position, in O(log n).
+				Songs between the positions shift by one to fill the gap.
+
+ @param	from	Current position of the song
+ @param	to		Position of the song after the move
+
+ @throws std::out_of_range if either position is past the end of the playlist
+ */
+
+void Playlist::move(size_t from, size_t to) {
+
+	if (from >= songs.size() || to >= songs.size())
+		throw std::out_of_range("Song position out of range");
+
+	if (from == to)
+		return;
+
+	auto step = transaction();
+	SongElement song = songs[from];
+	erase({ from });
+	insert(to, song);
+}
+
+/**
+ @fn	unsigned int Playlist::relocate(const PathRelocator& relocator)
+
+ @brief	Rewrites paths of songs under relocated prefixes in one pass over the playlist.
+		Relocated songs keep their metadata, other songs are shared as they are.
+		Metadata::relocate() moves the metadata cache along.
+
+ @param	relocator	Old and new prefixes
+
+ @return	Number of relocated songs
+ */
+
+unsigned int Playlist::relocate(const PathRelocator& relocator) {
+
+	SongList newlist;
+	newlist.reserve(songs.size());
+
+	unsigned int relocated = 0;
+	std::string path;
+
+	for (auto const& song : std::as_const(songs)) {
+		if (relocator.relocate(song->getPath(), path)) {
+			newlist.push_back(share(song->relocated(path)));
+			relocated++;
+		}
+		else {
+			newlist.push_back(song);
+		}
+	}
+
+	if (relocated == 0)
+		return 0;
+
+	auto step = transaction();
+	replaceAll(std::move(newlist));
+	return relocated;
 }
 
 /**
@@ -306,8 +884,322 @@ unsigned int Playlist::getCount() noexcept {
 
  */
 
-void Playlist::clear() noexcept {
-	songs.clear();
+void Playlist::clear() {
+	auto step = transaction();
+	replaceAll(SongList());
+}
+
+/**
+ @fn			const Song& Playlist::at(size_t position) const
+
+ @brief			Returns the song at given position, e.g. one found using an index
+
+ @param	position	Zero based position of the song in the playlist
+
+ @return const Song&	Reference to the song
+
+ @throws std::out_of_range if position is past the end of the playlist
+ */
+
+const Song& Playlist::at(size_t position) const {
+	return *songs.at(position);
+}
+
+/**
+ @fn			void Playlist::attach(const std::shared_ptr<PlaylistObserver>& observer)
+
+ @brief			Attaches an observer to the playlist.
+				The observer is first reset with current songs and from then on
+				notified of every change, until detached.
+
+ @param	observer	The observer to attach
+ */
+
+void Playlist::attach(const std::shared_ptr<PlaylistObserver>& observer) {
+
+	if (std::find(observers.begin(), observers.end(), observer) != observers.end())
+		return;
+
+	observer->reset(songs);
+	observers.push_back(observer);
+}
+
+/**
+ @fn			void Playlist::detach(const std::shared_ptr<PlaylistObserver>& observer)
+
+ @brief			Detaches an observer, it won't be notified of further changes
+
+ @param	observer	The observer to detach
+ */
+
+void Playlist::detach(const std::shared_ptr<PlaylistObserver>& observer) {
+	observers.erase(std::remove(observers.begin(), observers.end(), observer), observers.end());
+}
+
+/**
+ @fn			void Playlist::publish()
+
+ @brief			Publishes the current songs as a new version for snapshot readers.
+				The published list shares its blocks with the playlist until the playlist
+				modifies them, so publishing costs O(n / block size).
+				Edits made after publishing aren't visible to readers until published again,
+				so readers never see a half done load() or evaluate().
+				The new version is built before it is swapped in with std::atomic_store,
+				which is not lock-free: it takes a short lock around the pointer swap only,
+				and the old version is released after the lock.
+				Only the writer may call this, one thread at a time.
+ */
+
+void Playlist::publish() {
+	std::atomic_store(&published, std::shared_ptr<const SongList>(std::make_shared<SongList>(songs)));
+}
+
+/**
+ @fn			PlaylistSnapshot Playlist::snapshot() const
+
+ @brief			Returns the latest published version of the playlist.
+				Can be called from any thread, also while the playlist is being edited.
+				std::atomic_load takes the same short lock as publish(), held to copy the pointer
+				and bump its reference count, so readers wait for at most a pointer swap,
+				never for an edit or evaluation in progress.
+				The snapshot stays unchanged and valid however the playlist is edited or published afterwards.
+
+ @return PlaylistSnapshot	The published songs, empty if nothing was published yet
+ */
+
+PlaylistSnapshot Playlist::snapshot() const {
+	return PlaylistSnapshot(std::atomic_load(&published));
+}
+
+/**
+ @fn			void Playlist::useLibrary(const std::shared_ptr<Library>& catalog)
+
+ @brief			Shares songs through a catalog with other playlists using it.
+				Songs of the playlist are switched to the catalog's songs for their paths,
+				and songs added or evaluated later are taken from the catalog too.
+				Without a catalog songs added to the playlist are copies of their own.
+
+ @param	catalog	The catalog to use, nullptr to stop sharing new songs
+ */
+
+void Playlist::useLibrary(const std::shared_ptr<Library>& catalog) {
+
+	library = catalog;
+	if (!library)
+		return;
+
+	SongList shared;
+	shared.reserve(songs.size());
+	bool changed = false;
+
+	for (auto const& song : std::as_const(songs)) {
+		shared.emplace_back(library->share(*song));
+		changed = changed || shared.back() != song;
+	}
+
+	if (changed) {
+		auto step = transaction();
+		replaceAll(std::move(shared));
+	}
+}
+
+/**
+ @fn			std::shared_ptr<Library> Playlist::getLibrary() const noexcept
+
+ @brief			Returns the catalog in use
+
+ @return		The catalog, nullptr if songs aren't shared
+ */
+
+std::shared_ptr<Library> Playlist::getLibrary() const noexcept {
+	return library;
+}
+
+/**
+ @fn			void Playlist::enableFilter(bool enabled)
+
+ @brief			Starts or stops keeping a bloom filter of song paths.
+				The filter is attached as an observer, so additions update it as they happen.
+				Removals leave it answering yes for more paths, until it's rebuilt on the next lookup.
+
+ @param	enabled	True to start keeping the filter, false to drop it
+ */
+
+void Playlist::enableFilter(bool enabled) {
+
+	if (!enabled) {
+		if (filter)
+			detach(filter);
+		filter.reset();
+	}
+	else if (!filter) {
+		filter = std::make_shared<BloomFilter>();
+		attach(filter);
+	}
+}
+
+/**
+ @fn			std::shared_ptr<const BloomFilter> Playlist::getFilter()
+
+ @brief			Returns the bloom filter, rebuilt first if removals have made it stale.
+				E.g. a caller checking thousands of playlists for a song can rule most of them
+				out with the filters, before searching the rest with has().
+
+ @return		The filter, nullptr if disabled
+ */
+
+std::shared_ptr<const BloomFilter> Playlist::getFilter() {
+
+	if (filter && filter->isStale())
+		filter->reset(songs);
+
+	return filter;
+}
+
+/**
+ @fn			void Playlist::enableHistory(bool enabled)
+
+ @brief			Starts or stops recording edits for undo and redo.
+				Edits are recorded as small operations referencing the shared songs,
+				so the playlist is never copied. Stopping forgets the recorded edits.
+
+ @param	enabled	True to start recording, false to stop
+ */
+
+void Playlist::enableHistory(bool enabled) {
+
+	if (!enabled)
+		history.reset();
+	else if (!history)
+		history = std::make_unique<PlaylistHistory>();
+}
+
+/**
+ @fn			bool Playlist::undo()
+
+ @brief			Reverts the latest edit. Edits are undone as whole calls,
+				e.g. undoing a sortBy() restores the previous order at once.
+
+ @return bool	TRUE if an edit was reverted, FALSE if there was nothing to undo
+ */
+
+bool Playlist::undo() {
+
+	if (!canUndo())
+		return false;
+
+	history->pushRedo(revert(history->popUndo()));
+	return true;
+}
+
+/**
+ @fn			bool Playlist::redo()
+
+ @brief			Reapplies the latest undone edit. Any new edit clears the edits to redo.
+
+ @return bool	TRUE if an edit was reapplied, FALSE if there was nothing to redo
+ */
+
+bool Playlist::redo() {
+
+	if (!canRedo())
+		return false;
+
+	history->pushUndo(revert(history->popRedo()));
+	return true;
+}
+
+/**
+ @fn			bool Playlist::canUndo() const noexcept
+
+ @brief			Tells if there is an edit to undo
+
+ @return bool	TRUE if undo() would do something
+ */
+
+bool Playlist::canUndo() const noexcept {
+	return history && history->canUndo();
+}
+
+/**
+ @fn			bool Playlist::canRedo() const noexcept
+
+ @brief			Tells if there is an undone edit to redo
+
+ @return bool	TRUE if redo() would do something
+ */
+
+bool Playlist::canRedo() const noexcept {
+	return history && history->canRedo();
+}
+
+/**
+ @fn			PlaylistHistory::Step Playlist::revert(PlaylistHistory::Step&& step)
+
+ @brief			Reverts the edits of a step, latest first. Each edit is turned into
+				its own inverse in place, so the returned step reapplies the edits.
+				Observers are notified as with any other change.
+
+ @param	step	The step to revert
+
+ @return PlaylistHistory::Step	Step reverting this one
+ */
+
+PlaylistHistory::Step Playlist::revert(PlaylistHistory::Step&& step) {
+
+	typedef PlaylistHistory::Edit::Type Type;
+
+	history->pause(true);
+
+	for (auto it = step.rbegin(); it != step.rend(); it++) {
+
+		PlaylistHistory::Edit& edit = *it;
+
+		switch (edit.type) {
+
+		// Inserted songs are at their recorded positions, as they were inserted in ascending order
+		case Type::Insert:
+			erase(edit.positions);
+			edit.type = Type::Erase;
+			break;
+
+		// Inserting in ascending order puts every song back where it was erased from
+		case Type::Erase:
+			for (size_t i = 0; i < edit.positions.size(); i++)
+				insert(edit.positions[i], edit.songs[i]);
+			edit.type = Type::Insert;
+			break;
+
+		case Type::Replace: {
+			SongElement current = songs[edit.positions.front()];
+			replace(edit.positions.front(), std::move(edit.songs.front()));
+			edit.songs.front() = std::move(current);
+			break;
+		}
+
+		case Type::Reset:
+			std::swap(songs, edit.list);
+			notifyReset();
+			break;
+		}
+	}
+
+	history->pause(false);
+
+	std::reverse(step.begin(), step.end());
+	return std::move(step);
+}
+
+/**
+ @fn			void Playlist::notifyReset() const
+
+ @brief			Tells all observers the song list was replaced as a whole
+ */
+
+void Playlist::notifyReset() const {
+
+	for (auto const& observer : observers)
+		observer->reset(songs);
 }
 
 /**
@@ -321,39 +1213,110 @@ void Playlist::clear() noexcept {
 void Playlist::load(std::istream &is) {
 
 	std::string line;
-	const std::string delimeter = ": ";
-	const size_t delimeter_len = delimeter.length();
+	auto step = transaction();
 
 	while (std::getline(is, line)) {
 
-		const size_t pos = line.find(delimeter);
+		// Lines that can't be parsed are skipped
+		SongElement song = parseSong(line);
+		if (song)
+			insert(songs.size(), share(std::move(song)));
+	}
+}
 
-		// Confirm line can be parsed correctly, if not, skip this line
-		if (pos == std::string::npos || line.length() <= (pos + delimeter_len))
-			continue;
+/**
+ @fn			SongElement Playlist::parseSong(const std::string& line)
 
-		// Find where the path ends. (There should be another ": ")
-		size_t endpos = line.find(delimeter, pos + delimeter_len);
-		endpos = (endpos == std::string::npos) ? line.length() : endpos;
-		endpos -= pos + delimeter_len;
-		
-		const std::string type = line.substr(0, pos);
-		const std::string path = line.substr(pos + delimeter_len, endpos);
+ @brief			Parses a song from its printed representation, e.g. a line of a playlist file
+
+ @param line	Line to parse, as printed by the song
+
+ @return SongElement	The parsed song, or nullptr if the line is not a valid song
+ */
+
+SongElement Playlist::parseSong(const std::string& line) {
+
+	const std::string delimeter = ": ";
+	const size_t delimeter_len = delimeter.length();
+	const size_t pos = line.find(delimeter);
+
+	// Confirm line can be parsed correctly
+	if (pos == std::string::npos || line.length() <= (pos + delimeter_len))
+		return nullptr;
+
+	// Find where the path ends. (There should be another ": ")
+	size_t endpos = line.find(delimeter, pos + delimeter_len);
+	endpos = (endpos == std::string::npos) ? line.length() : endpos;
+	endpos -= pos + delimeter_len;
 	
-		if (type == "ProxySong") {
-			add(ProxySong(path));
-		}
-		
-		else if (type == "ConcreteSong") {
-			add(ConcreteSong(path, Metadata::getFileMetadata(path)));
-		}
-		/*
-		else {
-			std::cout << "unsolved type: " << type << std::endl;
-			std::cout << "unsolved path: " << path << std::endl;
-		}
-		*/
-	}
+	const std::string type = line.substr(0, pos);
+	const std::string path = line.substr(pos + delimeter_len, endpos);
+
+	if (type == "ProxySong")
+		return std::make_shared<ProxySong>(path);
+
+	if (type == "ConcreteSong")
+		return std::make_shared<ConcreteSong>(path, Metadata::getFileMetadata(path));
+
+	return nullptr;
+}
+
+/**
+ @fn			bool Playlist::matchesByPath(const Song& song) noexcept
+
+ @brief			Tells if the songs equal to a song all have its path.
+				Concrete songs also equal concrete songs of other paths with the same metadata.
+
+ @param song	The song to compare others to
+
+ @return bool	TRUE if only songs with the same path equal the song
+ */
+
+bool Playlist::matchesByPath(const Song& song) noexcept {
+	return dynamic_cast<const ConcreteSong*>(&song) == nullptr;
+}
+
+/**
+ @fn			SongElement Playlist::share(const Song& song) const
+
+ @brief			Returns the element to store for a song added to the playlist
+
+ @param song	The song to add
+
+ @return SongElement	The catalog's song for the path in catalog mode, otherwise a copy of the song
+ */
+
+SongElement Playlist::share(const Song& song) const {
+	return library ? library->share(song) : SongElement(song.clone());
+}
+
+/**
+ @fn			SongElement Playlist::share(SongElement&& song) const
+
+ @brief			Returns the element to store for a newly created song
+
+ @param song	The new song
+
+ @return SongElement	The catalog's song for the path in catalog mode, otherwise the song itself
+ */
+
+SongElement Playlist::share(SongElement&& song) const {
+	return library ? library->share(*song) : std::move(song);
+}
+
+/**
+ @fn			SongElement Playlist::promote(PathStore::Id path, const std::shared_ptr<MetaContainer>& metadata) const
+
+ @brief			Returns an evaluated element for a path and its metadata
+
+ @param path		Id of the song's path
+ @param metadata	Metadata of the song
+
+ @return SongElement	The catalog's evaluated song in catalog mode, otherwise a new ConcreteSong
+ */
+
+SongElement Playlist::promote(PathStore::Id path, const std::shared_ptr<MetaContainer>& metadata) const {
+	return library ? library->promote(path, metadata) : std::make_shared<ConcreteSong>(path, metadata);
 }
 
 /**
@@ -375,4 +1338,154 @@ void Playlist::writeToFile(const std::string& path) const {
 
 	if (file.fail() && !file.eof())
 		throw std::runtime_error("Error writing to playlist file");
+}
+
+/**
+ @fn			std::string Playlist::makeSortKey(const Song& song, const std::vector<std::string>& keys)
+
+ @brief			Builds a normalized sort key of a song, so that songs can be ordered
+				by plain string comparison of their keys.
+				Text values are lowercased and stripped of leading articles.
+				Numeric values (see numeric_strings) are zero padded, so "9" sorts before "10".
+				Each field is prefixed with a marker sorting missing values last,
+				and terminated with a null character so fields never run into each other.
+				Unevaluated songs have no known values and sort after evaluated ones.
+
+ @param song	The song to build key for
+ @param keys	Metadata keys to sort by, most significant first
+
+ @return std::string	The sort key
+ */
+
+std::string Playlist::makeSortKey(const Song& song, const std::vector<std::string>& keys) {
+
+	std::shared_ptr<MetaContainer> metadata = song.isEvaluated() ? song.evaluate() : nullptr;
+	std::string sortkey;
+
+	for (const std::string& key : keys) {
+
+		const MetaContainer::const_iterator it = metadata ? metadata->find(key) : MetaContainer::const_iterator();
+		if (!metadata || it == metadata->cend()) {
+			sortkey += "\x02";
+			sortkey += '\0';
+			continue;
+		}
+
+		std::string value = it->second;
+		std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) {
+			return static_cast<char>(std::tolower(c));
+		});
+
+		if (std::find(std::begin(numeric_strings), std::end(numeric_strings), key) != std::end(numeric_strings)) {
+
+			// Track numbers like "3/12" sort by their leading number
+			const size_t digits = value.find_first_not_of("0123456789");
+			value = value.substr(0, digits);
+			const size_t zeros = value.find_first_not_of('0');
+			value = (zeros == std::string::npos) ? "0" : value.substr(zeros);
+
+			if (value.length() < 20)
+				value.insert(0, 20 - value.length(), '0');
+		}
+		else {
+			for (const std::string& article : article_strings) {
+				if (value.length() > article.length() && value.compare(0, article.length(), article) == 0) {
+					value.erase(0, article.length());
+					break;
+				}
+			}
+		}
+
+		sortkey += "\x01";
+		sortkey += value;
+		sortkey += '\0';
+	}
+
+	return sortkey;
+}
+
+/**
+ @fn			void Playlist::sortBy(const std::vector<std::string>& keys)
+
+ @brief			Sorts songs by metadata fields, e.g. sortBy({ "artist", "album", "track" }).
+				The sort is stable, songs with equal keys keep their order.
+				Sort keys are built once per song, then an index permutation is sorted
+				in parallel slices that are merged pairwise. Songs are finally moved
+				to their places, no song is copied.
+
+ @param keys	Metadata keys to sort by, most significant first
+ */
+
+void Playlist::sortBy(const std::vector<std::string>& keys) {
+
+	const size_t count = songs.size();
+	if (count < 2 || keys.empty())
+		return;
+
+	const size_t min_slice = 10000;
+	const size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count / min_slice + 1);
+	const size_t slice = (count + threads - 1) / threads;
+
+	// Most comparisons are decided by the first bytes of the keys, so those are
+	// packed into an integer next to the song index, and key strings are only
+	// consulted on ties
+	struct SortEntry {
+		uint64_t prefix;
+		unsigned int index;
+	};
+
+	std::vector<std::string> sortkeys(count);
+	std::vector<SortEntry> order(count);
+
+	auto less = [&sortkeys](const SortEntry& a, const SortEntry& b) {
+		if (a.prefix != b.prefix)
+			return a.prefix < b.prefix;
+		return sortkeys[a.index] < sortkeys[b.index];
+	};
+
+	// Build keys and sort each slice on its own thread
+	auto sortSlice = [&](size_t t) {
+		const size_t begin = std::min(count, t * slice);
+		const size_t end = std::min(count, begin + slice);
+		for (size_t i = begin; i < end; i++) {
+			sortkeys[i] = makeSortKey(*std::as_const(songs)[i], keys);
+
+			uint64_t prefix = 0;
+			for (size_t j = 0; j < sizeof(prefix); j++)
+				prefix = (prefix << 8) | ((j < sortkeys[i].length()) ? static_cast<unsigned char>(sortkeys[i][j]) : 0);
+
+			order[i] = SortEntry{ prefix, static_cast<unsigned int>(i) };
+		}
+		std::stable_sort(order.begin() + begin, order.begin() + end, less);
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t t = 1; t < threads; t++)
+		workers.emplace_back(sortSlice, t);
+	sortSlice(0);
+	for (std::thread& worker : workers)
+		worker.join();
+
+	// Merge neighbouring slices until one is left. Merging keeps stability,
+	// because the left slice always holds the earlier songs.
+	for (size_t width = slice; width < count; width *= 2) {
+		workers.clear();
+		for (size_t begin = 0; begin + width < count; begin += 2 * width) {
+			const size_t middle = begin + width;
+			const size_t end = std::min(count, middle + width);
+			workers.emplace_back([&order, &less, begin, middle, end]() {
+				std::inplace_merge(order.begin() + begin, order.begin() + middle, order.begin() + end, less);
+			});
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	SongList sorted;
+	sorted.reserve(count);
+	for (const SortEntry& entry : order)
+		sorted.push_back(std::as_const(songs)[entry.index]);
+
+	auto step = transaction();
+	replaceAll(std::move(sorted));
 }
\ No newline at end of file
@@ -11,21 +11,75 @@
 #include <vector>
 #include <memory>
 #include <list>
+#include <chrono>
+#include <utility>
 
 #include "Song.h"
 #include "ConcreteSong.h"
 #include "ProxySong.h"
+#include "PlaylistObserver.h"
+#include "SongSet.h"
+#include "PlaylistHistory.h"
+#include "PlaylistSnapshot.h"
+#include "PathRelocator.h"
+#include "Library.h"
+#include "BloomFilter.h"
 
-typedef std::unique_ptr<Song> SongElement;	/** Convenience typedef for songs */
-typedef std::vector<SongElement> SongList;	/** Convenience typedef for container of songs */
+/** Defines which of equal songs is kept when deduplicating */
+enum class Occurrence {
+	First,	/** Keep the earliest song */
+	Last	/** Keep the latest song */
+};
+
+/** Defines what validation does with songs whose files are missing or changed */
+enum class Repair {
+	None,		/** Only report them */
+	Prune,		/** Remove missing songs */
+	Reevaluate	/** Remove missing songs and read metadata of changed ones again */
+};
+
+/** A song whose file is missing or has changed since its metadata was read */
+struct StaleSong {
+	size_t position;			/** Position of the song before any repair */
+	std::string path;			/** Path of the song's file */
+	bool missing;				/** TRUE if the file is gone, FALSE if it has changed */
+};
 
 class Playlist {
 
 	friend std::ostream& operator<<(std::ostream&, const Playlist&);	/** Inserts all songs to given ostream */
 	friend std::istream& operator>>(std::istream&, Playlist&);		/** Add songs from a file */
+	friend class PlaylistPatch;										/** Patches edit songs in place */
+	friend class EvaluationSession;									/** Sessions evaluate songs in place */
+	friend class LibraryScanner;									/** Scanners add found songs as they go */
+	friend class PlaylistRegistry;									/** Registries remove songs by path */
+
+private:
+	const static std::string numeric_strings[];		/** Metadata keys that are sorted as numbers */
+	const static std::string article_strings[];		/** Leading articles ignored when sorting */
+
+	static std::string makeSortKey(const Song&, const std::vector<std::string>& keys);	/** Builds a normalized sort key of a song */
 
 protected:
 	SongList songs;									/** List of songs (that implement Song interface) in the playlist */
+	std::vector<std::shared_ptr<PlaylistObserver>> observers;	/** Secondary structures kept up to date with songs */
+	std::unique_ptr<PlaylistHistory> history;		/** Recorded edits for undo and redo, nullptr when disabled */
+	std::shared_ptr<const SongList> published;		/** Latest published version of songs, swapped with std::atomic_load/store */
+	std::shared_ptr<Library> library;				/** Catalog sharing songs with other playlists, nullptr when songs are private */
+	std::shared_ptr<BloomFilter> filter;			/** Summary of song paths for quick negative lookups, nullptr when disabled */
+
+	void notifyReset() const;						/** Tells observers the whole song list changed */
+	void erase(const std::vector<size_t>& positions);	/** Removes songs at ascending positions in one sweep */
+	void insert(size_t position, const SongElement&);	/** Inserts a song at position */
+	void replace(size_t position, SongElement&&);		/** Replaces the song at position */
+	void replaceAll(SongList&&);					/** Replaces all songs at once */
+	PlaylistHistory::Transaction transaction();		/** Groups edits made during its lifetime into one undoable step */
+	PlaylistHistory::Step revert(PlaylistHistory::Step&&);	/** Reverts a recorded step, returning its inverse */
+	static SongElement parseSong(const std::string&);	/** Parses a song from its printed representation */
+	static bool matchesByPath(const Song&) noexcept;	/** Tells if songs equal to a song share its path */
+	SongElement share(const Song&) const;			/** Returns the element to store for a song, canonical in catalog mode */
+	SongElement share(SongElement&&) const;			/** Returns the element to store for a new element, canonical in catalog mode */
+	SongElement promote(PathStore::Id, const std::shared_ptr<MetaContainer>&) const;	/** Returns an evaluated element, canonical in catalog mode */
 
 public:
 	~Playlist();									/** Desctructor */
@@ -39,20 +93,55 @@ public:
 
 	void evaluate();								/** Converts all Songs to ConcreteSongs */
 	std::list<std::reference_wrapper<const SongElement>> evaluate(const Song&); /** Converts a given Song to ConcreteSong */
+	unsigned int evaluate(std::chrono::milliseconds budget);	/** Converts Songs to ConcreteSongs until time runs out */
+	std::vector<StaleSong> validate(Repair repair = Repair::None, unsigned int threads = 0);	/** Finds songs whose files are missing or changed */
 	std::unique_ptr<Playlist> clone() const;		/** Clones playlist to a new unique pointer */
 	void print(std::ostream&) const;				/** Inserts all songs to given ostream */
 	void load(std::istream&);						/** Loads songs from input stream */
 	void writeToFile(const std::string&) const;		/** Writes playlist to file */
+	void sortBy(const std::vector<std::string>& keys);	/** Sorts songs by metadata fields */
 	
 	void add(const Song& song);						/** Adds Song to songlist */
 	void remove(const Song& song);					/** Removes Song from songlist */
+	unsigned int dedupe(SongIdentity identity = SongIdentity::Path, Occurrence keep = Occurrence::First);	/** Removes duplicate songs */
+
+	Playlist setUnion(const Playlist&, SongIdentity identity = SongIdentity::Path) const;				/** Songs in either playlist */
+	Playlist setIntersection(const Playlist&, SongIdentity identity = SongIdentity::Path) const;		/** Songs in both playlists */
+	Playlist setDifference(const Playlist&, SongIdentity identity = SongIdentity::Path) const;			/** Songs in this playlist but not in the other */
+	Playlist setSymmetricDifference(const Playlist&, SongIdentity identity = SongIdentity::Path) const;	/** Songs in exactly one of the playlists */
 	unsigned int getCount() noexcept;				/** Returns number of songs in the playlist */
-	void clear() noexcept;							/** Removes all songs from the playlist */
+	void clear();									/** Removes all songs from the playlist */
+	const Song& at(size_t position) const;			/** Returns song at given position */
+	void insertAt(size_t position, const Song&);	/** Inserts song at given position */
+	void eraseAt(size_t position);					/** Removes song at given position */
+	void move(size_t from, size_t to);				/** Moves song from a position to another */
+	unsigned int relocate(const PathRelocator&);	/** Rewrites paths of songs under moved directories */
+
+	void attach(const std::shared_ptr<PlaylistObserver>&);	/** Attaches an observer (e.g. an index) to the playlist */
+	void detach(const std::shared_ptr<PlaylistObserver>&);	/** Detaches a previously attached observer */
+
+	void publish();									/** Publishes current songs for snapshot readers */
+	PlaylistSnapshot snapshot() const;				/** Returns the latest published version, safe to call from any thread */
+
+	void useLibrary(const std::shared_ptr<Library>&);	/** Shares songs through a catalog with other playlists using it */
+	std::shared_ptr<Library> getLibrary() const noexcept;	/** Returns the catalog in use, nullptr if none */
+
+	void enableFilter(bool enabled = true);		/** Starts or stops keeping a bloom filter of song paths */
+	std::shared_ptr<const BloomFilter> getFilter();	/** Returns the up to date bloom filter, nullptr if disabled */
+
+	void enableHistory(bool enabled = true);		/** Starts or stops recording edits for undo and redo */
+	bool undo();									/** Reverts the latest edit */
+	bool redo();									/** Reapplies the latest reverted edit */
+	bool canUndo() const noexcept;					/** Tells if there is an edit to revert */
+	bool canRedo() const noexcept;					/** Tells if there is a reverted edit to reapply */
 
 	/**
 	 @fn			void Playlist::has(const T& song)
 
-	 @brief			Determines existance of specified song in playlist
+	 @brief			Determines existance of specified song in playlist.
+					With a filter enabled, songs not in the playlist are mostly ruled out without searching.
+					Concrete songs also match songs of other paths with equal metadata,
+					so the filter of paths can't rule them out.
 
 	 @param song	Reference to song to find from playlist
 
@@ -63,7 +152,14 @@ public:
 	// without losing the genericness
 	template <class T>
 	bool has(const T& song) {
-		for (auto it = songs.begin(); it != songs.end(); it++) {
+		if (filter && matchesByPath(song)) {
+			if (filter->isStale())
+				filter->reset(songs);
+			if (!filter->mayContain(song.getPathId()))
+				return false;
+		}
+
+		for (auto it = std::as_const(songs).begin(); it != std::as_const(songs).end(); it++) {
 			if (**it == song)
 				return true;
 		}
@@ -0,0 +1,679 @@
+/**
+ @file	PlaylistFingerprint.cpp.
+
+ @brief	Implements the playlist fingerprint class
+ */
+
+#include "PlaylistFingerprint.h"
+#include <limits>
+#include <unordered_set>
+
+// Initialize static members
+const uint64_t PlaylistFingerprint::base = 0x9e3779b97f4a7c15ull;
+const uint64_t PlaylistFingerprint::boundary_mask = 63;
+const size_t PlaylistFingerprint::max_piece = 256;
+const unsigned int PlaylistFingerprint::none = std::numeric_limits<unsigned int>::max();
+
+/**
+ @fn	PlaylistFingerprint::PlaylistFingerprint()
+
+ @brief	Default constructor. Songs are hashed when attached to a playlist.
+ */
+
+PlaylistFingerprint::PlaylistFingerprint() noexcept :
+	root(none),
+	seed(0x2545f4914f6cdd1dull)
+{
+
+}
+
+/**
+ @fn	PlaylistFingerprint::Digest PlaylistFingerprint::combine(const Digest& first, const Digest& second) noexcept
+
+ @brief	Returns the digest of two consecutive runs of songs. The hash is a polynomial of the
+		song hashes modulo 2^64, so shifting the first run by the length of the second joins them.
+
+ @param	first	Digest of the earlier songs
+		second	Digest of the later songs
+
+ @return	Digest of both runs
+ */
+
+PlaylistFingerprint::Digest PlaylistFingerprint::combine(const Digest& first, const Digest& second) noexcept {
+	return Digest{ first.hash * second.power + second.hash, first.power * second.power, first.count + second.count };
+}
+
+/**
+ @fn	PlaylistFingerprint::Digest PlaylistFingerprint::fold(const std::vector<uint64_t>& songs) noexcept
+
+ @brief	Returns the digest of a run of songs
+
+ @param	songs	Hashes of the songs
+
+ @return	The digest
+ */
+
+PlaylistFingerprint::Digest PlaylistFingerprint::fold(const std::vector<uint64_t>& songs) noexcept {
+
+	Digest digest{ 0, 1, songs.size() };
+	for (const uint64_t song : songs) {
+		digest.hash = digest.hash * base + song;
+		digest.power *= base;
+	}
+	return digest;
+}
+
+/**
+ @fn	bool PlaylistFingerprint::isBoundary(uint64_t song) noexcept
+
+ @brief	Tells if a song ends a chunk, one song in 64 on average
+
+ @param	song	Hash of the song
+
+ @return	TRUE if the song is the last of its chunk
+ */
+
+bool PlaylistFingerprint::isBoundary(uint64_t song) noexcept {
+	return (song & boundary_mask) == 0;
+}
+
+/**
+ @fn	uint64_t PlaylistFingerprint::hash(const Song& song)
+
+ @brief	Hashes the path of a song with FNV-1a and mixes the result.
+		The path itself is hashed rather than its id, as ids differ between processes.
+
+ @param	song	The song
+
+ @return	The hash
+ */
+
+uint64_t PlaylistFingerprint::hash(const Song& song) {
+
+	song.writePath(buffer);
+
+	uint64_t value = 14695981039346656037ull;
+	for (const char c : buffer) {
+		value ^= static_cast<unsigned char>(c);
+		value *= 1099511628211ull;
+	}
+
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	return value ^ (value >> 31);
+}
+
+/**
+ @fn	uint32_t PlaylistFingerprint::random() noexcept
+
+ @brief	Returns the next priority from a xorshift generator.
+		Priorities don't affect any hash, so a fixed seed will do.
+
+ @return	The priority
+ */
+
+uint32_t PlaylistFingerprint::random() noexcept {
+
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return static_cast<uint32_t>(seed >> 32);
+}
+
+/**
+ @fn	PlaylistFingerprint::Digest PlaylistFingerprint::totalOf(unsigned int piece) const noexcept
+
+ @brief	Returns the digest of a subtree
+
+ @param	piece	Root of the subtree, may be none
+
+ @return	Digest of all songs in the subtree, the empty digest for none
+ */
+
+PlaylistFingerprint::Digest PlaylistFingerprint::totalOf(unsigned int piece) const noexcept {
+	return (piece == none) ? Digest{ 0, 1, 0 } : pieces[piece].total;
+}
+
+/**
+ @fn	void PlaylistFingerprint::update(unsigned int piece) noexcept
+
+ @brief	Recomputes the digest of a subtree from the piece's own digest and its children's
+
+ @param	piece	The piece
+ */
+
+void PlaylistFingerprint::update(unsigned int piece) noexcept {
+
+	Piece& p = pieces[piece];
+	p.total = combine(combine(totalOf(p.left), p.digest), totalOf(p.right));
+}
+
+/**
+ @fn	void PlaylistFingerprint::split(unsigned int tree, size_t count, unsigned int& left, unsigned int& right) noexcept
+
+ @brief	Splits a tree in two. Pieces starting before song count go left, the rest right.
+		Callers split at the first song of a piece, so no piece is cut in two.
+
+ @param			tree	Root of the tree to split
+				count	Number of songs to split off
+ @param [out]	left	Root of the pieces starting before count
+ @param [out]	right	Root of the rest
+ */
+
+void PlaylistFingerprint::split(unsigned int tree, size_t count, unsigned int& left, unsigned int& right) noexcept {
+
+	if (tree == none) {
+		left = right = none;
+		return;
+	}
+
+	const size_t before = totalOf(pieces[tree].left).count;
+
+	if (before < count) {
+		const size_t through = before + pieces[tree].songs.size();
+		split(pieces[tree].right, (count > through) ? count - through : 0, pieces[tree].right, right);
+		left = tree;
+	}
+	else {
+		split(pieces[tree].left, count, left, pieces[tree].left);
+		right = tree;
+	}
+	update(tree);
+}
+
+/**
+ @fn	unsigned int PlaylistFingerprint::merge(unsigned int left, unsigned int right) noexcept
+
+ @brief	Joins two trees, pieces of left coming first. The piece of higher priority stays on top.
+
+ @param	left	Root of the earlier pieces
+		right	Root of the later pieces
+
+ @return	Root of the joined tree
+ */
+
+unsigned int PlaylistFingerprint::merge(unsigned int left, unsigned int right) noexcept {
+
+	if (left == none)
+		return right;
+	if (right == none)
+		return left;
+
+	if (pieces[left].priority > pieces[right].priority) {
+		pieces[left].right = merge(pieces[left].right, right);
+		update(left);
+		return left;
+	}
+
+	pieces[right].left = merge(left, pieces[right].left);
+	update(right);
+	return right;
+}
+
+/**
+ @fn	unsigned int PlaylistFingerprint::make(std::vector<uint64_t>&& songs)
+
+ @brief	Creates a piece of songs, not yet in the tree. Indexes of removed pieces are reused first.
+
+ @param	songs	Hashes of the songs of the piece
+
+ @return	Index of the piece
+ */
+
+unsigned int PlaylistFingerprint::make(std::vector<uint64_t>&& songs) {
+
+	unsigned int piece;
+	if (unused.empty()) {
+		piece = static_cast<unsigned int>(pieces.size());
+		pieces.emplace_back();
+	}
+	else {
+		piece = unused.back();
+		unused.pop_back();
+	}
+
+	Piece& p = pieces[piece];
+	p.songs = std::move(songs);
+	p.digest = fold(p.songs);
+	p.total = p.digest;
+	p.left = p.right = none;
+	p.priority = random();
+	return piece;
+}
+
+/**
+ @fn	void PlaylistFingerprint::place(size_t start, unsigned int piece)
+
+ @brief	Adds a piece to the tree in O(log n)
+
+ @param	start	Position of the piece's first song, the first song of another piece or the number of songs
+		piece	The piece, made with make()
+ */
+
+void PlaylistFingerprint::place(size_t start, unsigned int piece) {
+
+	unsigned int left;
+	unsigned int right;
+	split(root, start, left, right);
+	root = merge(merge(left, piece), right);
+}
+
+/**
+ @fn	void PlaylistFingerprint::remove(size_t start)
+
+ @brief	Removes a piece from the tree in O(log n) and frees it
+
+ @param	start	Position of the piece's first song. The piece must not be empty.
+ */
+
+void PlaylistFingerprint::remove(size_t start) {
+
+	unsigned int left;
+	unsigned int rest;
+	unsigned int piece;
+	unsigned int right;
+	split(root, start, left, rest);
+	split(rest, 1, piece, right);
+	root = merge(left, right);
+
+	std::vector<uint64_t>().swap(pieces[piece].songs);
+	unused.push_back(piece);
+}
+
+/**
+ @fn	void PlaylistFingerprint::fix(unsigned int piece) noexcept
+
+ @brief	Recomputes digests of a whole subtree, children first
+
+ @param	piece	Root of the subtree, may be none
+ */
+
+void PlaylistFingerprint::fix(unsigned int piece) noexcept {
+
+	if (piece == none)
+		return;
+
+	fix(pieces[piece].left);
+	fix(pieces[piece].right);
+	update(piece);
+}
+
+/**
+ @fn	void PlaylistFingerprint::rechunk(const std::vector<uint64_t>& songs)
+
+ @brief	Regroups all songs into pieces, each ending at a boundary song or after max_piece songs,
+		and builds the treap in O(n). Pieces are hung off a stack of the tree's right edge,
+		so no piece is placed by search.
+
+ @param	songs	Hashes of all songs in order
+ */
+
+void PlaylistFingerprint::rechunk(const std::vector<uint64_t>& songs) {
+
+	pieces.clear();
+	unused.clear();
+
+	std::vector<unsigned int> edge;
+	std::vector<uint64_t> current;
+
+	for (size_t i = 0; i < songs.size(); i++) {
+		current.push_back(songs[i]);
+		if (!isBoundary(songs[i]) && current.size() < max_piece && i + 1 < songs.size())
+			continue;
+
+		const unsigned int piece = make(std::move(current));
+		current = std::vector<uint64_t>();
+
+		unsigned int last = none;
+		while (!edge.empty() && pieces[edge.back()].priority < pieces[piece].priority) {
+			last = edge.back();
+			edge.pop_back();
+		}
+
+		pieces[piece].left = last;
+		if (!edge.empty())
+			pieces[edge.back()].right = piece;
+		edge.push_back(piece);
+	}
+
+	root = edge.empty() ? none : edge.front();
+	fix(root);
+}
+
+/**
+ @fn	std::vector<unsigned int> PlaylistFingerprint::list() const
+
+ @brief	Returns all pieces in order, walking the tree without recursion
+
+ @return	Indexes of the pieces by position
+ */
+
+std::vector<unsigned int> PlaylistFingerprint::list() const {
+
+	std::vector<unsigned int> result;
+	std::vector<unsigned int> path;
+	unsigned int piece = root;
+
+	while (piece != none || !path.empty()) {
+		while (piece != none) {
+			path.push_back(piece);
+			piece = pieces[piece].left;
+		}
+		piece = path.back();
+		path.pop_back();
+		result.push_back(piece);
+		piece = pieces[piece].right;
+	}
+	return result;
+}
+
+/**
+ @fn	std::pair<unsigned int, size_t> PlaylistFingerprint::locate(size_t position, std::vector<unsigned int>& path) const
+
+ @brief	Finds the piece holding a position by descending the tree by song counts, in O(log n)
+
+ @param			position	Position of a song, less than the number of songs
+ @param [out]	path		Pieces from the root down to the found one
+
+ @return	Index of the piece and offset of the song in it
+ */
+
+std::pair<unsigned int, size_t> PlaylistFingerprint::locate(size_t position, std::vector<unsigned int>& path) const {
+
+	path.clear();
+	unsigned int piece = root;
+
+	for (;;) {
+		path.push_back(piece);
+		const Piece& p = pieces[piece];
+		const size_t before = totalOf(p.left).count;
+
+		if (position < before) {
+			piece = p.left;
+		}
+		else if (position < before + p.songs.size()) {
+			return std::make_pair(piece, position - before);
+		}
+		else {
+			position -= before + p.songs.size();
+			piece = p.right;
+		}
+	}
+}
+
+/**
+ @fn	void PlaylistFingerprint::refresh(const std::vector<unsigned int>& path) noexcept
+
+ @brief	Recomputes the digest of the last piece of a path from its songs,
+		and the digests of the subtrees along the path up to the root
+
+ @param	path	Pieces from the root down to a changed piece
+ */
+
+void PlaylistFingerprint::refresh(const std::vector<unsigned int>& path) noexcept {
+
+	pieces[path.back()].digest = fold(pieces[path.back()].songs);
+	for (auto it = path.rbegin(); it != path.rend(); it++)
+		update(*it);
+}
+
+/**
+ @fn	void PlaylistFingerprint::insert(size_t position, uint64_t song)
+
+ @brief	Adds a song hash at position, in O(max_piece + log n). A boundary song ends its chunk,
+		so the rest of its piece becomes a new piece, and a piece grown past max_piece songs is halved.
+
+ @param	position	Position of the song
+		song		Hash of the song
+ */
+
+void PlaylistFingerprint::insert(size_t position, uint64_t song) {
+
+	const size_t count = getCount();
+	if (root == none) {
+		root = make({ song });
+		return;
+	}
+
+	// Songs appended after a boundary start a new piece
+	std::vector<unsigned int> path;
+	std::pair<unsigned int, size_t> at;
+	if (position == count) {
+		at = locate(count - 1, path);
+		if (isBoundary(pieces[at.first].songs.back())) {
+			place(count, make({ song }));
+			return;
+		}
+		at.second++;
+	}
+	else {
+		at = locate(position, path);
+	}
+
+	const size_t start = position - at.second;
+	std::vector<uint64_t>& songs = pieces[at.first].songs;
+	songs.insert(songs.begin() + at.second, song);
+
+	size_t cut = songs.size();
+	if (isBoundary(song) && at.second + 1 < songs.size())
+		cut = at.second + 1;
+	else if (songs.size() > max_piece)
+		cut = songs.size() / 2;
+
+	if (cut == songs.size()) {
+		refresh(path);
+		return;
+	}
+
+	std::vector<uint64_t> rest(songs.begin() + cut, songs.end());
+	songs.resize(cut);
+	refresh(path);
+	place(start + cut, make(std::move(rest)));
+}
+
+/**
+ @fn	void PlaylistFingerprint::erase(size_t position)
+
+ @brief	Removes the song hash at position, in O(max_piece + log n). Removing a boundary song
+		lets its chunk run on into the next one without moving any songs. A piece left with
+		few songs takes in the next piece of the same chunk if they fit in one, so pieces
+		don't dwindle, and an emptied piece is dropped.
+
+ @param	position	Position of the song
+ */
+
+void PlaylistFingerprint::erase(size_t position) {
+
+	std::vector<unsigned int> path;
+	const std::pair<unsigned int, size_t> at = locate(position, path);
+	const size_t start = position - at.second;
+
+	if (pieces[at.first].songs.size() == 1) {
+		remove(start);
+		return;
+	}
+
+	std::vector<uint64_t>& songs = pieces[at.first].songs;
+	songs.erase(songs.begin() + at.second);
+	refresh(path);
+
+	const size_t end = start + songs.size();
+	if (songs.size() * 4 >= max_piece || isBoundary(songs.back()) || end == getCount())
+		return;
+
+	std::vector<unsigned int> next_path;
+	const unsigned int next = locate(end, next_path).first;
+	if (songs.size() + pieces[next].songs.size() > max_piece)
+		return;
+
+	const std::vector<uint64_t> taken = pieces[next].songs;
+	remove(end);
+
+	locate(start, path);
+	std::vector<uint64_t>& joined = pieces[path.back()].songs;
+	joined.insert(joined.end(), taken.begin(), taken.end());
+	refresh(path);
+}
+
+/**
+ @fn	uint64_t PlaylistFingerprint::getHash() const noexcept
+
+ @brief	Returns the hash of the whole playlist in constant time
+
+ @return	The hash, 0 for an empty playlist
+ */
+
+uint64_t PlaylistFingerprint::getHash() const noexcept {
+	return totalOf(root).hash;
+}
+
+/**
+ @fn	size_t PlaylistFingerprint::getCount() const noexcept
+
+ @brief	Returns number of songs
+
+ @return	Number of songs hashed
+ */
+
+size_t PlaylistFingerprint::getCount() const noexcept {
+	return totalOf(root).count;
+}
+
+/**
+ @fn	std::vector<uint64_t> PlaylistFingerprint::getChunks() const
+
+ @brief	Returns hashes of the chunks in order, about one per 64 songs.
+		Digests of the pieces of a chunk are combined, so a chunk stored as several pieces
+		hashes the same as if it were one. Exchanging these tells where two versions
+		of a playlist differ without sending the songs.
+
+ @return	Hashes of the chunks
+ */
+
+std::vector<uint64_t> PlaylistFingerprint::getChunks() const {
+
+	std::vector<uint64_t> hashes;
+	Digest chunk{ 0, 1, 0 };
+
+	for (const unsigned int piece : list()) {
+		chunk = combine(chunk, pieces[piece].digest);
+		if (isBoundary(pieces[piece].songs.back())) {
+			hashes.push_back(chunk.hash);
+			chunk = Digest{ 0, 1, 0 };
+		}
+	}
+
+	if (chunk.count > 0)
+		hashes.push_back(chunk.hash);
+	return hashes;
+}
+
+/**
+ @fn	std::vector<size_t> PlaylistFingerprint::diff(const std::vector<uint64_t>& local, const std::vector<uint64_t>& remote)
+
+ @brief	Finds chunks the other side doesn't have. Chunks are cut by their contents,
+		so chunks an edit didn't touch are found on both sides even if they moved.
+
+ @param	local	Chunk hashes of this side
+		remote	Chunk hashes of the other side
+
+ @return	Ascending indices of local chunks missing from remote
+ */
+
+std::vector<size_t> PlaylistFingerprint::diff(const std::vector<uint64_t>& local, const std::vector<uint64_t>& remote) {
+
+	const std::unordered_set<uint64_t> known(remote.begin(), remote.end());
+	std::vector<size_t> missing;
+
+	for (size_t i = 0; i < local.size(); i++) {
+		if (known.find(local[i]) == known.end())
+			missing.push_back(i);
+	}
+	return missing;
+}
+
+/**
+ @fn	void PlaylistFingerprint::reset(const SongList& songs)
+
+ @brief	Rehashes all songs
+
+ @param	songs	Songs of the playlist
+ */
+
+void PlaylistFingerprint::reset(const SongList& songs) {
+
+	std::vector<uint64_t> hashes;
+	hashes.reserve(songs.size());
+	for (auto const& song : songs)
+		hashes.push_back(hash(*song));
+
+	rechunk(hashes);
+}
+
+/**
+ @fn	void PlaylistFingerprint::inserted(size_t position, const Song& song)
+
+ @brief	Hashes an inserted song
+
+ @param	position	Position of the song
+		song		The inserted song
+ */
+
+void PlaylistFingerprint::inserted(size_t position, const Song& song) {
+	insert(position, hash(song));
+}
+
+/**
+ @fn	void PlaylistFingerprint::erasing(const std::vector<size_t>& positions, const SongList& songs)
+
+ @brief	Drops songs about to be erased. Large removals regroup the remaining songs at once,
+		as their hashes are already known.
+
+ @param	positions	Ascending positions of the songs
+		songs		Songs of the playlist before erasing, unused
+ */
+
+void PlaylistFingerprint::erasing(const std::vector<size_t>& positions, const SongList&) {
+
+	if (positions.size() * 8 <= getCount()) {
+		for (auto it = positions.rbegin(); it != positions.rend(); ++it)
+			erase(*it);
+		return;
+	}
+
+	std::vector<uint64_t> remaining;
+	remaining.reserve(getCount() - positions.size());
+	size_t position = 0;
+	size_t next = 0;
+
+	for (const unsigned int piece : list()) {
+		for (const uint64_t song : pieces[piece].songs) {
+			if (next < positions.size() && positions[next] == position)
+				next++;
+			else
+				remaining.push_back(song);
+			position++;
+		}
+	}
+
+	rechunk(remaining);
+}
+
+/**
+ @fn	void PlaylistFingerprint::replaced(size_t position, const Song& before, const Song& after)
+
+ @brief	Rehashes a replaced song. Evaluating a song keeps its path, so only relocated songs change the hash.
+
+ @param	position	Position of the song
+		before		The song that was replaced
+		after		The song that replaced it
+ */
+
+void PlaylistFingerprint::replaced(size_t position, const Song& before, const Song& after) {
+
+	if (before.getPathId() == after.getPathId())
+		return;
+
+	erase(position);
+	insert(position, hash(after));
+}
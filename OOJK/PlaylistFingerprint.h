@@ -0,0 +1,87 @@
+/**
+ @file	PlaylistFingerprint.h.
+
+ @brief	Declares the playlist fingerprint class.
+		A content hash of a playlist's song paths in order, kept up to date as the playlist changes.
+		Songs are grouped into chunks ending at songs whose hash happens to end a chunk, so chunk
+		boundaries depend on the songs only and an edit changes the chunk around it alone.
+		Chunks are kept in a treap of pieces of at most max_piece songs, ordered by position, whose
+		nodes hold the digest of their subtree. A chunk longer than that, e.g. a long run of songs
+		without a boundary, is stored as several pieces, so an edit folds at most max_piece songs.
+		Splitting, merging or dropping chunks adds or removes a piece, and any edit updates
+		the hash of the whole playlist, in O(max_piece + log n).
+		Equal playlists have equal hashes whatever their edit history, also in other processes,
+		and comparing chunk hashes finds where two versions of a playlist differ.
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "PlaylistObserver.h"
+
+class PlaylistFingerprint : public PlaylistObserver {
+
+private:
+	/** Hash of a run of songs. Combining digests is associative, so it doesn't depend on how songs are grouped. */
+	struct Digest {
+		uint64_t hash;					/** Polynomial hash of the song hashes */
+		uint64_t power;					/** Base raised to the number of songs */
+		size_t count;					/** Number of songs */
+	};
+
+	/** Node of the treap, a run of songs within a chunk. Only the last song of a piece may end a chunk. */
+	struct Piece {
+		std::vector<uint64_t> songs;	/** Hashes of the songs */
+		Digest digest;					/** Digest of the songs */
+		Digest total;					/** Digest of the songs of the whole subtree */
+		unsigned int left;				/** Pieces before this one in its subtree */
+		unsigned int right;				/** Pieces after this one in its subtree */
+		uint32_t priority;				/** Random heap priority, keeps the tree balanced */
+	};
+
+	const static uint64_t base;			/** Base of the polynomial hash */
+	const static uint64_t boundary_mask;	/** Songs whose hash has these bits clear end a chunk */
+	const static size_t max_piece;		/** Most songs in a piece */
+	const static unsigned int none;		/** Marks a missing piece */
+
+	std::vector<Piece> pieces;			/** Pieces by index, erased ones are on the free list */
+	std::vector<unsigned int> unused;	/** Indexes of erased pieces, reused first */
+	unsigned int root;					/** Root of the treap */
+	uint64_t seed;						/** State of the priority generator */
+	std::string buffer;					/** Reused for decoding paths */
+
+	static Digest combine(const Digest&, const Digest&) noexcept;	/** Returns the digest of two consecutive runs */
+	static bool isBoundary(uint64_t song) noexcept;				/** Tells if a song ends a chunk */
+	uint64_t hash(const Song& song);							/** Hashes the path of a song */
+	static Digest fold(const std::vector<uint64_t>& songs) noexcept;	/** Returns the digest of a run of songs */
+	uint32_t random() noexcept;									/** Returns the next priority */
+	Digest totalOf(unsigned int piece) const noexcept;			/** Returns digest of a subtree, empty for none */
+	void update(unsigned int piece) noexcept;					/** Recomputes digests of a piece from its songs and children */
+	void split(unsigned int tree, size_t count, unsigned int& left, unsigned int& right) noexcept;	/** Splits off the pieces starting within the first count songs */
+	unsigned int merge(unsigned int left, unsigned int right) noexcept;	/** Joins two trees, left pieces first */
+	unsigned int make(std::vector<uint64_t>&& songs);			/** Creates a piece outside the tree */
+	void place(size_t start, unsigned int piece);				/** Adds a piece to the tree, its first song at start */
+	void remove(size_t start);									/** Removes the piece whose first song is at start */
+	void fix(unsigned int piece) noexcept;						/** Recomputes digests of a whole subtree */
+	void rechunk(const std::vector<uint64_t>& songs);			/** Regroups all songs into pieces */
+	std::vector<unsigned int> list() const;						/** Returns all pieces in order */
+	std::pair<unsigned int, size_t> locate(size_t position, std::vector<unsigned int>& path) const;	/** Finds piece and offset holding a position */
+	void refresh(const std::vector<unsigned int>& path) noexcept;	/** Recomputes digests along a path from the root */
+	void insert(size_t position, uint64_t song);				/** Adds a song hash at position */
+	void erase(size_t position);								/** Removes the song hash at position */
+
+public:
+	PlaylistFingerprint() noexcept;						/** Default constructor */
+
+	uint64_t getHash() const noexcept;					/** Returns the hash of the whole playlist */
+	size_t getCount() const noexcept;					/** Returns number of songs */
+	std::vector<uint64_t> getChunks() const;			/** Returns hashes of the chunks in order */
+	static std::vector<size_t> diff(const std::vector<uint64_t>& local, const std::vector<uint64_t>& remote);	/** Returns chunks the other side doesn't have */
+
+	void reset(const SongList& songs) override;										/** Rehashes all songs */
+	void inserted(size_t position, const Song& song) override;						/** Hashes an inserted song */
+	void erasing(const std::vector<size_t>& positions, const SongList& songs) override;	/** Drops erased songs */
+	void replaced(size_t position, const Song& before, const Song& after) override;	/** Rehashes a replaced song if its path changed */
+};
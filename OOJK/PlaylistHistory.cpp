@@ -0,0 +1,243 @@
+/**
+ @file	PlaylistHistory.cpp.
+
+ @brief	Implements the playlist history class
+ */
+
+#include "PlaylistHistory.h"
+
+/**
+ @fn	PlaylistHistory::Transaction::Transaction(PlaylistHistory* h)
+
+ @brief	Begins a step of edits
+
+ @param	h	History to record to, or nullptr when history is disabled
+ */
+
+PlaylistHistory::Transaction::Transaction(PlaylistHistory* h) : history(h) {
+
+	if (history)
+		history->depth++;
+}
+
+/**
+ @fn	PlaylistHistory::Transaction::~Transaction()
+
+ @brief	Commits the step, unless it's nested in another one or nothing was edited.
+		A new step makes undone steps impossible to redo.
+ */
+
+PlaylistHistory::Transaction::~Transaction() {
+
+	if (!history || --history->depth > 0 || history->current.empty())
+		return;
+
+	history->undos.push_back(std::move(history->current));
+	history->current.clear();
+	history->redos.clear();
+}
+
+/**
+ @fn	PlaylistHistory::PlaylistHistory()
+
+ @brief	Default constructor
+ */
+
+PlaylistHistory::PlaylistHistory() noexcept : depth(0), paused(false) {
+
+}
+
+/**
+ @fn	PlaylistHistory::Edit& PlaylistHistory::record(Edit::Type type)
+
+ @brief	Starts a new edit in the current step
+
+ @param	type	Kind of the edit
+
+ @return	Reference to the edit to fill in
+ */
+
+PlaylistHistory::Edit& PlaylistHistory::record(Edit::Type type) {
+	current.push_back(Edit{ type, {}, {}, SongList() });
+	return current.back();
+}
+
+/**
+ @fn	void PlaylistHistory::recordInsert(size_t position, const SongElement& song)
+
+ @brief	Records an inserted song.
+		Inserts after the previous one in the same step extend the previous edit,
+		so loading a playlist takes one edit instead of one per song.
+
+ @param	position	Position the song was inserted at
+		song		The inserted song
+ */
+
+void PlaylistHistory::recordInsert(size_t position, const SongElement& song) {
+
+	if (!isRecording())
+		return;
+
+	if (current.empty() || current.back().type != Edit::Type::Insert || current.back().positions.back() >= position)
+		record(Edit::Type::Insert);
+
+	current.back().positions.push_back(position);
+	current.back().songs.push_back(song);
+}
+
+/**
+ @fn	void PlaylistHistory::recordErase(const std::vector<size_t>& positions, std::vector<SongElement>&& songs)
+
+ @brief	Records erased songs
+
+ @param	positions	Ascending positions the songs were erased from
+		songs		The erased songs, in the same order
+ */
+
+void PlaylistHistory::recordErase(const std::vector<size_t>& positions, std::vector<SongElement>&& songs) {
+
+	if (!isRecording())
+		return;
+
+	Edit& edit = record(Edit::Type::Erase);
+	edit.positions = positions;
+	edit.songs = std::move(songs);
+}
+
+/**
+ @fn	void PlaylistHistory::recordReplace(size_t position, const SongElement& before)
+
+ @brief	Records a replaced song, e.g. an evaluated one
+
+ @param	position	Position of the replaced song
+		before		The song that was replaced
+ */
+
+void PlaylistHistory::recordReplace(size_t position, const SongElement& before) {
+
+	if (!isRecording())
+		return;
+
+	Edit& edit = record(Edit::Type::Replace);
+	edit.positions.push_back(position);
+	edit.songs.push_back(before);
+}
+
+/**
+ @fn	void PlaylistHistory::recordReset(SongList&& before)
+
+ @brief	Records replacing all songs at once, e.g. by sorting.
+		Only the song pointers are kept, the songs themselves are shared.
+
+ @param	before	Songs before the change
+ */
+
+void PlaylistHistory::recordReset(SongList&& before) {
+
+	if (!isRecording())
+		return;
+
+	record(Edit::Type::Reset).list = std::move(before);
+}
+
+/**
+ @fn	bool PlaylistHistory::isRecording() const noexcept
+
+ @brief	Tells if edits are being recorded, i.e. a transaction is open and history isn't paused
+ */
+
+bool PlaylistHistory::isRecording() const noexcept {
+	return depth > 0 && !paused;
+}
+
+/**
+ @fn	bool PlaylistHistory::canUndo() const noexcept
+
+ @brief	Tells if there is a step to undo
+ */
+
+bool PlaylistHistory::canUndo() const noexcept {
+	return !undos.empty();
+}
+
+/**
+ @fn	bool PlaylistHistory::canRedo() const noexcept
+
+ @brief	Tells if there is an undone step to redo
+ */
+
+bool PlaylistHistory::canRedo() const noexcept {
+	return !redos.empty();
+}
+
+/**
+ @fn	PlaylistHistory::Step PlaylistHistory::popUndo()
+
+ @brief	Takes the latest step to undo
+
+ @return	The step, empty if there is nothing to undo
+ */
+
+PlaylistHistory::Step PlaylistHistory::popUndo() {
+
+	if (undos.empty())
+		return Step();
+
+	Step step = std::move(undos.back());
+	undos.pop_back();
+	return step;
+}
+
+/**
+ @fn	PlaylistHistory::Step PlaylistHistory::popRedo()
+
+ @brief	Takes the latest undone step to redo
+
+ @return	The step, empty if there is nothing to redo
+ */
+
+PlaylistHistory::Step PlaylistHistory::popRedo() {
+
+	if (redos.empty())
+		return Step();
+
+	Step step = std::move(redos.back());
+	redos.pop_back();
+	return step;
+}
+
+/**
+ @fn	void PlaylistHistory::pushUndo(Step&& step)
+
+ @brief	Stores a redone step, so it can be undone again
+
+ @param	step	The inverted step
+ */
+
+void PlaylistHistory::pushUndo(Step&& step) {
+	undos.push_back(std::move(step));
+}
+
+/**
+ @fn	void PlaylistHistory::pushRedo(Step&& step)
+
+ @brief	Stores an undone step, so it can be redone
+
+ @param	step	The inverted step
+ */
+
+void PlaylistHistory::pushRedo(Step&& step) {
+	redos.push_back(std::move(step));
+}
+
+/**
+ @fn	void PlaylistHistory::pause(bool p) noexcept
+
+ @brief	Stops or resumes recording
+
+ @param	p	True to stop recording, false to resume
+ */
+
+void PlaylistHistory::pause(bool p) noexcept {
+	paused = p;
+}
@@ -0,0 +1,70 @@
+/**
+ @file	PlaylistHistory.h.
+
+ @brief	Declares the playlist history class.
+		Records edits of a Playlist as a log of small operations, so they can be undone and redone.
+		Songs are immutable and shared, so an entry only holds pointers to the songs it touched
+		and memory grows with the size of the edits, not with the size of the playlist.
+ */
+
+#pragma once
+#include <vector>
+#include "SongList.h"
+
+class PlaylistHistory {
+
+public:
+	/**
+	 Single recorded change. Each edit knows how to be turned into its own inverse:
+	 an insert becomes an erase of the same songs and vice versa,
+	 a replace or reset swaps the stored songs with those in the playlist.
+	 */
+	struct Edit {
+		enum class Type { Insert, Erase, Replace, Reset };
+
+		Type type;							/** Kind of change */
+		std::vector<size_t> positions;		/** Ascending positions of inserted/erased songs, or the replaced position */
+		std::vector<SongElement> songs;		/** Inserted/erased songs, or the song replaced */
+		SongList list;						/** Songs before a reset */
+	};
+
+	typedef std::vector<Edit> Step;		/** Edits made by one call to the playlist, undone together */
+
+	/** Groups edits made during its lifetime into a single step. Steps may nest, the outermost one counts. */
+	class Transaction {
+	private:
+		PlaylistHistory* history;	/** History to record to, or nullptr when history is disabled */
+
+	public:
+		explicit Transaction(PlaylistHistory* h);	/** Begins a step */
+		~Transaction();								/** Commits the step */
+		Transaction(const Transaction&) = delete;
+		Transaction& operator=(const Transaction&) = delete;
+	};
+
+private:
+	std::vector<Step> undos;	/** Steps that can be undone, latest last */
+	std::vector<Step> redos;	/** Undone steps that can be redone, latest last */
+	Step current;				/** Step being recorded */
+	unsigned int depth;			/** Nesting depth of open transactions */
+	bool paused;				/** True while undoing or redoing, so those aren't recorded */
+
+	Edit& record(Edit::Type type);	/** Starts a new edit in the current step */
+
+public:
+	PlaylistHistory() noexcept;		/** Default constructor */
+
+	void recordInsert(size_t position, const SongElement& song);								/** Records an inserted song */
+	void recordErase(const std::vector<size_t>& positions, std::vector<SongElement>&& songs);	/** Records erased songs */
+	void recordReplace(size_t position, const SongElement& before);							/** Records a replaced song */
+	void recordReset(SongList&& before);														/** Records replacing all songs */
+
+	bool isRecording() const noexcept;		/** Tells if edits are being recorded */
+	bool canUndo() const noexcept;			/** Tells if there is something to undo */
+	bool canRedo() const noexcept;			/** Tells if there is something to redo */
+	Step popUndo();							/** Takes the latest step to undo */
+	Step popRedo();							/** Takes the latest step to redo */
+	void pushUndo(Step&& step);				/** Stores a redone step so it can be undone again */
+	void pushRedo(Step&& step);				/** Stores an undone step so it can be redone */
+	void pause(bool paused) noexcept;		/** Stops or resumes recording */
+};
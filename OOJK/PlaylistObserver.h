@@ -0,0 +1,21 @@
+/**
+ @file	PlaylistObserver.h.
+
+ @brief	Declares the playlist observer interface.
+		Secondary structures (indexes, filters, fingerprints) implement this interface
+		and get attached to a Playlist, which then keeps them up to date on every change.
+ */
+
+#pragma once
+#include <vector>
+#include "SongList.h"
+
+class PlaylistObserver {
+
+public:
+	virtual ~PlaylistObserver() = default;														/** Use default destructor */
+	virtual void reset(const SongList& songs) = 0;												/** Called after the whole song list was replaced */
+	virtual void inserted(size_t position, const Song& song) = 0;								/** Called after a song was inserted at position */
+	virtual void erasing(const std::vector<size_t>& positions, const SongList& songs) = 0;		/** Called before songs at ascending positions are removed */
+	virtual void replaced(size_t position, const Song& before, const Song& after) = 0;			/** Called after the song at position was replaced (e.g. evaluated) */
+};
@@ -0,0 +1,371 @@
+/**
+ @file	PlaylistPatch.cpp.
+
+ @brief	Implements the playlist patch class
+ */
+
+#include "PlaylistPatch.h"
+#include "Playlist.h"
+#include "SongSet.h"
+#include "EntryOrder.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+/**
+ @fn	std::ostream& operator<<(std::ostream& os, const PlaylistPatch& patch)
+
+ @brief	Writes the patch, one operation per line:
+		"+position song" inserts a song, "-position count" erases songs
+		and ">position target" moves a song.
+
+ @param		os		Reference to output stream to write patch to.
+			patch	Reference to patch to write.
+
+ @return	Reference to the output stream
+ */
+
+std::ostream& operator<<(std::ostream& os, const PlaylistPatch& patch) {
+
+	for (auto const& op : patch.operations) {
+		os << op.type << op.position << ' ';
+		if (op.type == '+')
+			os << op.song;
+		else
+			os << op.argument;
+		os << '\n';
+	}
+
+	return os;
+}
+
+/**
+ @fn	std::istream& operator>>(std::istream& is, PlaylistPatch& patch)
+
+ @brief	Reads a patch written by operator<<
+
+ @param		is		Reference to input stream to parse.
+			patch	Reference to patch to read operations to.
+
+ @return	Reference to the input stream
+
+ @throws	std::runtime_error if a line is not a valid operation
+ */
+
+std::istream& operator>>(std::istream& is, PlaylistPatch& patch) {
+
+	std::string line;
+	while (std::getline(is, line)) {
+
+		if (line.empty())
+			continue;
+
+		PlaylistPatch::Operation op{ line[0], 0, 0, std::string() };
+		std::istringstream fields(line.substr(1));
+
+		if (!(fields >> op.position) || fields.get() != ' ')
+			throw std::runtime_error("Invalid playlist patch");
+
+		if (op.type == '+')
+			std::getline(fields, op.song);
+		else if ((op.type != '-' && op.type != '>') || !(fields >> op.argument))
+			throw std::runtime_error("Invalid playlist patch");
+
+		patch.operations.push_back(std::move(op));
+	}
+
+	return is;
+}
+
+/**
+ @fn	PlaylistPatch PlaylistPatch::diff(const Playlist& from, const Playlist& to, size_t max_edits)
+
+ @brief	Computes a patch turning playlist from into playlist to.
+		Songs are identified by their path id and, for evaluated songs, their metadata,
+		interned to integers. Only inserted songs are printed, for the patch text.
+		After trimming the common head and tail, Myers' O((N+M)D) algorithm finds the
+		shortest script of erases and inserts. An erased song that is inserted elsewhere
+		becomes a move, so reordering doesn't resend the song.
+		If more than max_edits edits are needed, the middle part is replaced as a whole.
+
+ @param	from		Playlist the patch applies to
+		to			Playlist the patch produces
+		max_edits	Largest edit script searched for, bounds time and memory use
+
+ @return	The patch
+ */
+
+PlaylistPatch PlaylistPatch::diff(const Playlist& from, const Playlist& to, size_t max_edits) {
+
+	// Identify songs by interned path and metadata, songs with equal ids print the same
+	struct Key {
+		PathStore::Id path;
+		std::shared_ptr<MetaContainer> metadata;	// nullptr for songs that aren't evaluated
+
+		bool operator==(const Key& other) const {
+			return path == other.path && (metadata == other.metadata || (metadata && other.metadata && *metadata == *other.metadata));
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const noexcept {
+			const size_t h = std::hash<PathStore::Id>()(key.path);
+			return key.metadata ? h ^ (SongSet::hash(*key.metadata) + 0x9e3779b9 + (h << 6) + (h >> 2)) : h;
+		}
+	};
+
+	std::unordered_map<Key, int, KeyHash> ids;
+	std::vector<const Song*> representatives;
+
+	auto intern = [&](const SongList& list) {
+		std::vector<int> result;
+		result.reserve(list.size());
+		for (auto const& song : list) {
+			Key key{ song->getPathId(), song->isEvaluated() ? song->evaluate() : nullptr };
+			auto it = ids.emplace(std::move(key), static_cast<int>(representatives.size()));
+			if (it.second)
+				representatives.push_back(song.get());
+			result.push_back(it.first->second);
+		}
+		return result;
+	};
+
+	const std::vector<int> a_all = intern(from.songs);
+	const std::vector<int> b_all = intern(to.songs);
+
+	// Trim common head and tail
+	size_t head = 0;
+	while (head < a_all.size() && head < b_all.size() && a_all[head] == b_all[head])
+		head++;
+
+	size_t tail = 0;
+	while (tail < a_all.size() - head && tail < b_all.size() - head && a_all[a_all.size() - 1 - tail] == b_all[b_all.size() - 1 - tail])
+		tail++;
+
+	const std::vector<int> a(a_all.begin() + head, a_all.end() - tail);
+	const std::vector<int> b(b_all.begin() + head, b_all.end() - tail);
+	const int n = static_cast<int>(a.size());
+	const int m = static_cast<int>(b.size());
+
+	std::vector<bool> erased(n, true);
+	std::vector<bool> inserted(m, true);
+	std::vector<int> kept_from(m, -1);
+
+	// Myers' greedy search. trace[d] keeps furthest reaching x of diagonals -d..d after d edits.
+	const int limit = static_cast<int>(std::min<size_t>(max_edits, static_cast<size_t>(n + m)));
+	std::vector<int> v(2 * static_cast<size_t>(limit) + 3, 0);
+	const int offset = limit + 1;
+	std::vector<std::vector<int>> trace;
+	int found = -1;
+
+	for (int d = 0; d <= limit && found < 0; d++) {
+		for (int k = -d; k <= d; k += 2) {
+			int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1] : v[offset + k - 1] + 1;
+			int y = x - k;
+			while (x < n && y < m && a[x] == b[y]) {
+				x++;
+				y++;
+			}
+			v[offset + k] = x;
+			if (x >= n && y >= m)
+				found = d;
+		}
+		trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+	}
+
+	// Walk back the edit path, marking the songs that stay
+	if (found >= 0) {
+		int x = n;
+		int y = m;
+		for (int d = found; d >= 0; d--) {
+			const int k = x - y;
+			int prev_x = 0;
+			int prev_y = 0;
+
+			if (d > 0) {
+				const std::vector<int>& prev = trace[d - 1];
+				const bool down = (k == -d || (k != d && prev[k - 1 + d - 1] < prev[k + 1 + d - 1]));
+				const int prev_k = down ? k + 1 : k - 1;
+				prev_x = prev[prev_k + d - 1];
+				prev_y = prev_x - prev_k;
+
+				const int start_x = down ? prev_x : prev_x + 1;
+				for (int i = start_x; i < x; i++) {
+					erased[i] = false;
+					inserted[i - k] = false;
+					kept_from[i - k] = i;
+				}
+
+				if (down)
+					inserted[prev_y] = true;
+				else
+					erased[prev_x] = true;
+			}
+			else {
+				for (int i = 0; i < x; i++) {
+					erased[i] = false;
+					inserted[i] = false;
+					kept_from[i] = i;
+				}
+			}
+
+			x = prev_x;
+			y = prev_y;
+		}
+	}
+
+	// Pair erased and inserted copies of a song into moves. Not done for a
+	// wholesale replacement, which would turn into a costly shuffle.
+	std::unordered_multimap<int, int> erased_at;
+	for (int i = n - 1; i >= 0 && found >= 0; i--) {
+		if (erased[i])
+			erased_at.emplace(a[i], i);
+	}
+
+	std::vector<int> moved_from(m, -1);
+	std::vector<bool> moved(n, false);
+	for (int j = 0; j < m; j++) {
+		auto it = inserted[j] ? erased_at.find(b[j]) : erased_at.end();
+		if (it != erased_at.end()) {
+			moved_from[j] = it->second;
+			moved[it->second] = true;
+			erased_at.erase(it);
+		}
+	}
+
+	PlaylistPatch patch;
+
+	// Erase from the back, so earlier positions stay valid. Neighbouring songs go in one operation.
+	for (int i = n - 1; i >= 0;) {
+		if (!erased[i] || moved[i]) {
+			i--;
+			continue;
+		}
+		int first = i;
+		while (first > 0 && erased[first - 1] && !moved[first - 1])
+			first--;
+		patch.operations.push_back(Operation{ '-', head + first, static_cast<size_t>(i - first + 1), std::string() });
+		i = first - 1;
+	}
+
+	// Each moved song goes right before its anchor, the next song in the target that stays in place.
+	// Kept songs are already in target order, so placing moved songs in target order
+	// before their anchors leaves everything but the new songs in target order.
+	std::vector<int> anchors(m, -1);
+	for (int j = m - 2; j >= 0; j--)
+		anchors[j] = (kept_from[j + 1] >= 0) ? kept_from[j + 1] : anchors[j + 1];
+
+	// Simulate the remaining middle part to find current positions of moved songs and anchors,
+	// in O(log n) per move. Entries are the songs left after erasing, by index in from.
+	std::vector<EntryOrder::Id> entries(n, 0);
+	EntryOrder::Id remaining = 0;
+	for (int i = 0; i < n; i++) {
+		if (!erased[i] || moved[i])
+			entries[i] = remaining++;
+	}
+
+	EntryOrder current;
+	current.reset(remaining);
+
+	for (int j = 0; j < m; j++) {
+		if (moved_from[j] < 0)
+			continue;
+
+		const size_t position = current.position(entries[moved_from[j]]);
+		current.erase({ position });
+
+		const int anchor = anchors[j];
+		const size_t target = (anchor < 0) ? current.size() : current.position(entries[anchor]);
+		entries[moved_from[j]] = current.insert(target);
+
+		if (position != target)
+			patch.operations.push_back(Operation{ '>', head + position, head + target, std::string() });
+	}
+
+	// Remaining songs are in target order, new songs can go straight to their final positions
+	for (int j = 0; j < m; j++) {
+		if (inserted[j] && moved_from[j] < 0) {
+			std::ostringstream line;
+			line << *representatives[b[j]];
+			patch.operations.push_back(Operation{ '+', head + j, 0, line.str() });
+		}
+	}
+
+	return patch;
+}
+
+/**
+ @fn	void PlaylistPatch::apply(Playlist& playlist) const
+
+ @brief	Applies the patch to a playlist in place.
+		Every operation is checked against the playlist before any of them is applied,
+		so a patch that doesn't fit leaves the playlist untouched.
+		Observers of the playlist are notified of every change, and the whole patch is undone at once.
+		Inserted songs come from the playlist's library if it uses one.
+
+ @param [in,out]	playlist	Playlist to patch, should equal the one the patch was made from
+
+ @throws	std::runtime_error if the patch doesn't fit the playlist
+ */
+
+void PlaylistPatch::apply(Playlist& playlist) const {
+
+	// Operations are checked against the number of songs the earlier ones leave
+	std::vector<SongElement> inserted;
+	size_t count = playlist.songs.size();
+
+	for (auto const& op : operations) {
+
+		bool fits;
+		if (op.type == '+') {
+			inserted.push_back(Playlist::parseSong(op.song));
+			fits = inserted.back() && op.position <= count;
+			count++;
+		}
+		else if (op.type == '-') {
+			fits = op.position <= count && op.argument <= count - op.position;
+			count -= fits ? op.argument : 0;
+		}
+		else {
+			fits = op.position < count && op.argument < count;
+		}
+
+		if (!fits)
+			throw std::runtime_error("Playlist patch doesn't fit the playlist");
+	}
+
+	auto step = playlist.transaction();
+	auto next = inserted.begin();
+
+	for (auto const& op : operations) {
+
+		if (op.type == '+') {
+			playlist.insert(op.position, playlist.share(std::move(*next++)));
+		}
+		else if (op.type == '-') {
+			std::vector<size_t> positions(op.argument);
+			for (size_t i = 0; i < op.argument; i++)
+				positions[i] = op.position + i;
+
+			playlist.erase(positions);
+		}
+		else {
+			SongElement song = playlist.songs[op.position];
+			playlist.erase({ op.position });
+			playlist.insert(op.argument, song);
+		}
+	}
+}
+
+/**
+ @fn	unsigned int PlaylistPatch::getCount() const noexcept
+
+ @brief	Returns number of operations in the patch
+
+ @return	Number of operations, zero if the playlists were equal
+ */
+
+unsigned int PlaylistPatch::getCount() const noexcept {
+	return static_cast<unsigned int>(operations.size());
+}
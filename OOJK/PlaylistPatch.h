@@ -0,0 +1,38 @@
+/**
+ @file	PlaylistPatch.h.
+
+ @brief	Declares the playlist patch class.
+		A patch is an edit script of inserts, erases and moves turning one version
+		of a playlist into another. Sending a patch instead of the whole playlist
+		keeps synchronization cost proportional to the size of the change.
+ */
+
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+
+class Playlist;
+
+class PlaylistPatch {
+
+	friend std::ostream& operator<<(std::ostream&, const PlaylistPatch&);	/** Writes the patch in its text format */
+	friend std::istream& operator>>(std::istream&, PlaylistPatch&);		/** Reads a patch from its text format */
+
+private:
+	/** Single step of the edit script. Positions refer to the playlist as left by the previous steps. */
+	struct Operation {
+		char type;				/** '+' inserts song at position, '-' erases count songs at position, '>' moves song at position to target */
+		size_t position;		/** Position the operation applies to */
+		size_t argument;		/** Number of erased songs, or target position of a move */
+		std::string song;		/** Printed representation of an inserted song */
+	};
+
+	std::vector<Operation> operations;	/** The edit script, in order of application */
+
+public:
+	static PlaylistPatch diff(const Playlist& from, const Playlist& to, size_t max_edits = 1024);	/** Computes a patch turning from into to */
+
+	void apply(Playlist&) const;				/** Applies the patch to a playlist in place */
+	unsigned int getCount() const noexcept;		/** Returns number of operations in the patch */
+};
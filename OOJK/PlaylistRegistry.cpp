@@ -0,0 +1,312 @@
+/**
+ @file	PlaylistRegistry.cpp.
+
+ @brief	Implements the playlist registry class
+ */
+
+#include "PlaylistRegistry.h"
+#include <stdexcept>
+#include <utility>
+
+/**
+ @fn	PlaylistRegistry::Tracker::Tracker(PlaylistIndex& i, Id p)
+
+ @brief	Construction using the index to maintain and the playlist's id
+
+ @param	i	Reverse index of the registry
+		p	Id of the tracked playlist
+ */
+
+PlaylistRegistry::Tracker::Tracker(PlaylistIndex& i, Id p) :
+	index(i),
+	id(p)
+{
+
+}
+
+/**
+ @fn	void PlaylistRegistry::Tracker::add(const Song& song)
+
+ @brief	Counts a song. The playlist is listed for the song's path when it's the first such song.
+
+ @param	song	The song added to the playlist
+ */
+
+void PlaylistRegistry::Tracker::add(const Song& song) {
+
+	if (++counts[song.getPathId()] == 1)
+		Postings::insert(index[song.getPathId()], id);
+}
+
+/**
+ @fn	void PlaylistRegistry::Tracker::drop(const Song& song)
+
+ @brief	Uncounts a song. The playlist is unlisted for the song's path when it was the last such song,
+		and paths left without playlists are dropped from the index.
+
+ @param	song	The song leaving the playlist
+ */
+
+void PlaylistRegistry::Tracker::drop(const Song& song) {
+
+	auto it = counts.find(song.getPathId());
+	if (it == counts.end() || --it->second > 0)
+		return;
+
+	counts.erase(it);
+
+	auto listed = index.find(song.getPathId());
+	if (listed == index.end())
+		return;
+
+	Postings::erase(listed->second, id);
+	if (listed->second.empty())
+		index.erase(listed);
+}
+
+/**
+ @fn	void PlaylistRegistry::Tracker::clear()
+
+ @brief	Unlists the playlist for all paths it contains
+ */
+
+void PlaylistRegistry::Tracker::clear() {
+
+	for (const auto& counted : counts) {
+		auto listed = index.find(counted.first);
+		if (listed == index.end())
+			continue;
+
+		Postings::erase(listed->second, id);
+		if (listed->second.empty())
+			index.erase(listed);
+	}
+
+	counts.clear();
+}
+
+/**
+ @fn	void PlaylistRegistry::Tracker::reset(const SongList& songs)
+
+ @brief	Recounts all songs of the playlist
+
+ @param	songs	Songs of the playlist
+ */
+
+void PlaylistRegistry::Tracker::reset(const SongList& songs) {
+
+	clear();
+	for (const auto& song : songs)
+		add(*song);
+}
+
+/**
+ @fn	void PlaylistRegistry::Tracker::inserted(size_t position, const Song& song)
+
+ @brief	Counts an inserted song
+
+ @param	position	Position of the song, unused as the index doesn't track positions
+		song		The inserted song
+ */
+
+void PlaylistRegistry::Tracker::inserted(size_t, const Song& song) {
+	add(song);
+}
+
+/**
+ @fn	void PlaylistRegistry::Tracker::erasing(const std::vector<size_t>& positions, const SongList& songs)
+
+ @brief	Uncounts songs about to be erased
+
+ @param	positions	Ascending positions of the songs
+		songs		Songs of the playlist before erasing
+ */
+
+void PlaylistRegistry::Tracker::erasing(const std::vector<size_t>& positions, const SongList& songs) {
+
+	for (const size_t position : positions)
+		drop(*songs[position]);
+}
+
+/**
+ @fn	void PlaylistRegistry::Tracker::replaced(size_t position, const Song& before, const Song& after)
+
+ @brief	Recounts a replaced song. Evaluating a song keeps its path, so only relocated songs change the index.
+
+ @param	position	Position of the song, unused
+		before		The song that was replaced
+		after		The song that replaced it
+ */
+
+void PlaylistRegistry::Tracker::replaced(size_t, const Song& before, const Song& after) {
+
+	if (before.getPathId() == after.getPathId())
+		return;
+
+	add(after);
+	drop(before);
+}
+
+/**
+ @fn	PlaylistRegistry::PlaylistRegistry()
+
+ @brief	Default constructor
+ */
+
+PlaylistRegistry::PlaylistRegistry() noexcept :
+	count(0)
+{
+
+}
+
+/**
+ @fn	PlaylistRegistry::Entry& PlaylistRegistry::entry(Id id)
+
+ @brief	Returns the entry of a registered playlist
+
+ @param	id	Id of the playlist
+
+ @return	The entry
+
+ @throws std::out_of_range if no playlist is registered with the id
+ */
+
+PlaylistRegistry::Entry& PlaylistRegistry::entry(Id id) {
+
+	if (id >= entries.size() || !entries[id].playlist)
+		throw std::out_of_range("Playlist is not registered");
+
+	return entries[id];
+}
+
+/**
+ @fn	PlaylistRegistry::Id PlaylistRegistry::add(Playlist&& playlist)
+
+ @brief	Takes a playlist into the registry and indexes its songs.
+		The registry owns the playlist, so it can't be moved away behind the index's back.
+
+ @param [in,out]	playlist	Playlist to move into the registry
+
+ @return	Id of the registered playlist
+ */
+
+PlaylistRegistry::Id PlaylistRegistry::add(Playlist&& playlist) {
+
+	const Id id = static_cast<Id>(entries.size());
+	Entry added{ std::make_unique<Playlist>(std::move(playlist)), std::make_shared<Tracker>(index, id) };
+
+	added.playlist->attach(added.tracker);
+	entries.push_back(std::move(added));
+	count++;
+
+	return id;
+}
+
+/**
+ @fn	Playlist& PlaylistRegistry::get(Id id)
+
+ @brief	Returns a registered playlist. Editing it keeps the index up to date,
+		but moving another playlist into it would take the index's observer away.
+
+ @param	id	Id of the playlist
+
+ @return	The playlist
+
+ @throws std::out_of_range if no playlist is registered with the id
+ */
+
+Playlist& PlaylistRegistry::get(Id id) {
+	return *entry(id).playlist;
+}
+
+/**
+ @fn	Playlist PlaylistRegistry::release(Id id)
+
+ @brief	Takes a playlist out of the registry and drops it from the index. Its id isn't reused.
+
+ @param	id	Id of the playlist
+
+ @return	The playlist
+
+ @throws std::out_of_range if no playlist is registered with the id
+ */
+
+Playlist PlaylistRegistry::release(Id id) {
+
+	Entry& released = entry(id);
+	released.playlist->detach(released.tracker);
+	released.tracker->clear();
+
+	Playlist playlist(std::move(*released.playlist));
+	released.playlist.reset();
+	released.tracker.reset();
+	count--;
+
+	return playlist;
+}
+
+/**
+ @fn	size_t PlaylistRegistry::getCount() const noexcept
+
+ @brief	Returns number of registered playlists
+
+ @return	Number of playlists added and not released
+ */
+
+size_t PlaylistRegistry::getCount() const noexcept {
+	return count;
+}
+
+/**
+ @fn	PostingList PlaylistRegistry::find(const Song& song) const
+
+ @brief	Returns ids of playlists containing a song, found by its path in constant time
+
+ @param	song	The song to look for
+
+ @return	Ascending ids of the playlists
+ */
+
+PostingList PlaylistRegistry::find(const Song& song) const {
+
+	auto it = index.find(song.getPathId());
+	return (it != index.end()) ? it->second : PostingList();
+}
+
+/**
+ @fn	unsigned int PlaylistRegistry::removeEverywhere(const Song& song)
+
+ @brief	Removes a song from every playlist containing it.
+		Only the playlists listed for the song's path are searched, and songs are matched
+		by path like find() does, so concrete songs with equal metadata elsewhere are kept.
+		Each playlist records the removal as one undoable step of its own.
+
+ @param	song	The song to remove
+
+ @return	Number of songs removed in total
+ */
+
+unsigned int PlaylistRegistry::removeEverywhere(const Song& song) {
+
+	// Removing songs unlists playlists, so the list is copied first
+	const PostingList listed = find(song);
+	unsigned int removed = 0;
+
+	for (const unsigned int id : listed) {
+		Playlist& playlist = *entries[id].playlist;
+		std::vector<size_t> positions;
+		size_t position = 0;
+
+		for (auto const& s : std::as_const(playlist.songs)) {
+			if (s->getPathId() == song.getPathId())
+				positions.push_back(position);
+			position++;
+		}
+
+		auto step = playlist.transaction();
+		playlist.erase(positions);
+		removed += static_cast<unsigned int>(positions.size());
+	}
+
+	return removed;
+}
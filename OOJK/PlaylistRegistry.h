@@ -0,0 +1,72 @@
+/**
+ @file	PlaylistRegistry.h.
+
+ @brief	Declares the playlist registry class.
+		Owns a collection of playlists and keeps a reverse index from each song's path
+		to the ascending ids of the playlists containing it. Finding the playlists of a track,
+		or removing a track from all of them, then touches only those playlists
+		instead of searching every playlist with has().
+ */
+
+#pragma once
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Playlist.h"
+#include "PlaylistObserver.h"
+#include "PostingList.h"
+
+class PlaylistRegistry {
+
+public:
+	typedef unsigned int Id;				/** Identifies a playlist in the registry, ids aren't reused */
+
+private:
+	typedef std::unordered_map<PathStore::Id, PostingList> PlaylistIndex;	/** Maps a path to ids of playlists containing it */
+
+	/** Keeps the reverse index up to date with one playlist */
+	class Tracker : public PlaylistObserver {
+
+	private:
+		PlaylistIndex& index;				/** Reverse index of the registry */
+		const Id id;						/** Id of the tracked playlist */
+		std::unordered_map<PathStore::Id, unsigned int> counts;	/** Number of songs per path in the playlist */
+
+		void add(const Song& song);			/** Counts a song, listing the playlist for a new path */
+		void drop(const Song& song);		/** Uncounts a song, unlisting the playlist for a path it no longer has */
+
+	public:
+		Tracker(PlaylistIndex& index, Id id);	/** Construction using the index to maintain and the playlist's id */
+
+		void clear();														/** Unlists the playlist for all its paths */
+		void reset(const SongList& songs) override;							/** Recounts all songs */
+		void inserted(size_t position, const Song& song) override;			/** Counts an inserted song */
+		void erasing(const std::vector<size_t>& positions, const SongList& songs) override;	/** Uncounts erased songs */
+		void replaced(size_t position, const Song& before, const Song& after) override;	/** Recounts a replaced song if its path changed */
+	};
+
+	/** A registered playlist and the observer tracking it */
+	struct Entry {
+		std::unique_ptr<Playlist> playlist;	/** The playlist, nullptr once released */
+		std::shared_ptr<Tracker> tracker;	/** Observer attached to the playlist */
+	};
+
+	std::vector<Entry> entries;				/** Registered playlists by id */
+	PlaylistIndex index;					/** Reverse index from paths to playlists */
+	size_t count;							/** Number of playlists not released */
+
+	Entry& entry(Id id);					/** Returns the entry of a registered playlist */
+
+public:
+	PlaylistRegistry() noexcept;							/** Default constructor */
+	PlaylistRegistry(const PlaylistRegistry&) = delete;		/** Trackers refer to the registry's index, so it isn't copied */
+	PlaylistRegistry& operator=(const PlaylistRegistry&) = delete;
+
+	Id add(Playlist&& playlist);							/** Takes a playlist into the registry */
+	Playlist& get(Id id);									/** Returns a registered playlist */
+	Playlist release(Id id);								/** Takes a playlist out of the registry */
+	size_t getCount() const noexcept;						/** Returns number of registered playlists */
+
+	PostingList find(const Song& song) const;				/** Returns ids of playlists containing a song */
+	unsigned int removeEverywhere(const Song& song);		/** Removes a song from every playlist containing it */
+};
@@ -0,0 +1,94 @@
+/**
+ @file	PlaylistSnapshot.cpp.
+
+ @brief	Implements the playlist snapshot class
+ */
+
+#include "PlaylistSnapshot.h"
+
+/**
+ @fn	PlaylistSnapshot::PlaylistSnapshot()
+
+ @brief	Constructs a snapshot of an empty playlist, e.g. one never published
+ */
+
+PlaylistSnapshot::PlaylistSnapshot() : songs(std::make_shared<const SongList>()) {
+
+}
+
+/**
+ @fn	PlaylistSnapshot::PlaylistSnapshot(std::shared_ptr<const SongList> s)
+
+ @brief	Constructs a snapshot of published songs
+
+ @param	s	The published songs, nullptr for an empty snapshot
+ */
+
+PlaylistSnapshot::PlaylistSnapshot(std::shared_ptr<const SongList> s) : 
+	songs(s ? std::move(s) : std::make_shared<const SongList>())
+{
+
+}
+
+/**
+ @fn	unsigned int PlaylistSnapshot::getCount() const noexcept
+
+ @brief	Returns number of songs in the snapshot
+
+ @return	Number of songs
+ */
+
+unsigned int PlaylistSnapshot::getCount() const noexcept {
+	return static_cast<unsigned int>(songs->size());
+}
+
+/**
+ @fn	const Song& PlaylistSnapshot::at(size_t position) const
+
+ @brief	Returns the song at given position
+
+ @param	position	Zero based position of the song
+
+ @return	Reference to the song, valid as long as the snapshot
+
+ @throws std::out_of_range if position is past the end of the snapshot
+ */
+
+const Song& PlaylistSnapshot::at(size_t position) const {
+	return *songs->at(position);
+}
+
+/**
+ @fn	void PlaylistSnapshot::print(std::ostream& os) const
+
+ @brief	Inserts all songs to given ostream, like Playlist::print()
+
+ @param [in,out]	os	The ostream to insert song representations in to.
+ */
+
+void PlaylistSnapshot::print(std::ostream& os) const {
+
+	for (auto const& song : *songs) {
+		os << *song << std::endl;
+	}
+}
+
+/**
+ @fn	SongList::const_iterator PlaylistSnapshot::begin() const noexcept
+
+ @brief	Returns iterator to the first song
+ */
+
+SongList::const_iterator PlaylistSnapshot::begin() const noexcept {
+	return songs->begin();
+}
+
+/**
+ @fn	SongList::const_iterator PlaylistSnapshot::end() const noexcept
+
+ @brief	Returns iterator past the last song
+ */
+
+SongList::const_iterator PlaylistSnapshot::end() const noexcept {
+	return songs->end();
+}
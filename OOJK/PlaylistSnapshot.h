@@ -0,0 +1,50 @@
+/**
+ @file	PlaylistSnapshot.h.
+
+ @brief	Declares the playlist snapshot class.
+		An immutable view of a playlist as it was when last published.
+		Getting a snapshot takes a short lock around a pointer swap, see Playlist::snapshot().
+		Readers then hold the version they got for as long as they need it without any locks,
+		while the writer keeps editing the playlist and publishing newer versions.
+		A version is freed when the last snapshot referring to it is gone.
+ */
+
+#pragma once
+#include <iostream>
+#include <memory>
+#include "SongList.h"
+
+class PlaylistSnapshot {
+
+private:
+	std::shared_ptr<const SongList> songs;		/** Published songs, never modified */
+
+public:
+	PlaylistSnapshot();													/** Snapshot of an empty playlist */
+	explicit PlaylistSnapshot(std::shared_ptr<const SongList> songs);	/** Snapshot of published songs */
+
+	unsigned int getCount() const noexcept;			/** Returns number of songs in the snapshot */
+	const Song& at(size_t position) const;			/** Returns song at given position */
+	void print(std::ostream&) const;				/** Inserts all songs to given ostream */
+	SongList::const_iterator begin() const noexcept;	/** Returns iterator to the first song */
+	SongList::const_iterator end() const noexcept;		/** Returns iterator past the last song */
+
+	/**
+	 @fn			bool PlaylistSnapshot::has(const T& song) const
+
+	 @brief			Determines existance of specified song in the snapshot
+
+	 @param song	Reference to song to find
+
+	 @return		TRUE if song exists in the snapshot, otherwise false
+	 */
+
+	template <class T>
+	bool has(const T& song) const {
+		for (auto const& s : *songs) {
+			if (*s == song)
+				return true;
+		}
+		return false;
+	}
+};
@@ -0,0 +1,89 @@
+/**
+ @file	PostingList.cpp.
+
+ @brief	Implements the posting list helpers
+ */
+
+#include "PostingList.h"
+#include <algorithm>
+
+/**
+ @fn	PostingList Postings::intersect(const PostingList& a, const PostingList& b)
+
+ @brief	Intersects two posting lists.
+		Walks the shorter list and gallops through the longer one, so filtering
+		a rare value against a common one costs little more than the rare list.
+
+ @param	a	First posting list
+		b	Second posting list
+
+ @return	Positions present in both lists, in ascending order
+ */
+
+PostingList Postings::intersect(const PostingList& a, const PostingList& b) {
+
+	const PostingList& shorter = (a.size() <= b.size()) ? a : b;
+	const PostingList& longer = (a.size() <= b.size()) ? b : a;
+
+	PostingList result;
+	auto from = longer.begin();
+
+	for (const unsigned int position : shorter) {
+
+		// Gallop forward to find a range that may contain the position
+		size_t step = 1;
+		auto bound = from;
+		while (bound != longer.end() && *bound < position) {
+			from = bound;
+			bound = (static_cast<size_t>(longer.end() - bound) > step) ? bound + step : longer.end();
+			step *= 2;
+		}
+
+		from = std::lower_bound(from, bound, position);
+		if (from == longer.end())
+			break;
+
+		if (*from == position)
+			result.push_back(position);
+	}
+
+	return result;
+}
+
+/**
+ @fn	void Postings::insert(PostingList& list, unsigned int position)
+
+ @brief	Adds a position to the list, keeping it sorted.
+		Appending past the last position is the common case and costs O(1).
+
+ @param [in,out]	list		Posting list to add to
+					position	Position to add
+ */
+
+void Postings::insert(PostingList& list, unsigned int position) {
+
+	if (list.empty() || list.back() < position) {
+		list.push_back(position);
+		return;
+	}
+
+	auto it = std::lower_bound(list.begin(), list.end(), position);
+	if (it == list.end() || *it != position)
+		list.insert(it, position);
+}
+
+/**
+ @fn	void Postings::erase(PostingList& list, unsigned int position)
+
+ @brief	Removes a position from the list if it is present
+
+ @param [in,out]	list		Posting list to remove from
+					position	Position to remove
+ */
+
+void Postings::erase(PostingList& list, unsigned int position) {
+
+	auto it = std::lower_bound(list.begin(), list.end(), position);
+	if (it != list.end() && *it == position)
+		list.erase(it);
+}
@@ -0,0 +1,21 @@
+/**
+ @file	PostingList.h.
+
+ @brief	Declares posting lists and helpers to maintain them.
+		A posting list is an ascending list of ids, e.g. entry ids of songs seen by an index,
+		which EntryOrder turns into playlist positions, or ids of playlists.
+		Indexes keep one posting list per indexed term and update them as the playlist changes.
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+typedef std::vector<unsigned int> PostingList;	/** Ascending list of ids or positions */
+
+class Postings {
+public:
+	static PostingList intersect(const PostingList&, const PostingList&);			/** Returns positions found in both lists */
+	static void insert(PostingList&, unsigned int position);						/** Adds a position keeping the list sorted */
+	static void erase(PostingList&, unsigned int position);							/** Removes a position if present */
+};
@@ -0,0 +1,261 @@
+/**
+ @file	PrefixIndex.cpp.
+
+ @brief	Implements the prefix index class
+ */
+
+#include "PrefixIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <thread>
+
+/**
+ @fn	PrefixIndex::PrefixIndex(const std::vector<std::string>& f)
+
+ @brief	Construction using the metadata keys whose values are completed
+
+ @param	f	Metadata keys, e.g. "artist"
+ */
+
+PrefixIndex::PrefixIndex(const std::vector<std::string>& f) :
+	fields(f),
+	dirty(false)
+{
+
+}
+
+/**
+ @fn	std::string PrefixIndex::makeKey(const std::string& value)
+
+ @brief	Makes the collation key of a value, so typing "que" completes "Queen"
+
+ @param	value	Metadata value
+
+ @return	ASCII lowercased value
+ */
+
+std::string PrefixIndex::makeKey(const std::string& value) {
+
+	std::string key(value);
+	std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+	return key;
+}
+
+/**
+ @fn	void PrefixIndex::count(CompletionMap& map, const std::vector<std::string>& fields, const Song& song, int delta)
+
+ @brief	Adds or subtracts the song's values to/from the frequencies in map.
+		Only evaluated songs are counted. Completions nobody has anymore are dropped.
+
+ @param [in,out]	map		Completions to update
+					fields	Metadata keys whose values are counted
+					song	The song whose values to count
+					delta	+1 to count the song in, -1 to count it out
+ */
+
+void PrefixIndex::count(CompletionMap& map, const std::vector<std::string>& fields, const Song& song, int delta) {
+
+	std::shared_ptr<MetaContainer> metadata = song.isEvaluated() ? song.evaluate() : nullptr;
+	if (!metadata)
+		return;
+
+	for (const std::string& field : fields) {
+		auto value = metadata->find(field);
+		if (value == metadata->end() || value->second.empty())
+			continue;
+
+		if (delta > 0) {
+			auto it = map.emplace(makeKey(value->second), Completion{ value->second, 0 }).first;
+			it->second.frequency += delta;
+			continue;
+		}
+
+		auto it = map.find(makeKey(value->second));
+		if (it == map.end())
+			continue;
+
+		if (it->second.frequency <= static_cast<unsigned int>(-delta))
+			map.erase(it);
+		else
+			it->second.frequency += delta;
+	}
+}
+
+/**
+ @fn	void PrefixIndex::add(const Song& song, int delta)
+
+ @brief	Counts the song's values in or out and marks the sorted array stale if keys came or went
+
+ @param	song	The song whose values to count
+		delta	+1 to count the song in, -1 to count it out
+ */
+
+void PrefixIndex::add(const Song& song, int delta) {
+
+	const size_t before = completions.size();
+	count(completions, fields, song, delta);
+
+	if (completions.size() != before)
+		dirty = true;
+}
+
+/**
+ @fn	void PrefixIndex::sort() const
+
+ @brief	Rebuilds the array of completions sorted by collation key.
+		Frequency changes don't affect the order, so this only runs after keys came or went.
+		The first of concurrent completions sorts while the others wait, as complete() is const
+		and may be called from several threads. Edits only happen while no one completes.
+ */
+
+void PrefixIndex::sort() const {
+
+	std::lock_guard<std::mutex> lock(sort_mutex);
+	if (!dirty)
+		return;
+
+	sorted.clear();
+	sorted.reserve(completions.size());
+	for (auto const& pair : completions)
+		sorted.push_back(&pair);
+
+	std::sort(sorted.begin(), sorted.end(), [](const CompletionMap::value_type* a, const CompletionMap::value_type* b) {
+		return a->first < b->first;
+	});
+
+	dirty = false;
+}
+
+/**
+ @fn	std::vector<Completion> PrefixIndex::complete(const std::string& prefix, size_t max_results) const
+
+ @brief	Finds values starting with the prefix, ignoring case
+
+ @param	prefix		Typed prefix
+		max_results	Maximum number of completions to return
+
+ @return	Completions ordered by descending frequency, ties alphabetically
+ */
+
+std::vector<Completion> PrefixIndex::complete(const std::string& prefix, size_t max_results) const {
+
+	sort();
+
+	const std::string key = makeKey(prefix);
+	auto first = std::lower_bound(sorted.begin(), sorted.end(), key, [](const CompletionMap::value_type* a, const std::string& k) {
+		return a->first < k;
+	});
+
+	std::vector<const CompletionMap::value_type*> matches;
+	for (auto it = first; it != sorted.end() && (*it)->first.compare(0, key.length(), key) == 0; it++)
+		matches.push_back(*it);
+
+	auto more_frequent = [](const CompletionMap::value_type* a, const CompletionMap::value_type* b) {
+		if (a->second.frequency != b->second.frequency)
+			return a->second.frequency > b->second.frequency;
+		return a->first < b->first;
+	};
+
+	const size_t n = std::min(max_results, matches.size());
+	std::partial_sort(matches.begin(), matches.begin() + n, matches.end(), more_frequent);
+
+	std::vector<Completion> result;
+	result.reserve(n);
+	for (size_t i = 0; i < n; i++)
+		result.push_back(matches[i]->second);
+
+	return result;
+}
+
+/**
+ @fn	void PrefixIndex::reset(const SongList& songs)
+
+ @brief	Rebuilds the index from the playlist's songs.
+		Large playlists are counted in parallel, each thread counting its own slice
+		into a private map, which are then merged.
+
+ @param	songs	All songs of the observed playlist
+ */
+
+void PrefixIndex::reset(const SongList& songs) {
+
+	completions.clear();
+	dirty = true;
+
+	const size_t min_slice = 10000;
+	const size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), songs.size() / min_slice + 1);
+
+	if (threads <= 1) {
+		for (auto const& song : songs)
+			count(completions, fields, *song, 1);
+		return;
+	}
+
+	std::vector<CompletionMap> partial(threads);
+	std::vector<std::thread> workers;
+	const size_t slice = (songs.size() + threads - 1) / threads;
+
+	for (size_t t = 0; t < threads; t++) {
+		workers.emplace_back([&, t]() {
+			const size_t end = std::min(songs.size(), (t + 1) * slice);
+			for (size_t i = t * slice; i < end; i++)
+				count(partial[t], fields, *songs[i], 1);
+		});
+	}
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	// Merge in slice order, so the first seen spelling of a value wins like in a serial build
+	for (CompletionMap& map : partial) {
+		for (auto& pair : map) {
+			auto it = completions.emplace(pair.first, Completion{ std::move(pair.second.value), 0 }).first;
+			it->second.frequency += pair.second.frequency;
+		}
+	}
+}
+
+/**
+ @fn	void PrefixIndex::inserted(size_t position, const Song& song)
+
+ @brief	Counts the values of an inserted song
+
+ @param	position	Position the song was inserted at, unused
+		song		The inserted song
+ */
+
+void PrefixIndex::inserted(size_t, const Song& song) {
+	add(song, 1);
+}
+
+/**
+ @fn	void PrefixIndex::erasing(const std::vector<size_t>& positions, const SongList& songs)
+
+ @brief	Uncounts the values of songs about to be erased
+
+ @param	positions	Ascending positions of the songs to be erased
+		songs		All songs of the observed playlist, before the removal
+ */
+
+void PrefixIndex::erasing(const std::vector<size_t>& positions, const SongList& songs) {
+
+	for (const size_t position : positions)
+		add(*songs[position], -1);
+}
+
+/**
+ @fn	void PrefixIndex::replaced(size_t position, const Song& before, const Song& after)
+
+ @brief	Recounts a replaced song, e.g. a proxy song whose values became known by evaluation
+
+ @param	position	Position of the replaced song, unused
+		before		The song that was replaced
+		after		The song now at position
+ */
+
+void PrefixIndex::replaced(size_t, const Song& before, const Song& after) {
+	add(before, -1);
+	add(after, 1);
+}
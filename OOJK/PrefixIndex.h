@@ -0,0 +1,47 @@
+/**
+ @file	PrefixIndex.h.
+
+ @brief	Declares the prefix index class.
+		Suggests completions for a typed prefix from the metadata values (artist, title)
+		of the songs in a playlist, most frequent first. Values are kept in a sorted array
+		of lowercased collation keys, so the values sharing a prefix are found with a binary search.
+		Several threads may complete at once, but not while the playlist is being edited.
+ */
+
+#pragma once
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "PlaylistObserver.h"
+
+struct Completion {
+	std::string value;			/** Metadata value as first seen in the playlist */
+	unsigned int frequency;		/** Number of songs having this value */
+};
+
+class PrefixIndex : public PlaylistObserver {
+
+private:
+	typedef std::unordered_map<std::string, Completion> CompletionMap;	/** Maps collation key to its completion */
+
+	std::vector<std::string> fields;								/** Metadata keys whose values are completed */
+	CompletionMap completions;										/** Completions by collation key */
+	mutable std::vector<const CompletionMap::value_type*> sorted;	/** Completions sorted by collation key, rebuilt lazily */
+	mutable bool dirty;												/** True when keys were added or removed since last sort */
+	mutable std::mutex sort_mutex;									/** Guards the lazy sort, so concurrent completions sort once */
+
+	static std::string makeKey(const std::string& value);						/** Returns collation key of a value */
+	static void count(CompletionMap& map, const std::vector<std::string>& fields, const Song& song, int delta);	/** Adds song's values to map */
+	void add(const Song& song, int delta);										/** Counts song's values in or out */
+	void sort() const;															/** Rebuilds the sorted key array if needed */
+
+public:
+	explicit PrefixIndex(const std::vector<std::string>& fields = { "artist", "title" });	/** Construction using the metadata keys to complete */
+
+	std::vector<Completion> complete(const std::string& prefix, size_t max_results) const;	/** Returns most frequent values starting with prefix */
+
+	void reset(const SongList& songs) override;										/** Rebuilds the index from scratch, in parallel */
+	void inserted(size_t position, const Song& song) override;						/** Counts an inserted song */
+	void erasing(const std::vector<size_t>& positions, const SongList& songs) override;	/** Uncounts erased songs */
+	void replaced(size_t position, const Song& before, const Song& after) override;	/** Recounts a replaced song */
+};
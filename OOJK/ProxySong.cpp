@@ -25,7 +25,18 @@ ProxySong::~ProxySong() {
  @param	filepath	The filepath to a physical song file on a storage media.
  */
 
-ProxySong::ProxySong(const std::string &filepath) : path(filepath) {
+ProxySong::ProxySong(const std::string &filepath) : path(PathStore::intern(filepath)) {
+}
+
+/**
+ @fn	ProxySong::ProxySong(PathStore::Id filepath) noexcept
+
+ @brief	Construction using a filepath already in the path store, e.g. of another song
+
+ @param	filepath	Id of the filepath to a physical song file on a storage media.
+ */
+
+ProxySong::ProxySong(PathStore::Id filepath) noexcept : path(filepath) {
 }
 
 /**
@@ -48,9 +59,9 @@ ProxySong::ProxySong(const ProxySong& ps) : path(ps.path) {
  @param [in,out]	ps	ProxySong to move from
  */
 
-ProxySong::ProxySong(ProxySong&& ps) noexcept : path(std::move(ps.path)) {
+ProxySong::ProxySong(ProxySong&& ps) noexcept : path(ps.path) {
 
-	ps.path.clear();
+	ps.path = 0;
 }
 
 /**
@@ -79,8 +90,8 @@ ProxySong& ProxySong::operator=(ProxySong&& ps) noexcept {
 	if (this == &ps)
 		return *this;
 
-	path = std::move(ps.path);
-	ps.path.clear();
+	path = ps.path;
+	ps.path = 0;
 	
 	return *this;
 }
@@ -97,6 +108,20 @@ std::unique_ptr<Song> ProxySong::clone() const {
 	return std::make_unique<ProxySong>(*this);
 }
 
+/**
+ @fn	std::unique_ptr<Song> ProxySong::relocated(const std::string& newpath) const
+
+ @brief	Makes a copy of this object for a file moved to another path
+
+ @param	newpath	Path the file is now at
+
+ @return	A copy of this object as a new unique pointer.
+ */
+
+std::unique_ptr<Song> ProxySong::relocated(const std::string& newpath) const {
+	return std::make_unique<ProxySong>(newpath);
+}
+
 /**
  @fn	MetaContainer ProxySong::evaluate() const
 
@@ -106,7 +131,7 @@ std::unique_ptr<Song> ProxySong::clone() const {
  */
 
 std::shared_ptr<MetaContainer> ProxySong::evaluate() const {
-	return Metadata::getFileMetadata(path);
+	return Metadata::getFileMetadata(PathStore::get(path));
 }
 
 /**
@@ -118,6 +143,18 @@ std::shared_ptr<MetaContainer> ProxySong::evaluate() const {
  */
 
 std::string ProxySong::getPath() const {
+	return PathStore::get(path);
+}
+
+/**
+ @fn	PathStore::Id ProxySong::getPathId() const noexcept
+
+ @brief	Returns id of the path in the path store. Equal paths have equal ids.
+
+ @return	Id of the path to physical file
+ */
+
+PathStore::Id ProxySong::getPathId() const noexcept {
 	return path;
 }
 
@@ -134,7 +171,7 @@ std::string ProxySong::getPath() const {
  */
 
 std::ostream& ProxySong::print(std::ostream& os) const {
-	return os << "ProxySong: " << path.c_str();
+	return os << "ProxySong: " << PathStore::get(path).c_str();
 }
 
 /**
@@ -167,4 +204,17 @@ bool ProxySong::operator==(const Song& s) const {
 
 bool ProxySong::operator==(const ProxySong& ps) const noexcept {
 	return (path == ps.path);
-}
\ No newline at end of file
+}
+
+/**
+ @fn	bool ProxySong::isEvaluated() const noexcept
+
+ @brief	Tells if the song's metadata is known without reading the file.
+		Proxy songs only know their path, so metadata must be resolved through evaluate().
+
+ @return	Always false
+ */
+
+bool ProxySong::isEvaluated() const noexcept {
+	return false;
+}
@@ -11,12 +11,13 @@
 class ProxySong : public Song {
 
 private:
-	std::string path;	/** path to a physical file on storage media that can be evaluated for metadata */
+	PathStore::Id path;	/** path to a physical file on storage media that can be evaluated for metadata, interned in the path store */
 
 public:
 	~ProxySong();												/** Destrcutor */
 	ProxySong() = delete;										/** Delete default constructor */
 	explicit ProxySong(const std::string &filepath);			/** Construction using a filepath */
+	explicit ProxySong(PathStore::Id filepath) noexcept;		/** Construction using an interned filepath */
 	ProxySong(const ProxySong&);								/** Copy construction using a lvalue reference to another instance */
 	ProxySong(ProxySong&&) noexcept;							/** Move construction using a rvalue reference another instance */
 	ProxySong& operator=(const ProxySong&);						/** Copy assignment using a lvalue reference to another instance */
@@ -25,7 +26,10 @@ public:
 	std::ostream& print(std::ostream&) const override;			/** Print operator prints the path */
 	std::shared_ptr<MetaContainer> evaluate() const override;	/** Finds file using a reference to metadata cache */
 	std::string getPath() const override;						/** Returns path to physical file */
+	PathStore::Id getPathId() const noexcept override;			/** Returns id of the path in the path store */
 	std::unique_ptr<Song> clone() const override;				/** Clones the song into new unique pointer */
+	std::unique_ptr<Song> relocated(const std::string&) const override;	/** Clones the song to another path */
 	bool operator==(const Song&) const override;				/** Can be compared to other songs using the same abstraction/interface */
 	bool operator==(const ProxySong&) const noexcept;			/** Can be compared to other proxy songs (using path comparison) */
+	bool isEvaluated() const noexcept override;					/** Proxy songs are never evaluated */
 };
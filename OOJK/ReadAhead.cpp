@@ -0,0 +1,182 @@
+/**
+ @file	ReadAhead.cpp.
+
+ @brief	Implements the read ahead class
+ */
+
+#include "ReadAhead.h"
+#include "Playlist.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__unix__) && !defined(__APPLE__)
+#define OOJK_HAS_FADVISE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+/**
+ @fn	ReadAhead::ReadAhead(Playlist& pl, unsigned int n, unsigned long long budget)
+
+ @brief	Constructor. Nothing is warmed until advance() is called.
+
+ @param [in,out]	pl		Playlist being played. Must outlive the read ahead.
+					n		Number of songs to warm after the current one
+					budget	Most bytes to keep warmed at a time. The current song is warmed first,
+							a song that doesn't fit whole is warmed only from its start.
+
+ @throws std::invalid_argument if budget is zero
+ */
+
+ReadAhead::ReadAhead(Playlist& pl, unsigned int n, unsigned long long budget) :
+	playlist(pl),
+	count(n),
+	byte_budget(budget)
+{
+	if (byte_budget == 0)
+		throw std::invalid_argument("Read ahead budget must be positive");
+}
+
+/**
+ @fn	unsigned long long ReadAhead::advance(size_t position)
+
+ @brief	Moves playback to a position. The song there and the given number of songs after it
+		are warmed in play order until the byte budget runs out. Previously warmed files
+		that are no longer among them, i.e. already played or skipped, are dropped from the cache.
+		Files already warmed are not hinted again, only a file cut short by the budget earlier
+		is topped up with the bytes it is missing, or cut down if the budget shrank.
+
+ @param	position	Position of the song being played, past the end drops everything
+
+ @return	Number of bytes newly asked to be read ahead
+ */
+
+unsigned long long ReadAhead::advance(size_t position) {
+
+	const size_t total = playlist.getCount();
+	const size_t last = std::min(total, position + static_cast<size_t>(count) + 1);
+
+	std::map<std::string, Warmed> upcoming;
+	unsigned long long remaining = byte_budget;
+	unsigned long long requested = 0;
+
+	for (size_t i = position; i < last && remaining > 0; i++) {
+
+		const std::string path = playlist.at(i).getPath();
+		if (upcoming.count(path) != 0)
+			continue;
+
+		auto it = warmed.find(path);
+		Warmed file = (it != warmed.end()) ? it->second : Warmed{ 0, false };
+
+		if (file.bytes > remaining) {
+			advise(path, remaining, file.bytes - remaining, false);
+			file = Warmed{ remaining, false };
+		}
+		else if (file.bytes < remaining && !file.whole) {
+			const unsigned long long wanted = remaining - file.bytes;
+			const unsigned long long extra = advise(path, file.bytes, wanted, true);
+			file = Warmed{ file.bytes + extra, extra < wanted };
+			requested += extra;
+		}
+
+		upcoming.emplace(path, file);
+		remaining -= file.bytes;
+	}
+
+	for (const auto& file : warmed) {
+		if (upcoming.count(file.first) == 0)
+			advise(file.first, 0, file.second.bytes, false);
+	}
+
+	warmed = std::move(upcoming);
+	return requested;
+}
+
+/**
+ @fn	void ReadAhead::release()
+
+ @brief	Drops all warmed songs from the cache, e.g. when playback stops
+ */
+
+void ReadAhead::release() {
+
+	for (const auto& file : warmed)
+		advise(file.first, 0, file.second.bytes, false);
+	warmed.clear();
+}
+
+/**
+ @fn	unsigned long long ReadAhead::getWarmedBytes() const noexcept
+
+ @brief	Returns number of bytes currently warmed
+
+ @return	Sum of bytes warmed over all files, never more than the budget
+ */
+
+unsigned long long ReadAhead::getWarmedBytes() const noexcept {
+
+	unsigned long long bytes = 0;
+	for (const auto& file : warmed)
+		bytes += file.second.bytes;
+	return bytes;
+}
+
+/**
+ @fn	bool ReadAhead::isSupported() noexcept
+
+ @brief	Tells if caching hints have any effect on this platform
+
+ @return	TRUE if posix_fadvise is available
+ */
+
+bool ReadAhead::isSupported() noexcept {
+
+#ifdef OOJK_HAS_FADVISE
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ @fn	unsigned long long ReadAhead::advise(const std::string& path, unsigned long long offset, unsigned long long length, bool needed) noexcept
+
+ @brief	Gives a caching hint for a range of a file. The hint outlives the file descriptor,
+		with WILLNEED the kernel starts reading in the background and returns at once.
+
+ @param	path	Full pathname of the file
+		offset	Start of the range
+		length	Most bytes from offset to hint about
+		needed	TRUE to ask the data to be read ahead, FALSE to drop it from the cache
+
+ @return	Number of bytes hinted about, less than length if the file ends first,
+			0 if the file can't be opened or hints aren't supported
+ */
+
+unsigned long long ReadAhead::advise(const std::string& path, unsigned long long offset, unsigned long long length, bool needed) noexcept {
+
+#ifdef OOJK_HAS_FADVISE
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return 0;
+
+	struct stat info;
+	unsigned long long bytes = 0;
+	if (::fstat(fd, &info) == 0 && static_cast<unsigned long long>(info.st_size) > offset) {
+		bytes = std::min(length, static_cast<unsigned long long>(info.st_size) - offset);
+		if (::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(bytes), needed ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED) != 0)
+			bytes = 0;
+	}
+
+	::close(fd);
+	return bytes;
+#else
+	(void)path;
+	(void)offset;
+	(void)length;
+	(void)needed;
+	return 0;
+#endif
+}
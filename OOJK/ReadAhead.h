@@ -0,0 +1,42 @@
+/**
+ @file	ReadAhead.h.
+
+ @brief	Declares the read ahead class.
+		Warms the page cache for the songs about to be played, so playback doesn't
+		stall while the first seconds of a track are fetched from a slow or networked disk.
+		Songs left behind are dropped from the cache again, keeping the memory used within a budget.
+		Hints are given with posix_fadvise where available, elsewhere nothing is done.
+ */
+
+#pragma once
+#include <map>
+#include <string>
+
+class Playlist;
+
+class ReadAhead {
+
+private:
+	/** Part of a file warmed from its start */
+	struct Warmed {
+		unsigned long long bytes;				/** Bytes warmed from the start of the file */
+		bool whole;								/** TRUE if the bytes reach the end of the file */
+	};
+
+	Playlist& playlist;							/** Playlist being played */
+	unsigned int count;							/** Number of songs warmed after the current one */
+	unsigned long long byte_budget;				/** Most bytes warmed at a time */
+	std::map<std::string, Warmed> warmed;		/** Part warmed per file path */
+
+	static unsigned long long advise(const std::string& path, unsigned long long offset, unsigned long long length, bool needed) noexcept;	/** Gives a caching hint for a range of a file */
+
+public:
+	explicit ReadAhead(Playlist& playlist, unsigned int count = 4, unsigned long long byte_budget = 64ull << 20);	/** Constructor, nothing is warmed yet */
+	ReadAhead(const ReadAhead&) = delete;
+	ReadAhead& operator=(const ReadAhead&) = delete;
+
+	unsigned long long advance(size_t position);	/** Warms songs from position on, drops the ones left behind */
+	void release();								/** Drops all warmed songs */
+	unsigned long long getWarmedBytes() const noexcept;	/** Returns number of bytes currently warmed */
+	static bool isSupported() noexcept;			/** Tells if caching hints have any effect on this platform */
+};
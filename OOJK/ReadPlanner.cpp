@@ -0,0 +1,203 @@
+/**
+ @file	ReadPlanner.cpp.
+
+ @brief	Implements the read planner class
+ */
+
+#include "ReadPlanner.h"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/vfs.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#include <linux/magic.h>
+#endif
+
+const size_t ReadPlanner::max_threads = 16;
+
+/**
+ @fn	std::vector<size_t> ReadPlanner::plan(const std::vector<std::string>& paths, unsigned int threads)
+
+ @brief	Plans the order to read files in. Files are grouped by directory, directories
+		in name order so neighbouring directories follow each other, and files of a directory
+		by physical offset or inode. Offsets and inode numbers don't compare to each other,
+		so files with an offset come first and those with only an inode number after them.
+		File names break ties, so files that can't be located are still read in a stable order.
+		Threads take a directory at a time, as FileStatus does.
+
+ @param	paths	Full pathnames of the files to read
+		threads	Number of threads locating files, 0 to decide by the number of cores
+
+ @return	Indexes of paths in the order they should be read
+ */
+
+std::vector<size_t> ReadPlanner::plan(const std::vector<std::string>& paths, unsigned int threads) {
+
+	std::map<std::string, std::vector<Location>> grouped;
+	for (size_t i = 0; i < paths.size(); i++)
+		grouped[getDirectory(paths[i])].push_back(Location{ i, 0, false });
+
+	std::vector<std::pair<const std::string, std::vector<Location>>*> directories;
+	directories.reserve(grouped.size());
+	for (auto& directory : grouped)
+		directories.push_back(&directory);
+
+	// Locating mostly waits for the file system, so more threads than cores pay off
+	if (threads == 0)
+		threads = static_cast<unsigned int>(std::min(max_threads, static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())) * 2));
+	threads = static_cast<unsigned int>(std::min(static_cast<size_t>(threads), directories.size()));
+
+	if (threads <= 1) {
+		for (auto directory : directories)
+			planDirectory(directory->first, paths, directory->second);
+	}
+	else {
+		// Each thread orders only the locations of the directories it takes
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i = next++; i < directories.size(); i = next++)
+				planDirectory(directories[i]->first, paths, directories[i]->second);
+		};
+
+		std::vector<std::thread> pool;
+		for (unsigned int i = 0; i < threads; i++)
+			pool.emplace_back(worker);
+		for (std::thread& thread : pool)
+			thread.join();
+	}
+
+	std::vector<size_t> order;
+	order.reserve(paths.size());
+	for (auto directory : directories) {
+		for (const Location& location : directory->second)
+			order.push_back(location.index);
+	}
+
+	return order;
+}
+
+/**
+ @fn	std::string ReadPlanner::getDirectory(const std::string& path)
+
+ @brief	Returns the directory part of a path
+
+ @param	path	Full pathname of a file
+
+ @return	Path up to the last directory delimeter, empty if there is none
+ */
+
+std::string ReadPlanner::getDirectory(const std::string& path) {
+
+	const size_t last_delimeter = path.find_last_of("/\\");
+	return (last_delimeter == std::string::npos) ? std::string() : path.substr(0, last_delimeter);
+}
+
+/**
+ @fn	void ReadPlanner::planDirectory(const std::string& directory, const std::vector<std::string>& paths, std::vector<Location>& locations) noexcept
+
+ @brief	Finds where the data of the files of one directory is, and sorts them by it.
+		The directory is opened once and files are looked up relative to it.
+		On Linux the physical offset of a file's first extent is asked with FIEMAP, but only
+		on local block file systems; elsewhere, e.g. on network shares, FIEMAP isn't supported
+		and opening every file for it costs a round trip each. There and on other POSIX systems
+		the inode number is used, as file systems tend to allocate data in inode order.
+		Elsewhere nothing is known and files are ordered by name.
+
+ @param			directory	Directory of the files, empty for the current directory
+				paths		Full pathnames of all files being planned
+ @param [in,out]	locations	Locations of the files in this directory, offsets are set and they are sorted
+ */
+
+void ReadPlanner::planDirectory(const std::string& directory, const std::vector<std::string>& paths, std::vector<Location>& locations) noexcept {
+
+#if defined(__unix__) || defined(__APPLE__)
+	const size_t name_start = directory.empty() ? 0 : directory.size() + 1;
+
+	// Names of absolute paths with an empty directory part, like /a.mp3, ignore the descriptor
+	const int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd >= 0) {
+
+#ifdef __linux__
+		struct statfs file_system;
+		bool block = false;
+		if (::fstatfs(fd, &file_system) == 0) {
+			switch (static_cast<unsigned long>(file_system.f_type)) {
+			case EXT4_SUPER_MAGIC:
+			case XFS_SUPER_MAGIC:
+			case BTRFS_SUPER_MAGIC:
+			case F2FS_SUPER_MAGIC:
+			case MSDOS_SUPER_MAGIC:
+				block = true;
+				break;
+			}
+		}
+#endif
+
+		for (Location& location : locations) {
+			const char* name = paths[location.index].c_str() + name_start;
+
+#ifdef __linux__
+			if (block) {
+				const int file = ::openat(fd, name, O_RDONLY | O_CLOEXEC);
+				if (file >= 0) {
+
+					// Room for the header and a single extent
+					union {
+						struct fiemap map;
+						char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+					} request = {};
+
+					request.map.fm_start = 0;
+					request.map.fm_length = FIEMAP_MAX_OFFSET;
+					request.map.fm_extent_count = 1;
+
+					if (::ioctl(file, FS_IOC_FIEMAP, &request.map) == 0 && request.map.fm_mapped_extents > 0)
+						location.offset = request.map.fm_extents[0].fe_physical;
+					location.physical = (location.offset != 0);
+
+					struct stat info;
+					if (!location.physical && ::fstat(file, &info) == 0)
+						location.offset = static_cast<unsigned long long>(info.st_ino);
+
+					::close(file);
+				}
+				continue;
+			}
+#endif
+
+#ifdef STATX_INO
+			struct statx info;
+			if (::statx(fd, name, 0, STATX_INO, &info) == 0)
+				location.offset = static_cast<unsigned long long>(info.stx_ino);
+#else
+			struct stat info;
+			if (::fstatat(fd, name, &info, 0) == 0)
+				location.offset = static_cast<unsigned long long>(info.st_ino);
+#endif
+		}
+
+		::close(fd);
+	}
+#else
+	(void)directory;
+#endif
+
+	std::sort(locations.begin(), locations.end(), [&paths](const Location& a, const Location& b) {
+		if (a.physical != b.physical)
+			return a.physical;
+		if (a.offset != b.offset)
+			return a.offset < b.offset;
+		return paths[a.index] < paths[b.index];
+	});
+}
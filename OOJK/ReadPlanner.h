@@ -0,0 +1,34 @@
+/**
+ @file	ReadPlanner.h.
+
+ @brief	Declares the read planner class.
+		Orders metadata reads so files are visited directory by directory,
+		and within a directory in the order they are laid out on disk.
+		Reading a shuffled playlist in playlist order seeks all over the disk,
+		reading it in planned order mostly moves forward.
+		Directories are located in parallel, each opened once with its files looked up relative to it.
+		Physical offsets are only asked from local block file systems, elsewhere inode numbers are used.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+class ReadPlanner {
+
+private:
+	/** Where a file is, as far as the order of reads is concerned */
+	struct Location {
+		size_t index;				/** Index of the path in the planned paths */
+		unsigned long long offset;	/** Physical offset of the file's data, or its inode number if unknown, 0 if neither is */
+		bool physical;				/** TRUE if offset is a physical offset, FALSE if it's an inode number */
+	};
+
+	const static size_t max_threads;	/** Most threads used for locating files */
+
+	static void planDirectory(const std::string& directory, const std::vector<std::string>& paths, std::vector<Location>& locations) noexcept;	/** Locates and orders files of one directory */
+
+public:
+	static std::vector<size_t> plan(const std::vector<std::string>& paths, unsigned int threads = 0);	/** Returns the order to read files in */
+	static std::string getDirectory(const std::string& path);				/** Returns directory part of a path */
+};
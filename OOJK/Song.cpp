@@ -33,5 +33,18 @@ std::ostream& operator<<(std::ostream& stream, const Song& song) {
  */
 
 bool Song::operator==(const Song& rhs) const {
-	return getPath() == rhs.getPath();
-}
\ No newline at end of file
+	return getPathId() == rhs.getPathId();
+}
+
+/**
+ @fn	void Song::writePath(std::string& buffer) const
+
+ @brief	Writes path to the physical file into a buffer. Reusing the buffer when going
+		through many songs saves allocating memory for each path.
+
+ @param [out]	buffer	Replaced with the path
+ */
+
+void Song::writePath(std::string& buffer) const {
+	PathStore::get(getPathId(), buffer);
+}
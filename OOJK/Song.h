@@ -9,6 +9,7 @@
 #include <memory>
 #include <vector>
 #include "Metadata.h"
+#include "PathStore.h"
 
 class Song {
 
@@ -23,6 +24,12 @@ class Song {
 	virtual std::ostream& print(std::ostream&) const = 0;		/** Actual implementation of "<<" */
 	virtual std::shared_ptr<MetaContainer> evaluate() const = 0;/** Song should be evaluatable for metadata */
 	virtual std::string getPath() const = 0;					/** Returns path to physical file */
+	virtual PathStore::Id getPathId() const noexcept = 0;		/** Returns id of the path in the path store */
+	void writePath(std::string& buffer) const;					/** Writes path to physical file into a buffer */
 	virtual std::unique_ptr<Song> clone() const = 0;			/** Song should be clonable */
+	virtual std::unique_ptr<Song> relocated(const std::string&) const = 0;	/** Song should be clonable to another path */
 	virtual bool operator==(const Song&) const;					/** Song should be comparable to other songs */
+	virtual bool isEvaluated() const noexcept = 0;				/** Tells if metadata is available without reading the file */
 };
+
+typedef std::shared_ptr<const Song> SongElement;	/** Convenience typedef for songs. Songs are immutable once added, so playlists can share them */
@@ -0,0 +1,543 @@
+/**
+ @file	SongList.cpp.
+
+ @brief	Implements the song list class
+ */
+
+#include "SongList.h"
+#include <stdexcept>
+
+/** Songs per block. Large enough for cache friendly iteration, small enough for cheap shifting inside a block. */
+const size_t SongList::block_size = 512;
+
+/**
+ @fn	SongList::SongList()
+
+ @brief	Default constructor
+ */
+
+SongList::SongList() noexcept : count(0) {
+
+}
+
+/**
+ @fn	SongList::SongList(const SongList& other)
+
+ @brief	Copy construction sharing the blocks of another list in O(n / block size).
+		Neither list owns the shared blocks afterwards, so both copy a block before modifying it.
+		A list whose blocks are all shared already isn't written to, so published lists
+		can be copied from several threads at once.
+
+ @param	other	The list to copy
+ */
+
+SongList::SongList(const SongList& other) :
+	blocks(other.blocks),
+	owned(other.blocks.size(), false),
+	tree(other.tree),
+	count(other.count)
+{
+	for (size_t i = 0; i < other.owned.size(); i++) {
+		if (other.owned[i])
+			other.owned[i] = false;
+	}
+}
+
+/**
+ @fn	SongList& SongList::operator=(const SongList& other)
+
+ @brief	Copy assignment sharing the blocks of another list
+
+ @param	other	The list to copy
+
+ @return	Reference to this list
+ */
+
+SongList& SongList::operator=(const SongList& other) {
+
+	if (this != &other)
+		*this = SongList(other);
+
+	return *this;
+}
+
+/**
+ @fn	void SongList::rebuild()
+
+ @brief	Rebuilds the Fenwick tree of block sizes in O(number of blocks).
+		Needed whenever blocks are split, merged or removed.
+ */
+
+void SongList::rebuild() {
+
+	tree.assign(blocks.size() + 1, 0);
+
+	for (size_t i = 1; i <= blocks.size(); i++) {
+		tree[i] += blocks[i - 1]->size();
+		const size_t parent = i + (i & (~i + 1));
+		if (parent <= blocks.size())
+			tree[parent] += tree[i];
+	}
+}
+
+/**
+ @fn	void SongList::appendBlock()
+
+ @brief	Adds the last block of the block array to the Fenwick tree in O(log n).
+		A new tree node covers the sizes of the blocks in its range, which is
+		the difference of two prefix sums.
+ */
+
+void SongList::appendBlock() {
+
+	if (tree.empty())
+		tree.push_back(0);
+
+	const size_t node = tree.size();
+	const size_t first = node - (node & (~node + 1));
+
+	size_t covered = blocks[node - 1]->size();
+	covered += prefix(node - 1) - prefix(first);
+	tree.push_back(covered);
+}
+
+/**
+ @fn	size_t SongList::prefix(size_t blockcount) const
+
+ @brief	Sums the sizes of the first blocks
+
+ @param	blockcount	Number of blocks to sum
+
+ @return	Number of songs in the blocks
+ */
+
+size_t SongList::prefix(size_t blockcount) const {
+
+	size_t sum = 0;
+	for (size_t i = blockcount; i > 0; i -= i & (~i + 1))
+		sum += tree[i];
+	return sum;
+}
+
+/**
+ @fn	void SongList::update(size_t block, long long delta)
+
+ @brief	Adjusts the size of a block in the Fenwick tree
+
+ @param	block	Index of the block
+		delta	Change in the number of songs of the block
+ */
+
+void SongList::update(size_t block, long long delta) {
+
+	for (size_t i = block + 1; i < tree.size(); i += i & (~i + 1))
+		tree[i] += delta;
+}
+
+/**
+ @fn	std::pair<size_t, size_t> SongList::locate(size_t position) const
+
+ @brief	Finds the block holding a position by descending the Fenwick tree
+
+ @param	position	Position of a song, less than size()
+
+ @return	Index of the block and offset of the song in the block
+ */
+
+std::pair<size_t, size_t> SongList::locate(size_t position) const {
+
+	size_t step = 1;
+	while (step * 2 < tree.size())
+		step *= 2;
+
+	size_t block = 0;
+	for (; step > 0; step /= 2) {
+		if (block + step < tree.size() && tree[block + step] <= position) {
+			block += step;
+			position -= tree[block];
+		}
+	}
+
+	return std::make_pair(block, position);
+}
+
+/**
+ @fn	SongList::Block& SongList::own(size_t block)
+
+ @brief	Returns a block for modifying. A block shared with a copy of the list
+		is copied first, so the copy keeps seeing its songs unchanged.
+
+ @param	block	Index of the block
+
+ @return	Reference to the block, owned by this list only
+ */
+
+SongList::Block& SongList::own(size_t block) {
+
+	if (!owned[block]) {
+		blocks[block] = std::make_shared<Block>(*blocks[block]);
+		owned[block] = true;
+	}
+
+	return *blocks[block];
+}
+
+/**
+ @fn	SongElement& SongList::element(size_t block, size_t offset)
+
+ @brief	Returns a song for modifying, copying its block first if shared
+
+ @param	block	Index of the block
+		offset	Index of the song in the block
+
+ @return	Reference to the song
+ */
+
+SongElement& SongList::element(size_t block, size_t offset) {
+	return own(block)[offset];
+}
+
+/**
+ @fn	const SongElement& SongList::element(size_t block, size_t offset) const
+
+ @brief	Returns a song for reading
+
+ @param	block	Index of the block
+		offset	Index of the song in the block
+
+ @return	Reference to the song
+ */
+
+const SongElement& SongList::element(size_t block, size_t offset) const {
+	return (*blocks[block])[offset];
+}
+
+/**
+ @fn	size_t SongList::size() const noexcept
+
+ @brief	Returns number of songs in the list
+ */
+
+size_t SongList::size() const noexcept {
+	return count;
+}
+
+/**
+ @fn	bool SongList::empty() const noexcept
+
+ @brief	Tells if the list has no songs
+ */
+
+bool SongList::empty() const noexcept {
+	return count == 0;
+}
+
+/**
+ @fn	void SongList::clear() noexcept
+
+ @brief	Removes all songs from the list
+ */
+
+void SongList::clear() noexcept {
+	blocks.clear();
+	owned.clear();
+	tree.clear();
+	count = 0;
+}
+
+/**
+ @fn	void SongList::reserve(size_t n)
+
+ @brief	Prepares the list for n songs, so appending doesn't reallocate the block array
+
+ @param	n	Expected number of songs
+ */
+
+void SongList::reserve(size_t n) {
+	blocks.reserve(n / block_size + 1);
+	owned.reserve(n / block_size + 1);
+	tree.reserve(n / block_size + 2);
+}
+
+/**
+ @fn	SongElement& SongList::operator[](size_t position)
+
+ @brief	Returns song at position in O(log n). Position is not checked.
+
+ @param	position	Position of the song
+
+ @return	Reference to the song
+ */
+
+SongElement& SongList::operator[](size_t position) {
+	const std::pair<size_t, size_t> location = locate(position);
+	return element(location.first, location.second);
+}
+
+/**
+ @fn	const SongElement& SongList::operator[](size_t position) const
+
+ @brief	Returns song at position in O(log n). Position is not checked.
+
+ @param	position	Position of the song
+
+ @return	Reference to the song
+ */
+
+const SongElement& SongList::operator[](size_t position) const {
+	const std::pair<size_t, size_t> location = locate(position);
+	return element(location.first, location.second);
+}
+
+/**
+ @fn	SongElement& SongList::at(size_t position)
+
+ @brief	Returns song at position in O(log n)
+
+ @param	position	Position of the song
+
+ @return	Reference to the song
+
+ @throws	std::out_of_range if position is past the end of the list
+ */
+
+SongElement& SongList::at(size_t position) {
+
+	if (position >= count)
+		throw std::out_of_range("Song position out of range");
+
+	return (*this)[position];
+}
+
+/**
+ @fn	const SongElement& SongList::at(size_t position) const
+
+ @brief	Returns song at position in O(log n)
+
+ @param	position	Position of the song
+
+ @return	Reference to the song
+
+ @throws	std::out_of_range if position is past the end of the list
+ */
+
+const SongElement& SongList::at(size_t position) const {
+
+	if (position >= count)
+		throw std::out_of_range("Song position out of range");
+
+	return (*this)[position];
+}
+
+/**
+ @fn	SongElement& SongList::back()
+
+ @brief	Returns the last song of a non-empty list
+
+ @return	Reference to the song
+ */
+
+SongElement& SongList::back() {
+	return own(blocks.size() - 1).back();
+}
+
+/**
+ @fn	void SongList::push_back(const SongElement& song)
+
+ @brief	Appends a song. Appended songs fill the last block up to block_size,
+		so lists built by appending are densely packed.
+
+ @param	song	The song to append
+ */
+
+void SongList::push_back(const SongElement& song) {
+	emplace_back(SongElement(song));
+}
+
+/**
+ @fn	void SongList::emplace_back(SongElement&& song)
+
+ @brief	Appends a song
+
+ @param	song	The song to append
+ */
+
+void SongList::emplace_back(SongElement&& song) {
+
+	if (blocks.empty() || blocks.back()->size() >= block_size) {
+		blocks.push_back(std::make_shared<Block>());
+		owned.push_back(true);
+		blocks.back()->reserve(block_size);
+		blocks.back()->push_back(std::move(song));
+		count++;
+		appendBlock();
+		return;
+	}
+
+	own(blocks.size() - 1).push_back(std::move(song));
+	update(blocks.size() - 1, 1);
+	count++;
+}
+
+/**
+ @fn	void SongList::insert(size_t position, const SongElement& song)
+
+ @brief	Inserts a song at position in O(log n + block size).
+		Only songs of one block are shifted. A block growing past twice
+		the block size is split in two.
+
+ @param	position	Position to insert to, at most size()
+		song		The song to insert
+ */
+
+void SongList::insert(size_t position, const SongElement& song) {
+
+	if (position >= count) {
+		push_back(song);
+		return;
+	}
+
+	const std::pair<size_t, size_t> location = locate(position);
+	Block& block = own(location.first);
+	block.insert(block.begin() + location.second, song);
+	count++;
+
+	if (block.size() <= 2 * block_size) {
+		update(location.first, 1);
+		return;
+	}
+
+	Block upper(std::make_move_iterator(block.begin() + block_size), std::make_move_iterator(block.end()));
+	block.resize(block_size);
+	blocks.insert(blocks.begin() + location.first + 1, std::make_shared<Block>(std::move(upper)));
+	owned.insert(owned.begin() + location.first + 1, true);
+	rebuild();
+}
+
+/**
+ @fn	void SongList::erase(size_t position)
+
+ @brief	Removes the song at position in O(log n + block size).
+		A block left nearly empty is merged with its successor, so blocks stay dense.
+
+ @param	position	Position of the song to remove, less than size()
+ */
+
+void SongList::erase(size_t position) {
+
+	const std::pair<size_t, size_t> location = locate(position);
+	Block& block = own(location.first);
+	block.erase(block.begin() + location.second);
+	count--;
+
+	if (block.empty()) {
+		blocks.erase(blocks.begin() + location.first);
+		owned.erase(owned.begin() + location.first);
+		rebuild();
+		return;
+	}
+
+	const size_t next = location.first + 1;
+	if (block.size() < block_size / 4 && next < blocks.size() && block.size() + blocks[next]->size() <= block_size) {
+		block.insert(block.end(), blocks[next]->begin(), blocks[next]->end());
+		blocks.erase(blocks.begin() + next);
+		owned.erase(owned.begin() + next);
+		rebuild();
+		return;
+	}
+
+	update(location.first, -1);
+}
+
+/**
+ @fn	void SongList::erase(const std::vector<size_t>& positions)
+
+ @brief	Removes songs at the given positions.
+		A few songs are erased one by one, many songs in a single sweep
+		that also repacks the blocks.
+
+ @param	positions	Ascending positions of the songs to remove
+ */
+
+void SongList::erase(const std::vector<size_t>& positions) {
+
+	if (positions.size() * block_size < count) {
+		for (auto it = positions.rbegin(); it != positions.rend(); it++)
+			erase(*it);
+		return;
+	}
+
+	std::vector<std::shared_ptr<Block>> packed;
+	packed.reserve((count - positions.size()) / block_size + 1);
+
+	auto erased = positions.begin();
+	size_t position = 0;
+
+	for (size_t i = 0; i < blocks.size(); i++) {
+
+		// Songs of a block shared with a copy of the list must stay where they are
+		const bool shared = !owned[i];
+
+		for (SongElement& song : *blocks[i]) {
+			if (erased != positions.end() && *erased == position++) {
+				erased++;
+				continue;
+			}
+
+			if (packed.empty() || packed.back()->size() >= block_size) {
+				packed.push_back(std::make_shared<Block>());
+				packed.back()->reserve(block_size);
+			}
+
+			if (shared)
+				packed.back()->push_back(song);
+			else
+				packed.back()->push_back(std::move(song));
+		}
+	}
+
+	blocks = std::move(packed);
+	owned.assign(blocks.size(), true);
+	count -= positions.size();
+	rebuild();
+}
+
+/**
+ @fn	SongList::iterator SongList::begin() noexcept
+
+ @brief	Returns iterator to the first song
+ */
+
+SongList::iterator SongList::begin() noexcept {
+	return iterator(this, 0, 0);
+}
+
+/**
+ @fn	SongList::iterator SongList::end() noexcept
+
+ @brief	Returns iterator past the last song
+ */
+
+SongList::iterator SongList::end() noexcept {
+	return iterator(this, blocks.size(), 0);
+}
+
+/**
+ @fn	SongList::const_iterator SongList::begin() const noexcept
+
+ @brief	Returns iterator to the first song
+ */
+
+SongList::const_iterator SongList::begin() const noexcept {
+	return const_iterator(this, 0, 0);
+}
+
+/**
+ @fn	SongList::const_iterator SongList::end() const noexcept
+
+ @brief	Returns iterator past the last song
+ */
+
+SongList::const_iterator SongList::end() const noexcept {
+	return const_iterator(this, blocks.size(), 0);
+}
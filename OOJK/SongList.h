@@ -0,0 +1,110 @@
+/**
+ @file	SongList.h.
+
+ @brief	Declares the song list class.
+		An ordered container of songs stored in blocks of a few hundred songs.
+		A Fenwick tree over block sizes finds the block holding any position in O(log n),
+		so inserting, erasing and accessing by position only shift songs within one block,
+		while iterating still walks contiguous memory.
+		Copies share their blocks until either list modifies one, so copying costs O(n / block size).
+		Whether a block is shared is recorded when copying, not read from reference counts,
+		which snapshot readers on other threads may change at any time.
+ */
+
+#pragma once
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "Song.h"
+
+class SongList {
+
+private:
+	typedef std::vector<SongElement> Block;	/** Contiguous run of songs */
+
+	const static size_t block_size;	/** Number of songs a block is filled with. Blocks split at twice this size. */
+	std::vector<std::shared_ptr<Block>> blocks;	/** Blocks of songs, in order, possibly shared with copies of the list */
+	mutable std::vector<bool> owned;	/** Per block, true if no copy of the list shares it. Cleared by copying. */
+	std::vector<size_t> tree;		/** Fenwick tree of block sizes, 1-based */
+	size_t count;					/** Number of songs in the list */
+
+	void rebuild();													/** Rebuilds the Fenwick tree after blocks were added or removed */
+	void appendBlock();												/** Adds the last block to the Fenwick tree */
+	size_t prefix(size_t blockcount) const;							/** Returns number of songs in the first blocks */
+	void update(size_t block, long long delta);						/** Adjusts size of a block in the Fenwick tree */
+	std::pair<size_t, size_t> locate(size_t position) const;		/** Finds block and offset holding a position */
+	Block& own(size_t block);										/** Returns a block for modifying, copying it first if shared */
+	SongElement& element(size_t block, size_t offset);				/** Returns a song for modifying */
+	const SongElement& element(size_t block, size_t offset) const;	/** Returns a song for reading */
+
+public:
+	/** Forward iterator over songs, walking blocks in order */
+	template <class List, class Value>
+	class Iterator {
+		friend class SongList;
+
+	private:
+		List* list;			/** The iterated list */
+		size_t block;		/** Index of current block */
+		size_t offset;		/** Index of current song in the block */
+
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef SongElement value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef Value* pointer;
+		typedef Value& reference;
+
+		Iterator(List* l, size_t b, size_t o) noexcept : list(l), block(b), offset(o) {}
+
+		reference operator*() const { return list->element(block, offset); }
+		pointer operator->() const { return &list->element(block, offset); }
+		bool operator==(const Iterator& other) const noexcept { return block == other.block && offset == other.offset; }
+		bool operator!=(const Iterator& other) const noexcept { return !(*this == other); }
+
+		Iterator& operator++() {
+			if (++offset == list->blocks[block]->size()) {
+				block++;
+				offset = 0;
+			}
+			return *this;
+		}
+
+		Iterator operator++(int) {
+			Iterator previous = *this;
+			++(*this);
+			return previous;
+		}
+	};
+
+	typedef Iterator<SongList, SongElement> iterator;					/** Iterator allowing songs to be replaced */
+	typedef Iterator<const SongList, const SongElement> const_iterator;	/** Read only iterator */
+
+	SongList() noexcept;											/** Default constructor */
+	SongList(const SongList&);										/** Copy constructor sharing the blocks */
+	SongList(SongList&&) noexcept = default;						/** Move constructor taking the blocks */
+	SongList& operator=(const SongList&);							/** Copy assignment sharing the blocks */
+	SongList& operator=(SongList&&) noexcept = default;				/** Move assignment taking the blocks */
+
+	size_t size() const noexcept;									/** Returns number of songs */
+	bool empty() const noexcept;									/** Tells if there are no songs */
+	void clear() noexcept;											/** Removes all songs */
+	void reserve(size_t count);										/** Prepares the list for count songs */
+
+	SongElement& operator[](size_t position);						/** Returns song at position, O(log n) */
+	const SongElement& operator[](size_t position) const;			/** Returns song at position, O(log n) */
+	SongElement& at(size_t position);								/** Returns song at position, throws if out of range */
+	const SongElement& at(size_t position) const;					/** Returns song at position, throws if out of range */
+	SongElement& back();											/** Returns the last song */
+
+	void push_back(const SongElement& song);						/** Appends a song */
+	void emplace_back(SongElement&& song);							/** Appends a song */
+	void insert(size_t position, const SongElement& song);			/** Inserts a song at position */
+	void erase(size_t position);									/** Removes song at position */
+	void erase(const std::vector<size_t>& positions);				/** Removes songs at ascending positions in one sweep */
+
+	iterator begin() noexcept;										/** Returns iterator to the first song */
+	iterator end() noexcept;										/** Returns iterator past the last song */
+	const_iterator begin() const noexcept;							/** Returns iterator to the first song */
+	const_iterator end() const noexcept;							/** Returns iterator past the last song */
+};
@@ -0,0 +1,132 @@
+/**
+ @file	SongSet.cpp.
+
+ @brief	Implements the song set class
+ */
+
+#include "SongSet.h"
+#include <functional>
+
+/**
+ @fn	SongSet::SongSet(SongIdentity id)
+
+ @brief	Construction using equality semantics
+
+ @param	id	When two songs are considered the same
+ */
+
+SongSet::SongSet(SongIdentity id) : identity(id) {
+
+}
+
+/**
+ @fn	size_t SongSet::hash(const MetaContainer& md) noexcept
+
+ @brief	Hashes metadata contents, so that equal metadata gives equal hashes
+		even when stored in separate containers
+
+ @param	md	Metadata to hash
+
+ @return	Hash of all keys and values
+ */
+
+size_t SongSet::hash(const MetaContainer& md) noexcept {
+
+	std::hash<std::string> hasher;
+	size_t result = md.size();
+
+	for (auto const& pair : md) {
+		result ^= hasher(pair.first) + 0x9e3779b9 + (result << 6) + (result >> 2);
+		result ^= hasher(pair.second) + 0x9e3779b9 + (result << 6) + (result >> 2);
+	}
+
+	return result;
+}
+
+/**
+ @fn	bool SongSet::containsMetadata(const std::shared_ptr<MetaContainer>& md, size_t h) const
+
+ @brief	Checks if metadata equal to md is in the set
+
+ @param	md	Metadata to look for
+		h	Hash of md
+
+ @return	True if equal metadata was found
+ */
+
+bool SongSet::containsMetadata(const std::shared_ptr<MetaContainer>& md, size_t h) const {
+
+	auto range = metadata.equal_range(h);
+	for (auto it = range.first; it != range.second; it++) {
+		if (it->second == md || *it->second == *md)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ @fn	bool SongSet::insert(const Song& song)
+
+ @brief	Adds a song to the set
+
+ @param	song	The song to add
+
+ @return	True if the song was new, false if an equal song was already in the set
+ */
+
+bool SongSet::insert(const Song& song) {
+
+	bool inserted = paths.insert(song.getPathId()).second;
+
+	if (identity != SongIdentity::Metadata || !song.isEvaluated())
+		return inserted;
+
+	std::shared_ptr<MetaContainer> md = song.evaluate();
+	if (!md)
+		return inserted;
+
+	const size_t h = hash(*md);
+	if (containsMetadata(md, h))
+		return false;
+
+	metadata.emplace(h, md);
+	return inserted;
+}
+
+/**
+ @fn	bool SongSet::contains(const Song& song) const
+
+ @brief	Checks if a song equal to the given one is in the set
+
+ @param	song	The song to look for
+
+ @return	True if an equal song is in the set
+ */
+
+bool SongSet::contains(const Song& song) const {
+
+	if (paths.count(song.getPathId()) > 0)
+		return true;
+
+	if (identity != SongIdentity::Metadata || !song.isEvaluated())
+		return false;
+
+	std::shared_ptr<MetaContainer> md = song.evaluate();
+	return md && containsMetadata(md, hash(*md));
+}
+
+/**
+ @fn	void SongSet::reserve(size_t count)
+
+ @brief	Prepares the set for count songs, avoiding rehashing while it's filled
+
+ @param	count	Expected number of songs
+ */
+
+void SongSet::reserve(size_t count) {
+
+	paths.reserve(count);
+	if (identity == SongIdentity::Metadata)
+		metadata.reserve(count);
+}
@@ -0,0 +1,39 @@
+/**
+ @file	SongSet.h.
+
+ @brief	Declares the song set class.
+		A hash based set of song identities, used to tell in O(1) if an equal song was already seen.
+		Equality follows either ProxySong semantics (same path) or ConcreteSong semantics
+		(same path or same metadata).
+ */
+
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "Song.h"
+
+/** Defines when two songs are considered the same */
+enum class SongIdentity {
+	Path,		/** Songs are the same if their paths are equal (ProxySong semantics) */
+	Metadata	/** Songs are the same if their paths or their metadata are equal (ConcreteSong semantics) */
+};
+
+class SongSet {
+
+private:
+	SongIdentity identity;														/** Equality semantics of the set */
+	std::unordered_set<PathStore::Id> paths;									/** Paths of songs in the set, as ids in the path store */
+	std::unordered_multimap<size_t, std::shared_ptr<MetaContainer>> metadata;	/** Metadata of evaluated songs in the set, by hash */
+
+	bool containsMetadata(const std::shared_ptr<MetaContainer>&, size_t) const;	/** Checks if equal metadata is in the set */
+
+public:
+	explicit SongSet(SongIdentity identity = SongIdentity::Path);	/** Construction using equality semantics */
+
+	static size_t hash(const MetaContainer&) noexcept;			/** Hashes metadata contents */
+
+	bool insert(const Song& song);				/** Adds a song, returns false if an equal song was already there */
+	bool contains(const Song& song) const;		/** Checks if an equal song is in the set */
+	void reserve(size_t count);					/** Prepares the set for count songs */
+};
@@ -0,0 +1,630 @@
+/**
+ @file	TagReader.cpp.
+
+ @brief	Implements the tag reader class
+ */
+
+#include "TagReader.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#if defined(__linux__) && defined(OOJK_USE_IO_URING)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+// Initialize static members
+const size_t TagReader::header_size = 10;
+const size_t TagReader::max_tag_size = 256 * 1024;
+const size_t TagReader::max_threads = 16;
+std::atomic<size_t> TagReader::busy(0);
+
+namespace {
+
+	/** ID3v2 frames read as metadata, by the metadata key they are stored as */
+	const std::pair<const char*, const char*> frame_keys[] = {
+		{ "TIT2", "title" }, { "TPE1", "artist" }, { "TALB", "album" }, { "TRCK", "track" },
+		{ "TCON", "genre" }, { "TCOP", "copyright" }, { "TYER", "year" }, { "TDRC", "year" }
+	};
+
+	/**
+	 @fn	uint32_t syncsafe(const std::string& data, size_t pos)
+
+	 @brief	Reads a 28 bit integer stored in four bytes of seven bits, as ID3v2 sizes are
+	 */
+
+	uint32_t syncsafe(const std::string& data, size_t pos) {
+		uint32_t value = 0;
+		for (size_t i = 0; i < 4; i++)
+			value = (value << 7) | (static_cast<unsigned char>(data[pos + i]) & 0x7f);
+		return value;
+	}
+
+	/**
+	 @fn	uint32_t bigEndian(const std::string& data, size_t pos)
+
+	 @brief	Reads a 32 bit big endian integer
+	 */
+
+	uint32_t bigEndian(const std::string& data, size_t pos) {
+		uint32_t value = 0;
+		for (size_t i = 0; i < 4; i++)
+			value = (value << 8) | static_cast<unsigned char>(data[pos + i]);
+		return value;
+	}
+
+	/**
+	 @fn	void appendUtf8(std::string& text, uint32_t code)
+
+	 @brief	Appends a code point to UTF-8 text
+	 */
+
+	void appendUtf8(std::string& text, uint32_t code) {
+		if (code < 0x80) {
+			text += static_cast<char>(code);
+		}
+		else if (code < 0x800) {
+			text += static_cast<char>(0xc0 | (code >> 6));
+			text += static_cast<char>(0x80 | (code & 0x3f));
+		}
+		else if (code < 0x10000) {
+			text += static_cast<char>(0xe0 | (code >> 12));
+			text += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+			text += static_cast<char>(0x80 | (code & 0x3f));
+		}
+		else {
+			text += static_cast<char>(0xf0 | (code >> 18));
+			text += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+			text += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+			text += static_cast<char>(0x80 | (code & 0x3f));
+		}
+	}
+
+	/**
+	 @fn	std::string decodeText(const std::string& frame)
+
+	 @brief	Decodes the value of a text frame to UTF-8.
+			The first byte tells the encoding: 0 is ISO-8859-1, 1 UTF-16 with byte order mark,
+			2 UTF-16 big endian and 3 UTF-8. Only the first of several values is kept.
+	 */
+
+	std::string decodeText(const std::string& frame) {
+
+		if (frame.empty())
+			return std::string();
+
+		const char encoding = frame[0];
+		std::string text;
+
+		if (encoding == 0 || encoding == 3) {
+			for (size_t i = 1; i < frame.size() && frame[i] != '\0'; i++) {
+				if (encoding == 0)
+					appendUtf8(text, static_cast<unsigned char>(frame[i]));
+				else
+					text += frame[i];
+			}
+			return text;
+		}
+
+		size_t i = 1;
+		bool little = false;
+		if (encoding == 1 && frame.size() >= 3) {
+			little = static_cast<unsigned char>(frame[1]) == 0xff && static_cast<unsigned char>(frame[2]) == 0xfe;
+			i = 3;
+		}
+
+		auto unit = [&frame, little](size_t pos) {
+			const uint32_t a = static_cast<unsigned char>(frame[pos]);
+			const uint32_t b = static_cast<unsigned char>(frame[pos + 1]);
+			return little ? (b << 8 | a) : (a << 8 | b);
+		};
+
+		for (; i + 1 < frame.size(); i += 2) {
+			uint32_t code = unit(i);
+			if (code == 0)
+				break;
+
+			// Surrogate pairs encode code points past the basic plane
+			if (code >= 0xd800 && code < 0xdc00 && i + 3 < frame.size()) {
+				const uint32_t low = unit(i + 2);
+				if (low >= 0xdc00 && low < 0xe000) {
+					code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+					i += 2;
+				}
+			}
+			appendUtf8(text, code);
+		}
+		return text;
+	}
+
+#if defined(__linux__) && defined(OOJK_USE_IO_URING)
+
+	/** Minimal io_uring made with plain system calls, so no library is needed */
+	class Ring {
+	private:
+		int fd;							/** The ring */
+		void* sq_ring;					/** Mapped submission ring */
+		size_t sq_ring_size;			/** Size of the submission ring mapping */
+		void* cq_ring;					/** Mapped completion ring, may be the same mapping */
+		size_t cq_ring_size;			/** Size of the completion ring mapping */
+		io_uring_sqe* sqes;				/** Mapped submission entries */
+		size_t sqes_size;				/** Size of the submission entry mapping */
+		unsigned* sq_tail;				/** Tail of the submission ring, written by us */
+		unsigned* sq_mask;				/** Mask of submission ring indexes */
+		unsigned* sq_array;				/** Submission ring, indexes to sqes */
+		unsigned* cq_head;				/** Head of the completion ring, written by us */
+		unsigned* cq_tail;				/** Tail of the completion ring, written by the kernel */
+		unsigned* cq_mask;				/** Mask of completion ring indexes */
+		io_uring_cqe* cqes;				/** Completion entries */
+		unsigned int queued;			/** Entries queued since last submit */
+
+	public:
+		explicit Ring(unsigned int entries) : fd(-1), sq_ring(MAP_FAILED), sq_ring_size(0), cq_ring(MAP_FAILED), cq_ring_size(0),
+			sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), sqes_size(0), queued(0)
+		{
+			io_uring_params params;
+			std::memset(&params, 0, sizeof(params));
+
+			fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+			if (fd < 0)
+				return;
+
+			sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			if (params.features & IORING_FEAT_SINGLE_MMAP)
+				sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+			sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+			if (sq_ring == MAP_FAILED)
+				return;
+
+			cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ring :
+				::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+			if (cq_ring == MAP_FAILED)
+				return;
+
+			sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+			sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+			if (sqes == MAP_FAILED)
+				return;
+
+			char* sq = static_cast<char*>(sq_ring);
+			char* cq = static_cast<char*>(cq_ring);
+			sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		}
+
+		~Ring() {
+			if (sqes != MAP_FAILED)
+				::munmap(sqes, sqes_size);
+			if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+				::munmap(cq_ring, cq_ring_size);
+			if (sq_ring != MAP_FAILED)
+				::munmap(sq_ring, sq_ring_size);
+			if (fd >= 0)
+				::close(fd);
+		}
+
+		Ring(const Ring&) = delete;
+		Ring& operator=(const Ring&) = delete;
+
+		bool isValid() const noexcept {
+			return fd >= 0 && sqes != MAP_FAILED;
+		}
+
+		/** Registers an empty table of direct descriptors, which openat can fill */
+		bool registerFiles(unsigned int count) {
+			io_uring_rsrc_register files;
+			std::memset(&files, 0, sizeof(files));
+			files.nr = count;
+			files.flags = IORING_RSRC_REGISTER_SPARSE;
+			return ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES2, &files, sizeof(files)) == 0;
+		}
+
+		/** Returns a cleared submission entry, the ring must have room for it */
+		io_uring_sqe* queue() {
+			const unsigned tail = *sq_tail + queued;
+			const unsigned index = tail & *sq_mask;
+			io_uring_sqe* sqe = &sqes[index];
+			std::memset(sqe, 0, sizeof(*sqe));
+			sq_array[index] = index;
+			queued++;
+			return sqe;
+		}
+
+		/** Submits queued entries and waits until all of them are complete */
+		bool run(std::vector<io_uring_cqe>& completed) {
+
+			const unsigned int count = queued;
+			__atomic_store_n(sq_tail, *sq_tail + queued, __ATOMIC_RELEASE);
+			queued = 0;
+
+			unsigned int submitted = 0;
+			completed.clear();
+
+			while (completed.size() < count) {
+				const unsigned int wait = static_cast<unsigned int>(count - completed.size());
+				const long result = ::syscall(__NR_io_uring_enter, fd, count - submitted, wait, IORING_ENTER_GETEVENTS, nullptr, 0);
+				if (result < 0) {
+					if (errno == EINTR)
+						continue;
+					return false;
+				}
+				submitted += static_cast<unsigned int>(result);
+
+				unsigned head = *cq_head;
+				const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+				for (; head != tail; head++)
+					completed.push_back(cqes[head & *cq_mask]);
+				__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+			}
+			return true;
+		}
+	};
+
+#endif
+}
+
+/**
+ @fn	std::vector<std::string> TagReader::read(const std::vector<std::string>& paths)
+
+ @brief	Reads the ID3v2 tags of files. On Linux, when built with OOJK_USE_IO_URING,
+		io_uring is used if the kernel supports it. Otherwise threads read the files,
+		so slow storage is kept busy with several reads at once.
+
+ @param	paths	Full pathnames of the files
+
+ @return	Raw tags in the order of paths, header included, empty for files that can't be read or have no tag
+ */
+
+std::vector<std::string> TagReader::read(const std::vector<std::string>& paths) {
+
+	std::vector<std::string> tags(paths.size());
+
+	if (paths.size() == 1) {
+		tags.front() = readFile(paths.front());
+		return tags;
+	}
+
+#if defined(__linux__) && defined(OOJK_USE_IO_URING)
+	if (readWithRing(paths, tags))
+		return tags;
+
+	std::fill(tags.begin(), tags.end(), std::string());
+#endif
+
+	readWithThreads(paths, tags);
+	return tags;
+}
+
+/**
+ @fn	std::string TagReader::readFile(const std::string& path)
+
+ @brief	Reads the tag of one file with blocking reads
+
+ @param	path	Full pathname of the file
+
+ @return	Raw tag, header included, empty if the file can't be read or has no tag
+ */
+
+std::string TagReader::readFile(const std::string& path) {
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return std::string();
+
+	std::string tag(header_size, '\0');
+	if (!file.read(&tag[0], header_size))
+		return std::string();
+
+	const size_t size = std::min(getTagSize(tag), max_tag_size);
+	if (size <= header_size)
+		return std::string();
+
+	tag.resize(size);
+	file.read(&tag[header_size], size - header_size);
+	tag.resize(header_size + static_cast<size_t>(file.gcount()));
+	return tag;
+}
+
+/**
+ @fn	size_t TagReader::acquire(size_t wanted) noexcept
+
+ @brief	Takes threads from the budget shared by all calls, as many as are left of those wanted.
+		Calls come from several threads at once, e.g. a metadata reader per mount,
+		so the budget keeps them from starting max_threads each.
+
+ @param	wanted	Number of threads wanted
+
+ @return	Number of threads granted, to be given back by subtracting them from busy
+ */
+
+size_t TagReader::acquire(size_t wanted) noexcept {
+
+	size_t running = busy.load();
+	size_t granted;
+	do {
+		granted = std::min(wanted, max_threads - std::min(running, max_threads));
+		if (granted == 0)
+			return 0;
+	} while (!busy.compare_exchange_weak(running, running + granted));
+
+	return granted;
+}
+
+/**
+ @fn	void TagReader::readWithThreads(const std::vector<std::string>& paths, std::vector<std::string>& tags)
+
+ @brief	Reads tags using threads taking files in order. The calling thread reads too,
+		helped by as many threads as the shared budget has left, so a call goes on
+		even when other calls use up the budget.
+
+ @param			paths	Full pathnames of the files
+ @param [out]	tags	Raw tags in the order of paths
+ */
+
+void TagReader::readWithThreads(const std::vector<std::string>& paths, std::vector<std::string>& tags) {
+
+	if (paths.empty())
+		return;
+
+	// Reads mostly wait for storage, so there can be more threads than cores
+	const size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+	const size_t wanted = std::min(2 * cores, paths.size()) - 1;
+	const size_t granted = acquire(wanted);
+
+	std::atomic<size_t> next(0);
+	auto work = [&paths, &tags, &next]() {
+		for (size_t i = next++; i < paths.size(); i = next++)
+			tags[i] = readFile(paths[i]);
+	};
+
+	// Threads that can't be started leave their files to the others
+	std::vector<std::thread> workers;
+	try {
+		workers.reserve(granted);
+		for (size_t t = 0; t < granted; t++)
+			workers.emplace_back(work);
+	}
+	catch (...) {
+	}
+
+	auto finish = [&workers, granted]() {
+		for (std::thread& worker : workers)
+			worker.join();
+		busy -= granted;
+	};
+
+	try {
+		work();
+	}
+	catch (...) {
+		next = paths.size();
+		finish();
+		throw;
+	}
+
+	finish();
+}
+
+#if defined(__linux__) && defined(OOJK_USE_IO_URING)
+
+/**
+ @fn	bool TagReader::readWithRing(const std::vector<std::string>& paths, std::vector<std::string>& tags)
+
+ @brief	Reads tags using io_uring, a window of files at a time. Each file is opened into
+		a direct descriptor linked with the read of its header, all in one submission.
+		The second submission reads the tag bodies, each hard linked with closing its file.
+		So a window of files costs two system calls instead of a few per file.
+		Files whose operations fail, e.g. as the kernel rejects opening into direct descriptors,
+		are read again with threads afterwards, so they aren't taken for files without a tag.
+
+ @param			paths	Full pathnames of the files
+ @param [out]	tags	Raw tags in the order of paths
+
+ @return	FALSE if io_uring isn't available, e.g. on kernels older than 5.19
+ */
+
+bool TagReader::readWithRing(const std::vector<std::string>& paths, std::vector<std::string>& tags) {
+
+	const unsigned int window = 64;
+
+	Ring ring(2 * window);
+	if (!ring.isValid() || !ring.registerFiles(window))
+		return false;
+
+	std::vector<std::string> headers(window, std::string(header_size, '\0'));
+	std::vector<bool> opened(window);
+	std::vector<io_uring_cqe> completed;
+	std::vector<size_t> failed;
+
+	for (size_t first = 0; first < paths.size(); first += window) {
+
+		const unsigned int count = static_cast<unsigned int>(std::min<size_t>(window, paths.size() - first));
+
+		// Open and read the header of every file. A failed open cancels its read.
+		for (unsigned int k = 0; k < count; k++) {
+			io_uring_sqe* open = ring.queue();
+			open->opcode = IORING_OP_OPENAT;
+			open->fd = AT_FDCWD;
+			open->addr = reinterpret_cast<uint64_t>(paths[first + k].c_str());
+			open->open_flags = O_RDONLY;
+			open->file_index = k + 1;
+			open->flags = IOSQE_IO_LINK;
+			open->user_data = k * 2;
+
+			io_uring_sqe* header = ring.queue();
+			header->opcode = IORING_OP_READ;
+			header->fd = static_cast<int>(k);
+			header->flags = IOSQE_FIXED_FILE;
+			header->addr = reinterpret_cast<uint64_t>(&headers[k][0]);
+			header->len = header_size;
+			header->off = 0;
+			header->user_data = k * 2 + 1;
+		}
+
+		if (!ring.run(completed))
+			return false;
+
+		std::vector<size_t> sizes(count, 0);
+		std::vector<bool> unread(count, false);
+		for (const io_uring_cqe& cqe : completed) {
+			const unsigned int k = static_cast<unsigned int>(cqe.user_data / 2);
+			if (cqe.user_data % 2 == 0)
+				opened[k] = cqe.res >= 0;
+			else if (cqe.res == static_cast<int>(header_size))
+				sizes[k] = std::min(getTagSize(headers[k]), max_tag_size);
+			else if (cqe.res < 0)
+				unread[k] = true;
+		}
+
+		// A failed open cancels its header read, so only the open counts then
+		for (unsigned int k = 0; k < count; k++) {
+			if (!opened[k] || unread[k])
+				failed.push_back(first + k);
+		}
+
+		// Read tag bodies and close the files. Hard links close files even after a failed read.
+		for (unsigned int k = 0; k < count; k++) {
+			if (!opened[k])
+				continue;
+
+			if (sizes[k] > header_size) {
+				std::string& tag = tags[first + k];
+				tag = headers[k];
+				tag.resize(sizes[k]);
+
+				io_uring_sqe* body = ring.queue();
+				body->opcode = IORING_OP_READ;
+				body->fd = static_cast<int>(k);
+				body->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+				body->addr = reinterpret_cast<uint64_t>(&tag[header_size]);
+				body->len = static_cast<uint32_t>(sizes[k] - header_size);
+				body->off = header_size;
+				body->user_data = k * 2;
+			}
+
+			io_uring_sqe* close = ring.queue();
+			close->opcode = IORING_OP_CLOSE;
+			close->file_index = k + 1;
+			close->user_data = k * 2 + 1;
+		}
+
+		if (!ring.run(completed))
+			return false;
+
+		for (const io_uring_cqe& cqe : completed) {
+			if (cqe.user_data % 2 != 0)
+				continue;
+
+			std::string& tag = tags[first + cqe.user_data / 2];
+			tag.resize(cqe.res < 0 ? 0 : header_size + static_cast<size_t>(cqe.res));
+			if (cqe.res < 0)
+				failed.push_back(first + cqe.user_data / 2);
+		}
+	}
+
+	if (failed.empty())
+		return true;
+
+	std::vector<std::string> retried_paths;
+	retried_paths.reserve(failed.size());
+	for (const size_t i : failed)
+		retried_paths.push_back(paths[i]);
+
+	std::vector<std::string> retried(failed.size());
+	readWithThreads(retried_paths, retried);
+	for (size_t i = 0; i < failed.size(); i++)
+		tags[failed[i]] = std::move(retried[i]);
+
+	return true;
+}
+
+#endif
+
+/**
+ @fn	size_t TagReader::getTagSize(const std::string& header)
+
+ @brief	Returns the size of an ID3v2.3 or ID3v2.4 tag from its header
+
+ @param	header	First bytes of a file, at least header_size of them
+
+ @return	Size of the whole tag, header and footer included, 0 if the header isn't a supported tag
+ */
+
+size_t TagReader::getTagSize(const std::string& header) {
+
+	if (header.size() < header_size || header.compare(0, 3, "ID3") != 0)
+		return 0;
+
+	if (header[3] != 3 && header[3] != 4)
+		return 0;
+
+	for (size_t i = 6; i < header_size; i++) {
+		if (static_cast<unsigned char>(header[i]) & 0x80)
+			return 0;
+	}
+
+	const bool footer = (header[5] & 0x10) != 0;
+	return header_size + syncsafe(header, 6) + (footer ? header_size : 0);
+}
+
+/**
+ @fn	MetaContainer TagReader::parse(const std::string& tag)
+
+ @brief	Parses the text frames of an ID3v2.3 or ID3v2.4 tag, e.g. title, artist and album.
+		Frames past the read part of the tag are ignored.
+
+ @param	tag	Raw tag, header included
+
+ @return	Metadata found in the tag, empty if there was none
+ */
+
+MetaContainer TagReader::parse(const std::string& tag) {
+
+	MetaContainer metadata;
+
+	if (getTagSize(tag) == 0)
+		return metadata;
+
+	const bool v4 = tag[3] == 4;
+	const size_t end = std::min<size_t>(tag.size(), header_size + syncsafe(tag, 6));
+	size_t pos = header_size;
+
+	// Skip the extended header. Its size includes itself in v2.4, but not in v2.3.
+	if ((tag[5] & 0x40) && pos + 4 <= end)
+		pos += v4 ? syncsafe(tag, pos) : 4 + bigEndian(tag, pos);
+
+	while (pos + header_size <= end && tag[pos] != '\0') {
+
+		const std::string id = tag.substr(pos, 4);
+		const size_t size = v4 ? syncsafe(tag, pos + 4) : bigEndian(tag, pos + 4);
+		pos += header_size;
+
+		if (size > end - pos)
+			break;
+
+		for (auto const& frame : frame_keys) {
+			if (id == frame.first) {
+				metadata[frame.second] = decodeText(tag.substr(pos, size));
+				break;
+			}
+		}
+		pos += size;
+	}
+
+	return metadata;
+}
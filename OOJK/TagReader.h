@@ -0,0 +1,38 @@
+/**
+ @file	TagReader.h.
+
+ @brief	Declares the tag reader class.
+		Reads the ID3v2 tags of many files at once and parses their text frames.
+		Files are read by threads from a budget shared by all callers, or on Linux with io_uring when built with OOJK_USE_IO_URING.
+		With io_uring, opening a file, reading the tag header and later the tag body are
+		queued for a whole batch of files at a time, instead of costing system calls per file.
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include "Metadata.h"
+
+class TagReader {
+
+private:
+	const static size_t max_tag_size;		/** Tags are read at most this far, text frames come before any large pictures */
+	const static size_t max_threads;		/** Most threads reading at once, shared by all calls */
+	static std::atomic<size_t> busy;		/** Reader threads running, summed over all calls */
+
+	static std::string readFile(const std::string& path);							/** Reads the tag of one file */
+	static void readWithThreads(const std::vector<std::string>& paths, std::vector<std::string>& tags);	/** Reads tags using threads from a shared budget */
+	static size_t acquire(size_t wanted) noexcept;								/** Takes threads from the shared budget */
+
+#if defined(__linux__) && defined(OOJK_USE_IO_URING)
+	static bool readWithRing(const std::vector<std::string>& paths, std::vector<std::string>& tags);		/** Reads tags using io_uring */
+#endif
+
+public:
+	const static size_t header_size;		/** Size of an ID3v2 header */
+
+	static std::vector<std::string> read(const std::vector<std::string>& paths);	/** Reads tags of files */
+	static size_t getTagSize(const std::string& header);							/** Returns size of a tag from its header */
+	static MetaContainer parse(const std::string& tag);							/** Parses text frames of a tag */
+};
@@ -0,0 +1,270 @@
+/**
+ @file	TrigramIndex.cpp.
+
+ @brief	Implements the trigram index class
+ */
+
+#include "TrigramIndex.h"
+#include <algorithm>
+#include <cctype>
+
+/** Metadata keys whose values can be searched, in addition to the path */
+const std::string TrigramIndex::text_strings[] = { "title", "artist", "album" };
+
+/**
+ @fn	std::string TrigramIndex::makeText(const Song& song)
+
+ @brief	Builds the lowercased searchable text of a song.
+		Fields are separated by line breaks, so a match can't span two fields.
+		Metadata is only used for evaluated songs, proxy songs are searchable by path.
+
+ @param	song	The song to make searchable
+
+ @return	Searchable text of the song
+ */
+
+std::string TrigramIndex::makeText(const Song& song) {
+
+	std::string text = song.getPath();
+
+	std::shared_ptr<MetaContainer> metadata = song.isEvaluated() ? song.evaluate() : nullptr;
+
+	if (metadata) {
+		for (const std::string& key : text_strings) {
+			auto it = metadata->find(key);
+			if (it != metadata->end())
+				text += "\n" + it->second;
+		}
+	}
+
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+
+	return text;
+}
+
+/**
+ @fn	uint32_t TrigramIndex::makeGram(const std::string& text, size_t position, size_t length)
+
+ @brief	Packs one to three characters into an integer.
+		The length goes to the top byte, so e.g. "a" and "\0\0a" don't share a key.
+
+ @param	text		Lowercased text
+		position	Position of the first character
+		length		Number of characters, 1 to 3
+
+ @return	The packed gram
+ */
+
+uint32_t TrigramIndex::makeGram(const std::string& text, size_t position, size_t length) {
+
+	uint32_t gram = static_cast<uint32_t>(length) << 24;
+	for (size_t i = 0; i < length; i++)
+		gram |= static_cast<uint32_t>(static_cast<unsigned char>(text[position + i])) << (8 * (length - 1 - i));
+
+	return gram;
+}
+
+/**
+ @fn	std::vector<uint32_t> TrigramIndex::makeGrams(const std::string& text, size_t shortest)
+
+ @brief	Splits text into distinct grams of shortest to three characters, each packed into an integer
+
+ @param	text		Lowercased text
+		shortest	Length of the shortest grams, 1 when indexing and 3 when querying
+
+ @return	Distinct grams in ascending order
+ */
+
+std::vector<uint32_t> TrigramIndex::makeGrams(const std::string& text, size_t shortest) {
+
+	std::vector<uint32_t> result;
+	result.reserve(text.length() * (4 - shortest));
+
+	for (size_t length = shortest; length <= 3; length++) {
+		for (size_t i = 0; i + length <= text.length(); i++)
+			result.push_back(makeGram(text, i, length));
+	}
+
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+/**
+ @fn	void TrigramIndex::index(EntryOrder::Id entry)
+
+ @brief	Adds characters, pairs and trigrams of an entry's text to the posting lists
+
+ @param	entry	Entry id of the song
+ */
+
+void TrigramIndex::index(EntryOrder::Id entry) {
+
+	for (const uint32_t gram : makeGrams(texts[entry], 1))
+		Postings::insert(grams[gram], entry);
+}
+
+/**
+ @fn	void TrigramIndex::unindex(EntryOrder::Id entry)
+
+ @brief	Removes characters, pairs and trigrams of an entry's text from the posting lists
+
+ @param	entry	Entry id of the song
+ */
+
+void TrigramIndex::unindex(EntryOrder::Id entry) {
+
+	for (const uint32_t gram : makeGrams(texts[entry], 1)) {
+		auto it = grams.find(gram);
+		if (it == grams.end())
+			continue;
+
+		Postings::erase(it->second, entry);
+		if (it->second.empty())
+			grams.erase(it);
+	}
+}
+
+/**
+ @fn	PostingList TrigramIndex::search(const std::string& query) const
+
+ @brief	Finds songs whose title, artist, album or path contains the query, ignoring case.
+		Posting lists of the query's trigrams are intersected rarest first and the
+		remaining candidates are verified against their text.
+		Queries of one or two characters are answered by their own posting list,
+		which holds exactly the songs containing them, and an empty query matches every song.
+
+ @param	query	Substring to look for
+
+ @return	Ascending positions of the matching songs
+ */
+
+PostingList TrigramIndex::search(const std::string& query) const {
+
+	std::string needle = query;
+	std::transform(needle.begin(), needle.end(), needle.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+
+	PostingList result;
+
+	if (needle.empty()) {
+		result.resize(order.size());
+		for (size_t i = 0; i < result.size(); i++)
+			result[i] = static_cast<unsigned int>(i);
+		return result;
+	}
+
+	if (needle.length() < 3) {
+		auto it = grams.find(makeGram(needle, 0, needle.length()));
+		return (it == grams.end()) ? result : order.toPositions(it->second);
+	}
+
+	std::vector<const PostingList*> lists;
+	for (const uint32_t trigram : makeGrams(needle, 3)) {
+		auto it = grams.find(trigram);
+		if (it == grams.end())
+			return result;
+
+		lists.push_back(&it->second);
+	}
+
+	std::sort(lists.begin(), lists.end(), [](const PostingList* a, const PostingList* b) {
+		return a->size() < b->size();
+	});
+
+	PostingList candidates = *lists.front();
+	for (auto it = lists.begin() + 1; it != lists.end() && !candidates.empty(); it++)
+		candidates = Postings::intersect(candidates, **it);
+
+	// Having all trigrams doesn't mean they are in the right order
+	for (const EntryOrder::Id entry : candidates) {
+		if (texts[entry].find(needle) != std::string::npos)
+			result.push_back(entry);
+	}
+
+	return order.toPositions(result);
+}
+
+/**
+ @fn	void TrigramIndex::reset(const SongList& songs)
+
+ @brief	Rebuilds the index from the playlist's songs, whose entry ids are their positions
+
+ @param	songs	All songs of the observed playlist
+ */
+
+void TrigramIndex::reset(const SongList& songs) {
+
+	grams.clear();
+	texts.clear();
+	texts.reserve(songs.size());
+
+	for (auto const& song : songs)
+		texts.push_back(makeText(*song));
+
+	order.reset(texts.size());
+	for (EntryOrder::Id entry = 0; entry < texts.size(); entry++)
+		index(entry);
+}
+
+/**
+ @fn	void TrigramIndex::inserted(size_t position, const Song& song)
+
+ @brief	Indexes a song inserted to the playlist, touching only its own posting lists
+
+ @param	position	Position the song was inserted at
+		song		The inserted song
+ */
+
+void TrigramIndex::inserted(size_t position, const Song& song) {
+
+	std::string text = makeText(song);
+	const EntryOrder::Id entry = order.insert(position);
+	if (entry >= texts.size())
+		texts.resize(entry + 1);
+
+	texts[entry] = std::move(text);
+	index(entry);
+}
+
+/**
+ @fn	void TrigramIndex::erasing(const std::vector<size_t>& positions, const SongList& songs)
+
+ @brief	Drops songs about to be erased from their own posting lists.
+		Their texts are freed, and their entry ids are reused by later insertions.
+
+ @param	positions	Ascending positions of the songs to be erased
+		songs		All songs of the observed playlist, before the removal, unused
+ */
+
+void TrigramIndex::erasing(const std::vector<size_t>& positions, const SongList&) {
+
+	for (const size_t position : positions) {
+		const EntryOrder::Id entry = order.at(position);
+		unindex(entry);
+		std::string().swap(texts[entry]);
+	}
+
+	order.erase(positions);
+}
+
+/**
+ @fn	void TrigramIndex::replaced(size_t position, const Song& before, const Song& after)
+
+ @brief	Re-indexes a song that was replaced, e.g. when evaluation made its metadata searchable
+
+ @param	position	Position of the replaced song
+		before		The song that was replaced, unused as its text is kept
+		after		The song now at position
+ */
+
+void TrigramIndex::replaced(size_t position, const Song&, const Song& after) {
+
+	const EntryOrder::Id entry = order.at(position);
+	unindex(entry);
+	texts[entry] = makeText(after);
+	index(entry);
+}
@@ -0,0 +1,44 @@
+/**
+ @file	TrigramIndex.h.
+
+ @brief	Declares the trigram index class.
+		Answers case-insensitive substring queries over song titles, artists, albums and paths.
+		Every three character sequence of the indexed text maps to songs containing it,
+		so a query only verifies songs that contain all of its trigrams.
+		Single characters and pairs are indexed too, so a one or two character query is
+		answered from its own posting list instead of scanning every text. An empty query
+		matches every song.
+		Songs are kept by entry id, see EntryOrder, so edits in the middle of the playlist
+		don't renumber the postings of songs after them.
+ */
+
+#pragma once
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include "PlaylistObserver.h"
+#include "PostingList.h"
+#include "EntryOrder.h"
+
+class TrigramIndex : public PlaylistObserver {
+
+private:
+	const static std::string text_strings[];				/** Metadata keys whose values are searchable */
+	std::vector<std::string> texts;							/** Lowercased searchable text of each song, by entry id */
+	std::unordered_map<uint32_t, PostingList> grams;		/** Maps a trigram, pair or character to entry ids of songs containing it */
+	EntryOrder order;										/** Entry ids of the songs of the observed playlist, by position */
+
+	static std::string makeText(const Song& song);					/** Builds lowercased searchable text of a song */
+	static uint32_t makeGram(const std::string&, size_t position, size_t length);	/** Packs up to three characters into a key */
+	static std::vector<uint32_t> makeGrams(const std::string&, size_t shortest);	/** Returns distinct grams of a text */
+	void index(EntryOrder::Id entry);								/** Adds grams of an entry's text to the posting lists */
+	void unindex(EntryOrder::Id entry);								/** Removes grams of an entry's text from the posting lists */
+
+public:
+	PostingList search(const std::string& query) const;	/** Returns positions of songs containing the query */
+
+	void reset(const SongList& songs) override;										/** Rebuilds the index from scratch */
+	void inserted(size_t position, const Song& song) override;						/** Indexes an inserted song */
+	void erasing(const std::vector<size_t>& positions, const SongList& songs) override;	/** Drops erased songs from the index */
+	void replaced(size_t position, const Song& before, const Song& after) override;	/** Re-indexes a replaced song */
+};